@@ -82,7 +82,7 @@ void CDSRefTable::ClearAllTables( void )
 			{
 				if (fRefTables[ i ]->fTableData[j] != nil)
 				{
-					free(fRefTables[ i ]->fTableData[j]);
+					FreeRefEntry(fRefTables[ i ]->fTableData[j]);
 					fRefTables[ i ]->fTableData[j] = nil;
 				}
 			}
@@ -570,6 +570,9 @@ tDirStatus CDSRefTable::GetNewRef (	UInt32		   *outRef,
 						pCurTable->fTableData[ uiSlot ]->fBufTag		= 0;
 						pCurTable->fTableData[ uiSlot ]->fChildren		= nil;
 						pCurTable->fTableData[ uiSlot ]->fChildPID		= nil;
+						pCurTable->fTableData[ uiSlot ]->fIndexBuff		= nil;
+						pCurTable->fTableData[ uiSlot ]->fItemOffsets	= nil;
+						pCurTable->fTableData[ uiSlot ]->fItemCount		= 0;
 
 						// Up the item count
 						pCurTable->fItemCnt++;
@@ -842,7 +845,7 @@ tDirStatus CDSRefTable::RemoveRef ( UInt32 inRefNum, UInt32 inType, SInt32 inPID
 						}
 					}
 					
-					free(pCurrRef);
+					FreeRefEntry(pCurrRef);
 					pCurrRef = nil;
 				}
 			}
@@ -950,6 +953,10 @@ tDirStatus CDSRefTable::SetOffset ( UInt32 inRefNum, UInt32 inType, UInt32 inOff
 		if ( pCurrRef != nil )
 		{
 			pCurrRef->fOffset = inOffset;
+			//any item offsets were built relative to the old offset
+			DSFree( pCurrRef->fItemOffsets );
+			pCurrRef->fIndexBuff = nil;
+			pCurrRef->fItemCount = 0;
 			siResult = eDSNoErr;
 		}
 	}
@@ -1023,6 +1030,101 @@ tDirStatus CDSRefTable::SetBufTag ( UInt32 inRefNum, UInt32 inType, UInt32 inBuf
 
 } // SetBufTag
 
+//------------------------------------------------------------------------------------
+//	* GetItemOffset
+//
+//		returns eDSIndexNotFound if no item offsets have been built for inBuff yet
+//------------------------------------------------------------------------------------
+
+tDirStatus CDSRefTable::GetItemOffset ( UInt32 inRefNum, UInt32 inType, tDataBufferPtr inBuff, UInt32 inIndex, UInt32* outOffset, SInt32 inPID )
+{
+	tDirStatus		siResult	= eDSDirSrvcNotOpened;
+	sFWRefEntry	   *pCurrRef	= nil;
+
+	fTableMutex.WaitLock();
+
+	siResult = VerifyReference( inRefNum, inType, inPID );
+	
+	if (siResult == eDSNoErr)
+	{
+		pCurrRef = GetTableRef( inRefNum );
+		
+		siResult = eDSInvalidReference;
+		if ( pCurrRef != nil )
+		{
+			if ( pCurrRef->fItemOffsets == nil || pCurrRef->fIndexBuff != inBuff )
+			{
+				siResult = eDSIndexNotFound;
+			}
+			else if ( inIndex == 0 || inIndex > pCurrRef->fItemCount )
+			{
+				//the walk that built the offsets stopped short of this item
+				siResult = eDSInvalidBuffFormat;
+			}
+			else
+			{
+				*outOffset = pCurrRef->fItemOffsets[ inIndex - 1 ];
+				siResult = eDSNoErr;
+			}
+		}
+	}
+
+	fTableMutex.SignalLock();
+    
+	return( siResult );
+
+} // GetItemOffset
+
+//------------------------------------------------------------------------------------
+//	* SetItemOffsets
+//
+//		takes ownership of inOffsets in all cases
+//------------------------------------------------------------------------------------
+
+tDirStatus CDSRefTable::SetItemOffsets ( UInt32 inRefNum, UInt32 inType, tDataBufferPtr inBuff, UInt32* inOffsets, UInt32 inCount, SInt32 inPID )
+{
+	tDirStatus		siResult	= eDSDirSrvcNotOpened;
+	sFWRefEntry	   *pCurrRef	= nil;
+
+	fTableMutex.WaitLock();
+
+	siResult = VerifyReference( inRefNum, inType, inPID );
+	
+	if (siResult == eDSNoErr)
+	{
+		pCurrRef = GetTableRef( inRefNum );
+		
+		siResult = eDSInvalidReference;
+		if ( pCurrRef != nil )
+		{
+			DSFree( pCurrRef->fItemOffsets );
+			pCurrRef->fItemOffsets	= inOffsets;
+			pCurrRef->fItemCount	= inCount;
+			pCurrRef->fIndexBuff	= inBuff;
+			inOffsets = nil;
+			siResult = eDSNoErr;
+		}
+	}
+
+	fTableMutex.SignalLock();
+
+	DSFree( inOffsets );
+    
+	return( siResult );
+
+} // SetItemOffsets
+
+//------------------------------------------------------------------------------------
+//	* FreeRefEntry
+//------------------------------------------------------------------------------------
+
+void CDSRefTable::FreeRefEntry ( sFWRefEntry *inRefEntry )
+{
+	DSFree( inRefEntry->fItemOffsets );
+	free( inRefEntry );
+
+} // FreeRefEntry
+
 //------------------------------------------------------------------------------------
 //	* GetRefCount
 //------------------------------------------------------------------------------------
@@ -67,6 +67,9 @@ typedef struct sFWRefEntry {
 	SInt32			fPID;
 	sListFWInfo	   *fChildren;
 	sPIDFWInfo	   *fChildPID;
+	tDataBufferPtr	fIndexBuff;		//buffer the item offsets below were built from
+	UInt32		   *fItemOffsets;	//lazily built offsets of the attributes or values under this ref
+	UInt32			fItemCount;
 } sFWRefEntry;
 
 // -------------------------------------------
@@ -114,6 +117,8 @@ public:
     tDirStatus	SetOffset			( UInt32 inRefNum, UInt32 inType, UInt32 inOffset, SInt32 inPID );
     tDirStatus	GetBufTag			( UInt32 inRefNum, UInt32 inType, UInt32* outBufTag, SInt32 inPID );
     tDirStatus	SetBufTag			( UInt32 inRefNum, UInt32 inType, UInt32 inBufTag, SInt32 inPID );
+    tDirStatus	GetItemOffset		( UInt32 inRefNum, UInt32 inType, tDataBufferPtr inBuff, UInt32 inIndex, UInt32* outOffset, SInt32 inPID );
+    tDirStatus	SetItemOffsets		( UInt32 inRefNum, UInt32 inType, tDataBufferPtr inBuff, UInt32* inOffsets, UInt32 inCount, SInt32 inPID );
 
 private:
 	DSMutexSemaphore	fTableMutex;
@@ -138,6 +143,7 @@ private:
 	sRefFWTable*	GetThisTable	( UInt32 inTableNum );
 
 	sFWRefEntry*	GetTableRef		( UInt32 inRefNum );
+	void			FreeRefEntry	( sFWRefEntry *inRefEntry );
 
 	UInt32			GetRefCount		( void );
 };
@@ -76,6 +76,10 @@ CMessaging::CMessaging ( CIPCVirtualClass *endPoint, int inTranslateMode, bool i
 	}
 	
 	fServerVersion = 1; //for internal dispatch and mach
+	
+	OSQueueHead emptyQueue = OS_ATOMIC_QUEUE_INIT;
+	fFreeChannels = emptyQueue;
+	pthread_key_create( &fChannelKey, NULL );
 } // CMessaging
 
 
@@ -85,8 +89,18 @@ CMessaging::CMessaging ( CIPCVirtualClass *endPoint, int inTranslateMode, bool i
 
 CMessaging::~CMessaging ( void )
 {
+	sMsgChannel	   *channel	= nil;
+
 	DSDelete(fCommPort);
 	DSFree(fMsgData);
+	
+	while ( (channel = (sMsgChannel *) OSAtomicDequeue(&fFreeChannels, offsetof(sMsgChannel, fNext))) != nil )
+	{
+		DSFree( channel->fMsgData );
+		free( channel );
+	}
+	
+	pthread_key_delete( fChannelKey );
 } // ~CMessaging
 
 //------------------------------------------------------------------------------------
@@ -122,7 +136,7 @@ SInt32 CMessaging::SendInlineMessage ( UInt32 inMsgType )
 		}
 		else //we are not inside a handler thread
 		{
-			aMsgData = fMsgData;
+			aMsgData = *GetLocalMsgData();
 		}
 		
 		if (aMsgData == nil) //recursion limit likely hit
@@ -155,7 +169,7 @@ SInt32 CMessaging::SendInlineMessage ( UInt32 inMsgType )
 		}
 		else //we are not inside a handler thread
 		{
-			fMsgData = aMsgData;
+			*GetLocalMsgData() = aMsgData;
 		}
 		
 		return eDSNoErr;
@@ -761,40 +775,7 @@ SInt32 CMessaging::Get_tRecordEntry_FromMsg ( tRecordEntry **outRecEntry, eValue
 
 SInt32 CMessaging::GetEmptyObj ( sComData *inMsg, eValueType inType, sObject **outObj )
 {
-	SInt32		siResult	= eDSIndexNotFound;
-	UInt32		i;
-
-	for ( i = 0; i < 10; i++ )
-	{
-		if ( inMsg->obj[ i ].type == 0 )
-		{
-			*outObj = &inMsg->obj[ i ];
-			if ( i == 0 )
-			{
-                //offset was incorrect ie. missing 2 more UInt32 fixed below ie. now 3*
-                // but should really use offsetof here since it is a fixed size object
-                (*outObj)->offset = offsetof(struct sComData, data);
-                //(*outObj)->offset = sizeof( mach_msg_header_t ) +
-                //					sizeof( mach_msg_type_t ) +
-                //					3*sizeof( UInt32 ) +
-                //				   (sizeof( sObject ) * 10);
-			}
-			else
-			{
-				(*outObj)->offset = inMsg->obj[ i - 1 ].offset + inMsg->obj[ i - 1 ].length;
-			}
-			siResult = eDSNoErr;
-			break;
-		}
-		else if ( inMsg->obj[ i ].type == (UInt32)inType )
-		{
-			//siResult = kDupInList;
-			break;
-		}
-	}
-
-	return( siResult );
-
+	return( dsGetEmptyMsgObjPriv(inMsg, inType, outObj) );
 } // GetEmptyObj
 
 
@@ -804,21 +785,7 @@ SInt32 CMessaging::GetEmptyObj ( sComData *inMsg, eValueType inType, sObject **o
 
 SInt32 CMessaging::GetThisObj ( sComData *inMsg, eValueType inType, sObject **outObj )
 {
-	SInt32		siResult	= eDSIndexNotFound;
-	UInt32		i;
-
-	for ( i = 0; i < 10; i++ )
-	{
-		if ( inMsg->obj[ i ].type == (UInt32)inType )
-		{
-			*outObj = &inMsg->obj[ i ];
-			siResult = eDSNoErr;
-			break;
-		}
-	}
-
-	return( siResult );
-
+	return( dsGetMsgObjPriv(inMsg, inType, outObj) );
 } // GetThisObj
 
 
@@ -873,7 +840,7 @@ bool CMessaging::Grow ( UInt32 inOffset, UInt32 inSize )
 				}
 				else //we are not inside a handler thread
 				{
-					fMsgData = (sComData *)pNewPtr;
+					*GetLocalMsgData() = (sComData *)pNewPtr;
 				}
 			} else {
 				fMsgData = (sComData *)pNewPtr;
@@ -912,7 +879,31 @@ void CMessaging::Lock ( void )
 		}
 		else //we are not inside a handler thread
 		{
-			fLock.WaitLock();
+			// nothing goes over the wire for internal dispatch, so each thread can use its own block
+			sMsgChannel *channel = (sMsgChannel *) pthread_getspecific( fChannelKey );
+			if ( channel == nil )
+			{
+				channel = (sMsgChannel *) OSAtomicDequeue( &fFreeChannels, offsetof(sMsgChannel, fNext) );
+				if ( channel == nil )
+				{
+					channel = (sMsgChannel *) ::calloc( 1, sizeof(sMsgChannel) );
+				}
+				
+				if ( channel == nil )
+				{
+					// fall back to the shared block
+					fLock.WaitLock();
+					return;
+				}
+				
+				pthread_setspecific( fChannelKey, channel );
+			}
+			
+			channel->fDepth++;
+			if ( channel->fMsgData == nil )
+			{
+				ResetMessageBlock();
+			}
 		}
 	} else {
 		fLock.WaitLock();
@@ -925,16 +916,18 @@ void CMessaging::Lock ( void )
 
 void CMessaging::ResetMessageBlock( void )
 {
+	sComData	  **msgData	= GetLocalMsgData();
+	
 	// let's free and reallocate the block if it isn't the default block size so we don't grow memory
-	if( fMsgData == NULL || kMaxFixedMsgData != fMsgData->fDataSize )
+	if( (*msgData) == NULL || kMaxFixedMsgData != (*msgData)->fDataSize )
 	{
-		if ( fMsgData != NULL ) free( fMsgData );
+		if ( (*msgData) != NULL ) free( (*msgData) );
 		
-		fMsgData = (sComData *)::calloc( 1, sizeof( sComData ) + kMaxFixedMsgData );
-		if ( fMsgData != nil )
+		(*msgData) = (sComData *)::calloc( 1, sizeof( sComData ) + kMaxFixedMsgData );
+		if ( (*msgData) != nil )
 		{
-			fMsgData->fDataSize		= kMaxFixedMsgData;
-			fMsgData->fDataLength	= 0;
+			(*msgData)->fDataSize	= kMaxFixedMsgData;
+			(*msgData)->fDataLength	= 0;
 		}				
 	}
 } // ResetMessageBlock
@@ -955,8 +948,18 @@ void CMessaging::Unlock ( void )
 		}
 		else //we are not inside a handler thread
 		{
+			sMsgChannel *channel = (sMsgChannel *) pthread_getspecific( fChannelKey );
+			
 			ResetMessageBlock();
-			fLock.SignalLock();
+			if ( channel == nil )
+			{
+				fLock.SignalLock();
+			}
+			else if ( (--channel->fDepth) == 0 )
+			{
+				pthread_setspecific( fChannelKey, nil );
+				OSAtomicEnqueue( &fFreeChannels, channel, offsetof(sMsgChannel, fNext) );
+			}
 		}
 	} else {
 		ResetMessageBlock();
@@ -1020,7 +1023,7 @@ sComData* CMessaging::GetMsgData ( void )
 		}
 		else //we are not inside a handler thread
 		{
-			aMsgData = fMsgData;
+			aMsgData = *GetLocalMsgData();
 		}
 	} else {
 		aMsgData = fMsgData;
@@ -1029,6 +1032,24 @@ sComData* CMessaging::GetMsgData ( void )
 	return(aMsgData);
 } // GetMsgData
 
+//------------------------------------------------------------------------------------
+//	* GetLocalMsgData
+//------------------------------------------------------------------------------------
+
+sComData** CMessaging::GetLocalMsgData ( void )
+{
+	// outside the handler threads internal dispatch uses the block of the channel this thread holds
+	if (fInternal == true) {
+		sMsgChannel *channel = (sMsgChannel *) pthread_getspecific( fChannelKey );
+		if ( channel != nil )
+		{
+			return(&channel->fMsgData);
+		}
+	}
+	
+	return(&fMsgData);
+} // GetLocalMsgData
+
 #ifdef SERVERINTERNAL
 //------------------------------------------------------------------------------------
 //	* IsThreadUsingInternalDispatchBuffering
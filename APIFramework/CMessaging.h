@@ -35,6 +35,17 @@
 #include <DirectoryServiceCore/SharedConsts.h>
 #include <DirectoryService/DirServicesTypes.h>
 #include <DirectoryServiceCore/DSMutexSemaphore.h>
+#include <libkern/OSAtomic.h>
+#include <pthread.h>
+
+// message block used by a thread outside the handler threads while it holds the CMessaging,
+// pooled so threads don't have to serialize on a single block for internal dispatch
+struct sMsgChannel
+{
+	sMsgChannel		   *fNext;
+	sComData		   *fMsgData;
+	UInt32				fDepth;
+};
 
 class CMessaging {
 public:
@@ -78,6 +89,7 @@ private:
 		SInt32	GetEmptyObj					( sComData *inMsg, eValueType inType, sObject **outObj );
 		SInt32	GetThisObj					( sComData *inMsg, eValueType inType, sObject **outObj );
 		sComData*   GetMsgData				( void );
+		sComData**  GetLocalMsgData			( void );
 
 		bool	Grow						( UInt32 inOffset, UInt32 inSize );
 
@@ -86,6 +98,8 @@ private:
 		bool				fInternal;
 
 		DSMutexSemaphore	fLock;
+		pthread_key_t		fChannelKey;
+		OSQueueHead			fFreeChannels;
 
 		sComData		   *fMsgData;
 		UInt32				fServerVersion;
@@ -303,6 +303,70 @@ tDirStatus ExtractRecordEntry ( tDataBufferPtr		inOutDataBuff,
 } // ExtractRecordEntry
 
 
+//------------------------------------------------------------------------------------
+//	Name: GetIndexedItemOffset
+//
+//	Returns the offset of the length field of the inIndex'th (1-based) attribute or value
+//	under inRef.  The offsets of all items are gathered in one walk the first time the ref
+//	is used against inBuff so that subsequent lookups by index do not rescan the buffer.
+//	The walk stops at the first length field that would run past inLimit; any item past
+//	that point is reported as eDSInvalidBuffFormat just as the linear walk did.
+//------------------------------------------------------------------------------------
+
+static tDirStatus GetIndexedItemOffset (	tDataBufferPtr	inBuff,
+											UInt32			inRef,
+											UInt32			inRefType,
+											UInt32			inIndex,
+											UInt32			inFirstOffset,
+											UInt32			inLimit,
+											UInt32			inCount,
+											UInt32			inLenSize,
+											UInt32		   *outOffset )
+{
+	tDirStatus		siResult	= eDSNoErr;
+	UInt32		   *offsets		= nil;
+	UInt32			offset		= inFirstOffset;
+	UInt16			itemLen16	= 0;
+	UInt32			itemLen		= 0;
+	UInt32			i			= 0;
+
+	siResult = gFWRefTable.GetItemOffset( inRef, inRefType, inBuff, inIndex, outOffset, gProcessPID );
+	if ( siResult != eDSIndexNotFound ) return( siResult );
+
+	offsets = (UInt32 *)::calloc( inCount + 1, sizeof(UInt32) );
+	if ( offsets == nil ) return( eMemoryAllocError );
+
+	for ( i = 0; i < inCount; i++ )
+	{
+		// Do record check, verify that offset is not past end of buffer, etc.
+		if (inLenSize + offset > inLimit) break;
+
+		offsets[i] = offset;
+
+		// Get the length for the item
+		if ( inLenSize == 2 )
+		{
+			::memcpy( &itemLen16, inBuff->fBufferData + offset, 2 );
+			itemLen = (UInt32)itemLen16;
+		}
+		else
+		{
+			::memcpy( &itemLen, inBuff->fBufferData + offset, 4 );
+		}
+
+		// Move the offset past the length word and the length of the data
+		offset += inLenSize + itemLen;
+	}
+
+	// offsets is owned by the ref from here on
+	siResult = gFWRefTable.SetItemOffsets( inRef, inRefType, inBuff, offsets, i, gProcessPID );
+	if ( siResult != eDSNoErr ) return( siResult );
+
+	return( gFWRefTable.GetItemOffset( inRef, inRefType, inBuff, inIndex, outOffset, gProcessPID ) );
+
+} // GetIndexedItemOffset
+
+
 //------------------------------------------------------------------------------------
 //	Name: ExtractAttributeEntry
 //------------------------------------------------------------------------------------
@@ -372,19 +436,10 @@ tDirStatus ExtractAttributeEntry (	tDataBufferPtr			inOutDataBuff,
 
 		if ( (bufTag == 'StdB') || (bufTag == 'DbgB') )
 		{
-			// Skip to the attribute that we want
-			for ( i = 1; i < uiIndex; i++ )
-			{
-				// Do record check, verify that offset is not past end of buffer, etc.
-				if (2 + offset > buffSize)  throw( (SInt32)eDSInvalidBuffFormat );
-			
-				// Get the length for the attribute
-				::memcpy( &usAttrLen16, p, 2 );
-	
-				// Move the offset past the length word and the length of the data
-				p		+= 2 + usAttrLen16;
-				offset	+= 2 + usAttrLen16;
-			}
+			// Look up the attribute that we want
+			siResult = GetIndexedItemOffset( inOutDataBuff, inAttrListRef, eAttrListRefType, uiIndex, offset, buffSize, usAttrCnt, 2, &offset );
+			if ( siResult != eDSNoErr ) throw( siResult );
+			p = inOutDataBuff->fBufferData + offset;
 	
 			// Get the attribute offset
 			uiOffset = offset;
@@ -403,19 +458,10 @@ tDirStatus ExtractAttributeEntry (	tDataBufferPtr			inOutDataBuff,
 		}
 		else
 		{
-			// Skip to the attribute that we want
-			for ( i = 1; i < uiIndex; i++ )
-			{
-				// Do record check, verify that offset is not past end of buffer, etc.
-				if (4 + offset > buffSize)  throw( (SInt32)eDSInvalidBuffFormat );
-			
-				// Get the length for the attribute
-				::memcpy( &usAttrLen, p, 4 );
-	
-				// Move the offset past the length word and the length of the data
-				p		+= 4 + usAttrLen;
-				offset	+= 4 + usAttrLen;
-			}
+			// Look up the attribute that we want
+			siResult = GetIndexedItemOffset( inOutDataBuff, inAttrListRef, eAttrListRefType, uiIndex, offset, buffSize, usAttrCnt, 4, &offset );
+			if ( siResult != eDSNoErr ) throw( siResult );
+			p = inOutDataBuff->fBufferData + offset;
 	
 			// Get the attribute offset
 			uiOffset = offset;
@@ -546,7 +592,6 @@ tDirStatus ExtractAttributeValue (	tDataBufferPtr			 inOutDataBuff,
 	UInt16						usValueLen16	= 0;
 	UInt32						usValueLen		= 0;
 	UInt16						usAttrNameLen	= 0;
-	UInt32						i				= 0;
 	UInt32						uiIndex			= 0;
 	UInt32						offset			= 0;
 	char					   *p				= nil;
@@ -638,18 +683,10 @@ tDirStatus ExtractAttributeValue (	tDataBufferPtr			 inOutDataBuff,
 
 		if ( (bufTag == 'StdB') || (bufTag == 'DbgB') )
 		{
-			// Skip to the value that we want
-			for ( i = 1; i < uiIndex; i++ )
-			{
-				// Do record check, verify that offset is not past end of buffer, etc.
-				if (2 + offset > buffLen)  throw( (SInt32)eDSInvalidBuffFormat );
-			
-				// Get the length for the value
-				::memcpy( &usValueLen16, p, 2 );
-				
-				p		+= 2 + usValueLen16;
-				offset	+= 2 + usValueLen16;
-			}
+			// Look up the value that we want
+			siResult = GetIndexedItemOffset( inOutDataBuff, inAttrValueListRef, eAttrValueListRefType, uiIndex, offset, buffLen, usValueCnt, 2, &offset );
+			if ( siResult != eDSNoErr ) throw( siResult );
+			p = inOutDataBuff->fBufferData + offset;
 	
 			// Do record check, verify that offset is not past end of buffer, etc.
 			if (2 + offset > buffLen)  throw( (SInt32)eDSInvalidBuffFormat );
@@ -663,18 +700,10 @@ tDirStatus ExtractAttributeValue (	tDataBufferPtr			 inOutDataBuff,
 		}
 		else
 		{
-			// Skip to the value that we want
-			for ( i = 1; i < uiIndex; i++ )
-			{
-				// Do record check, verify that offset is not past end of buffer, etc.
-				if (4 + offset > buffLen)  throw( (SInt32)eDSInvalidBuffFormat );
-			
-				// Get the length for the value
-				::memcpy( &usValueLen, p, 4 );
-				
-				p		+= 4 + usValueLen;
-				offset	+= 4 + usValueLen;
-			}
+			// Look up the value that we want
+			siResult = GetIndexedItemOffset( inOutDataBuff, inAttrValueListRef, eAttrValueListRefType, uiIndex, offset, buffLen, usValueCnt, 4, &offset );
+			if ( siResult != eDSNoErr ) throw( siResult );
+			p = inOutDataBuff->fBufferData + offset;
 	
 			// Do record check, verify that offset is not past end of buffer, etc.
 			if (4 + offset > buffLen)  throw( (SInt32)eDSInvalidBuffFormat );
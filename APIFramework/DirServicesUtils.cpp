@@ -108,6 +108,8 @@ tDirStatus		dsDataListGetNode			(	tDataListPtr		inDataListPtr,
 
 static tDataNodePtr	dsGetThisNodePriv 				( tDataNode *inFirsNode, const UInt32 inIndex );
 static tDataNodePtr	dsGetLastNodePriv 				( tDataNode *inFirsNode );
+static void			dsSetListTailPriv				( tDataList *inDataList, tDataNode *inTail );
+static tDataNodePtr	dsGetListNodePriv				( const tDataList *inDataList, const UInt32 inIndex );
 static tDataNodePtr	dsAllocListNodeFromStringPriv	( const char *inString );
 static tDataNodePtr	dsAllocListNodeFromBuffPriv		( const void *inData, const UInt32 inSize );
 static tDirStatus	dsVerifyDataListPriv			( const tDataList *inDataList );
@@ -892,6 +894,8 @@ tDirStatus dsBuildListFromStringsAllocV ( tDirReference	inDirRef,
 
 	va_end( args );
 
+	::dsSetListTailPriv( inDataList, pPrevNode );
+
 	return( tResult );
 
 } // dsBuildListFromStringsAlloc
@@ -984,6 +988,8 @@ tDirStatus dsAppendStringToListAlloc (	tDirReference	inDirRef,
 			pNewNodePriv->fScriptCode = kASCIICodeScript;
 
 			inOutDataList->fDataNodeCount++;
+
+			::dsSetListTailPriv( inOutDataList, pNewNode );
 		}
 		else
 		{
@@ -1077,6 +1083,8 @@ tDirStatus dsBuildListFromNodesAlloc (	tDirReference	inDirRef,
 		pCurrNode = nil;
 	}
 
+	::dsSetListTailPriv( inDataList, pPrevNode );
+
 	return( tResult );
 
 } // dsBuildListFromNodesAlloc
@@ -1239,24 +1247,27 @@ tDirStatus dsDataListInsertAfter (	tDirReference			inDirRef,
 		pNextNode = inDataList->fDataListHead;
         inDataList->fDataListHead = pNewNode;
 
+		pNewNodePriv = (tDataBufferPriv *)pNewNode;
+		pNewNodePriv->fPrevPtr		= nil;
+		pNewNodePriv->fNextPtr		= pNextNode;
+		pNewNodePriv->fScriptCode	= kASCIICodeScript;
+
 		if ( pNextNode != nil )
 		{
+			// The old head carries the tail link, hand it to the new head
+			::dsSetListTailPriv( inDataList, ::dsGetLastNodePriv( pNextNode ) );
+
 			pNextNodeHdr = (tDataBufferPriv *)pNextNode;
 
 			// Set the next node's back pointer
 			pNextNodeHdr->fPrevPtr = pNewNode;
 		}
 
-		pNewNodePriv = (tDataBufferPriv *)pNewNode;
-		pNewNodePriv->fPrevPtr		= nil;
-		pNewNodePriv->fNextPtr		= pNextNode;
-		pNewNodePriv->fScriptCode	= kASCIICodeScript;
-
 		inDataList->fDataNodeCount++;
 	}
 	else
 	{
-		pCurrNode = ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex );
+		pCurrNode = ::dsGetListNodePriv( inDataList, inIndex );
 		if ( pCurrNode != nil )
 		{
 			// Get the current node's header and point it to the new
@@ -1285,6 +1296,11 @@ tDirStatus dsDataListInsertAfter (	tDirReference			inDirRef,
 			pNewNodePriv->fScriptCode = kASCIICodeScript;
 
 			inDataList->fDataNodeCount++;
+
+			if ( pNextNode == nil )
+			{
+				::dsSetListTailPriv( inDataList, pNewNode );
+			}
 		}
 		else
 		{
@@ -1382,12 +1398,12 @@ tDirStatus dsDataListMergeListAfter (	tDataList			   *inTargetList,
 // xxxx deal with 0 --- head of list index
 
 	// Get the merg point node
-	pCurrNode = ::dsGetThisNodePriv( inTargetList->fDataListHead, inIndex );
+	pCurrNode = ::dsGetListNodePriv( inTargetList, inIndex );
 
-	if ( inIndex < inTargetList->fDataNodeCount )
+	if ( (pCurrNode != nil) && (inIndex < inTargetList->fDataNodeCount) )
 	{
 		// Get the node after the merg point node
-		pNextNode = ::dsGetThisNodePriv( inTargetList->fDataListHead, inIndex + 1 );
+		pNextNode = ((tDataBufferPriv *)pCurrNode)->fNextPtr;
 	}
 
 	if ( (pFirstNode == nil) || (pLastNode == nil) || (pCurrNode == nil) )
@@ -1415,9 +1431,14 @@ tDirStatus dsDataListMergeListAfter (	tDataList			   *inTargetList,
 	else
 	{
 		pLastPrivData = (tDataBufferPriv *)pLastNode;
-		pCurrPrivData->fNextPtr = nil;
+		pLastPrivData->fNextPtr = nil;
+
+		// The source list's tail is now the end of the target list
+		::dsSetListTailPriv( inTargetList, pLastNode );
 	}
 
+	inTargetList->fDataNodeCount += inSourceList->fDataNodeCount;
+
 	return( tResult );
 
 } // dsDataListMergeListAfter
@@ -1456,9 +1477,9 @@ tDataListPtr dsDataListCopyList ( tDirReference inDirRef, const tDataList *inSou
 		return( nil );
 	}
 
-	for ( count = 1; count <= inSourceList->fDataNodeCount; count++ )
+	pCurrNode = inSourceList->fDataListHead;
+	for ( count = 1; (count <= inSourceList->fDataNodeCount) && (pCurrNode != nil); count++, pCurrNode = ((tDataBufferPriv *)pCurrNode)->fNextPtr )
 	{
-		pCurrNode = ::dsGetThisNodePriv( inSourceList->fDataListHead, count );
 		if ( pCurrNode != nil )
 		{
 			// Duplicate the data into a new node
@@ -1506,6 +1527,8 @@ tDataListPtr dsDataListCopyList ( tDirReference inDirRef, const tDataList *inSou
 		}
 	}
 
+	::dsSetListTailPriv( pOutList, pPrevNode );
+
 	return( pOutList );
 
 } // dsDataListCopyList
@@ -1572,7 +1595,7 @@ tDirStatus dsDataListDeleteThisNode (	tDirReference		inDirRef,
 	}
 
 	// Get the node we are looking for
-	pCurrNode = ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex );
+	pCurrNode = ::dsGetListNodePriv( inDataList, inIndex );
 	if ( pCurrNode != nil )
 	{
 		pCurrPriv = (tDataBufferPriv *)pCurrNode;
@@ -1581,17 +1604,19 @@ tDirStatus dsDataListDeleteThisNode (	tDirReference		inDirRef,
 
 		if ( inIndex == 1 )
 		{
-			// Delete the head of the list
+			// Delete the head of the list, the next node inherits the tail link
 			inDataList->fDataListHead = (tDataNode *)pNextPriv;
 			if ( pNextPriv != nil )
 			{
 				pNextPriv->fPrevPtr = nil;
+				::dsSetListTailPriv( inDataList, ::dsGetLastNodePriv( pCurrNode ) );
 			}
 		}
 		else if ( inIndex == inDataList->fDataNodeCount )
 		{
 			// Delete the last node from the list
 			pPrevPriv->fNextPtr = nil;
+			::dsSetListTailPriv( inDataList, (tDataNode *)pPrevPriv );
 		}
 		else
 		{
@@ -1652,7 +1677,7 @@ tDirStatus dsDataListGetNodeAlloc ( tDirReference				inDirRef,
 		return( eDSEmptyDataList );
 	}
 
-	pCurrNode = ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex );
+	pCurrNode = ::dsGetListNodePriv( inDataList, inIndex );
 	if ( pCurrNode == nil )
 	{
 		return( eDSIndexOutOfRange );
@@ -1973,6 +1998,13 @@ tDataNodePtr dsGetLastNodePriv ( tDataNode *inFirsNode )
 	pCurrNode = inFirsNode;
 	pPrivData = (tDataBufferPriv *)pCurrNode;
 
+	// the head of a list carries a back link to the tail (see dsSetListTailPriv), any other
+	//	node's back link is its predecessor which will never have a nil fNextPtr
+	if ( (pPrivData->fPrevPtr != nil) && (((tDataBufferPriv *)pPrivData->fPrevPtr)->fNextPtr == nil) )
+	{
+		return( pPrivData->fPrevPtr );
+	}
+
 	while ( pPrivData->fNextPtr != nil )
 	{
 		pCurrNode = pPrivData->fNextPtr;
@@ -1984,6 +2016,85 @@ tDataNodePtr dsGetLastNodePriv ( tDataNode *inFirsNode )
 } // dsGetLastNodePriv
 
 
+//--------------------------------------------------------------------------------------------------
+//	Name:	dsSetListTailPriv
+//
+//	The head node has no predecessor so its fPrevPtr is used to hold the last node of the list,
+//	this keeps appends and lookups near the end of the list from walking the whole thing.
+//	Anything that changes the head or the tail of a list must call this; pass nil to have the
+//	tail found by walking the list.
+//--------------------------------------------------------------------------------------------------
+
+void dsSetListTailPriv ( tDataList *inDataList, tDataNode *inTail )
+{
+	tDataBufferPriv    *pHeadData	= nil;
+
+	if ( (inDataList == nil) || (inDataList->fDataListHead == nil) )
+	{
+		return;
+	}
+
+	pHeadData = (tDataBufferPriv *)inDataList->fDataListHead;
+	if ( inTail == nil )
+	{
+		// don't trust whatever link is there now
+		pHeadData->fPrevPtr = nil;
+		inTail = ::dsGetLastNodePriv( inDataList->fDataListHead );
+	}
+
+	pHeadData->fPrevPtr = (inTail != inDataList->fDataListHead) ? inTail : nil;
+
+} // dsSetListTailPriv
+
+
+//--------------------------------------------------------------------------------------------------
+//	Name:	dsGetListNodePriv
+//
+//	Same as dsGetThisNodePriv but uses the node count to walk from whichever end of the list
+//	is closer to inIndex.
+//--------------------------------------------------------------------------------------------------
+
+tDataNodePtr dsGetListNodePriv ( const tDataList *inDataList, const UInt32 inIndex )
+{
+	UInt32				i			= 0;
+	tDataNode		   *pCurrNode	= nil;
+	tDataBufferPriv    *pPrivData	= nil;
+
+	if ( (inDataList == nil) || (inDataList->fDataListHead == nil) )
+	{
+		return( nil );
+	}
+
+	if ( (inIndex <= inDataList->fDataNodeCount / 2) || (inIndex > inDataList->fDataNodeCount) )
+	{
+		return( ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex ) );
+	}
+
+	pCurrNode = ::dsGetLastNodePriv( inDataList->fDataListHead );
+	for ( i = inDataList->fDataNodeCount; i > inIndex && pCurrNode != nil; i-- )
+	{
+		// the head's back link is the tail so never step past it
+		if ( pCurrNode == inDataList->fDataListHead )
+		{
+			pCurrNode = nil;
+			break;
+		}
+
+		pPrivData = (tDataBufferPriv *)pCurrNode;
+		pCurrNode = pPrivData->fPrevPtr;
+	}
+
+	// a list built without back links or with a stale count, the forward walk doesn't depend on either
+	if ( pCurrNode == nil )
+	{
+		return( ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex ) );
+	}
+
+	return( pCurrNode );
+
+} // dsGetListNodePriv
+
+
 //--------------------------------------------------------------------------------------------------
 //	Name:	dsAllocListNodeFromStringPriv
 //
@@ -32,6 +32,9 @@
 #include <sys/types.h>				// for mode_t
 #include <sys/stat.h>				// for mkdir() and stat()
 #include <libkern/OSAtomic.h>
+#include <dispatch/dispatch.h>
+#include <stdlib.h>
+#include <stdio.h>
 
 #include "CLog.h"
 #include "COSUtils.h"
@@ -50,6 +53,133 @@ OptionBits	CLog::fInfoLogFlags		= kLogMeta;
 
 static passthru_logging_fn	passthru_log_message = NULL;
 
+// ----------------------------------------------------------------------------
+//	* Asynchronous log ring
+//
+//	Messages are formatted on the calling thread (the CString format language
+//	takes pointers that are only valid for the duration of the call) and then
+//	handed to a bounded multi-producer ring.  Producers claim a slot with a
+//	single CAS and never block; when the ring is full the message is dropped
+//	and counted.  A serial queue drains the ring in batches and sends each
+//	message through the passthru with the context captured by the producer.
+// ----------------------------------------------------------------------------
+
+#define kLogRingSize			1024		// must be a power of 2
+#define kLogRingInlineLength	256
+
+typedef struct sLogRingSlot
+{
+	volatile int64_t		fSequence;
+	SInt32					fLevel;
+	passthru_log_context	fContext;
+	char				   *fLongMessage;
+	char					fMessage[kLogRingInlineLength];
+} sLogRingSlot;
+
+static sLogRingSlot			gLogRing[kLogRingSize];
+static volatile int64_t		gLogRingEnqueuePos		= 0;
+static int64_t				gLogRingDequeuePos		= 0;		// only touched by the drain queue
+static volatile int32_t		gLogRingDrainScheduled	= 0;
+static volatile int32_t		gLogRingDropped			= 0;
+static int32_t				gLogRingDroppedReported	= 0;		// only touched by the drain queue
+static dispatch_queue_t		gLogRingQueue			= NULL;
+static passthru_capture_fn	gLogRingCapture			= NULL;
+static passthru_send_fn		gLogRingSend			= NULL;
+
+static void LogRingDrain( void *inContext )
+{
+	passthru_send_fn	sendFn	= gLogRingSend;
+	
+	// clear the flag before looking at the ring so anything published after
+	// our last look schedules another drain
+	OSAtomicCompareAndSwap32Barrier( 1, 0, &gLogRingDrainScheduled );
+	
+	while ( 1 )
+	{
+		int64_t			pos		= gLogRingDequeuePos;
+		sLogRingSlot	*slot	= &gLogRing[pos & (kLogRingSize - 1)];
+		
+		OSMemoryBarrier();
+		if ( slot->fSequence != pos + 1 )
+			break;
+		
+		if ( sendFn != NULL )
+			sendFn( slot->fLevel, (slot->fLongMessage != NULL ? slot->fLongMessage : slot->fMessage), &slot->fContext );
+		else if ( passthru_log_message != NULL )
+			passthru_log_message( slot->fLevel, (slot->fLongMessage != NULL ? slot->fLongMessage : slot->fMessage) );
+		
+		DSFree( slot->fLongMessage );
+		
+		// hand the slot back to the producers for the next lap
+		OSMemoryBarrier();
+		slot->fSequence = pos + kLogRingSize;
+		gLogRingDequeuePos = pos + 1;
+	}
+	
+	int32_t dropped = gLogRingDropped;
+	if ( dropped != gLogRingDroppedReported && passthru_log_message != NULL )
+	{
+		char	buffer[128];
+		
+		snprintf( buffer, sizeof(buffer), "CLog: log ring full, dropped %d messages", dropped - gLogRingDroppedReported );
+		passthru_log_message( kLogWarning, buffer );
+		gLogRingDroppedReported = dropped;
+	}
+} // LogRingDrain
+
+static bool LogRingEnqueue( SInt32 inLevel, const CString &inMessage )
+{
+	sLogRingSlot	*slot	= NULL;
+	int64_t			pos		= gLogRingEnqueuePos;
+	
+	while ( 1 )
+	{
+		slot = &gLogRing[pos & (kLogRingSize - 1)];
+		
+		OSMemoryBarrier();
+		int64_t diff = slot->fSequence - pos;
+		if ( diff == 0 )
+		{
+			if ( OSAtomicCompareAndSwap64Barrier(pos, pos + 1, &gLogRingEnqueuePos) == true )
+				break;
+		}
+		else if ( diff < 0 )
+		{
+			// drain hasn't caught up with this slot, ring is full
+			OSAtomicIncrement32Barrier( &gLogRingDropped );
+			return false;
+		}
+		
+		pos = gLogRingEnqueuePos;
+	}
+	
+	slot->fLevel = inLevel;
+	gLogRingCapture( &slot->fContext );
+	
+	slot->fLongMessage = NULL;
+	if ( inMessage.GetLength() >= kLogRingInlineLength )
+		slot->fLongMessage = strdup( inMessage.GetData() );
+	if ( slot->fLongMessage == NULL )
+		strlcpy( slot->fMessage, inMessage.GetData(), sizeof(slot->fMessage) );
+	
+	// publish
+	OSMemoryBarrier();
+	slot->fSequence = pos + 1;
+	
+	if ( OSAtomicCompareAndSwap32Barrier(0, 1, &gLogRingDrainScheduled) == true )
+		dispatch_async_f( gLogRingQueue, NULL, LogRingDrain );
+	
+	return true;
+} // LogRingEnqueue
+
+static void LogSendMessage( SInt32 inLevel, const CString &inMessage )
+{
+	if ( gLogRingSend != NULL )
+		LogRingEnqueue( inLevel, inMessage );
+	else
+		passthru_log_message( inLevel, inMessage.GetData() );
+} // LogSendMessage
+
 //--------------------------------------------------------------------------------------------------
 //	* Initialize()
 //
@@ -78,9 +208,57 @@ SInt32 CLog::Initialize (	OptionBits srvrFlags,	OptionBits errFlags,
 
 void CLog::Deinitialize ( void )
 {
+	if ( gLogRingQueue != NULL )
+	{
+		// anything logged after this point goes out synchronously
+		gLogRingSend = NULL;
+		OSMemoryBarrier();
+		
+		dispatch_sync_f( gLogRingQueue, NULL, LogRingDrain );
+	}
 } // Deinitialize
 
 
+//--------------------------------------------------------------------------------------------------
+//	* SetAsyncPassthru()
+//
+//		Routes DbgLog/SrvrLog/ErrLog through the log ring.  inCapture runs on the logging
+//		thread, inSend runs later on the drain queue.
+//--------------------------------------------------------------------------------------------------
+
+void CLog::SetAsyncPassthru ( passthru_capture_fn inCapture, passthru_send_fn inSend )
+{
+	if ( inCapture == NULL || inSend == NULL )
+	{
+		Deinitialize();
+		return;
+	}
+	
+	if ( gLogRingQueue == NULL )
+	{
+		for ( int ii = 0; ii < kLogRingSize; ii++ )
+			gLogRing[ii].fSequence = ii;
+		
+		gLogRingQueue = dispatch_queue_create( "CLog ring drain", NULL );
+	}
+	
+	gLogRingCapture = inCapture;
+	OSMemoryBarrier();
+	gLogRingSend = inSend;
+} // SetAsyncPassthru
+
+
+//--------------------------------------------------------------------------------------------------
+//	* GetDroppedCount()
+//
+//--------------------------------------------------------------------------------------------------
+
+UInt32 CLog::GetDroppedCount ( void )
+{
+	return (UInt32) gLogRingDropped;
+} // GetDroppedCount
+
+
 //--------------------------------------------------------------------------------------------------
 //	* StartLogging()
 //
@@ -596,7 +774,7 @@ void SrvrLog ( SInt32 lType, const char *szpPattern, ... )
 		bool isLogging = CLog::IsLogging(keDebugLog, lType); // no application log anymore, just direct to debug log
 		if (passthru_log_message != NULL && isLogging == true) {
 			CString message = CString(szpPattern, args);
-			passthru_log_message(lType, message.GetData());
+			LogSendMessage(lType, message);
 		}
 	}
 } // SrvrLog
@@ -613,7 +791,7 @@ void ErrLog ( SInt32 lType, const char *szpPattern, ... )
 		bool isLogging = CLog::IsLogging(keDebugLog, kLogError); // no error log anymore, just direct to debug log
 		if (passthru_log_message != NULL && isLogging == true) {
 			CString message = CString(szpPattern, args);
-			passthru_log_message(kLogError, message.GetData());
+			LogSendMessage(kLogError, message);
 		}
 	}
 } // ErrLog
@@ -632,14 +810,14 @@ void DbgLog ( SInt32 lType, const char *szpPattern, ... )
 		bool isLogging = CLog::IsLogging(keErrorLog, lType);
 		if (passthru_log_message != NULL && isLogging == true) {
 			CString message = CString(szpPattern, args);
-			passthru_log_message(lType, message.GetData());
+			LogSendMessage(lType, message);
 		}
 	}
 	else {
 		bool isLogging = CLog::IsLogging(keDebugLog, lType);
 		if (passthru_log_message != NULL && isLogging == true) {
 			CString message = CString(szpPattern, args);
-			passthru_log_message(lType, message.GetData());
+			LogSendMessage(lType, message);
 		}
 	}
 } // DbgLog
@@ -52,6 +52,16 @@ typedef enum {
 
 typedef bool (*passthru_logging_fn)(int32_t level, const char *message);
 
+// per-thread state the passthru needs, captured on the logging thread so the
+// message can be sent later from the log drain thread
+typedef struct passthru_log_context {
+	uint64_t	reqid;
+	bool		session;
+} passthru_log_context;
+
+typedef void (*passthru_capture_fn)(passthru_log_context *outContext);
+typedef bool (*passthru_send_fn)(int32_t level, const char *message, const passthru_log_context *inContext);
+
 //-----------------------------------------------------------------------------
 //	* CLog: a little more than your basic log class.
 //
@@ -109,6 +119,8 @@ public:
 	static CLog*	GetErrorLog			( void );
 	static CLog*	GetDebugLog			( void );
 	static CLog*	GetInfoLog			( void );
+	static void		SetAsyncPassthru	( passthru_capture_fn inCapture, passthru_send_fn inSend );
+	static UInt32	GetDroppedCount		( void );
 
 public:
 				CLog (	const char		*file,
@@ -27,6 +27,12 @@
 
 #include "CRCCalc.h"
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+	#include <arm_acle.h>
+#endif
 
 // Consts ----------------------------------------------------------------------------
 
@@ -149,27 +155,135 @@ UInt32 CRCCalc::UPDC32 ( register unsigned char b, register UInt32 c )
 }
 
 // ---------------------------------------------------------------------------
-//	* CalcCRC
+//	Value IDs are a reflected CRC32 (polynomial 0xedb88320, seeded with
+//	0xFFFFFFFF, no final xor), the same thing UPDC32 computes a byte at a time.
+//	ARMv8 has instructions for exactly this polynomial; everywhere else the
+//	data is folded 8 bytes per step with slice-by-8 tables built from cr3tab.
+//	(The SSE4.2 crc32 instruction uses the Castagnoli polynomial so it would
+//	change every ID.)
 // ---------------------------------------------------------------------------
 
-UInt32 CalcCRC ( const char *inStr )
+#define CRC32_BYTE(c, b)	((UInt32)cr3tab[((c) ^ (b)) & 0xff] ^ ((c) >> 8))
+
+// CalcCRC reads the whole aligned word holding the terminator, which AddressSanitizer reports as an
+// overflow even though the word can't cross a page boundary
+#if defined(__has_attribute)
+	#if __has_attribute(no_sanitize)
+		#define CRC32_NO_SANITIZE_ADDRESS	__attribute__((no_sanitize("address")))
+	#endif
+#endif
+#ifndef CRC32_NO_SANITIZE_ADDRESS
+	#define CRC32_NO_SANITIZE_ADDRESS
+#endif
+
+// memcpy keeps the load legal for any alignment and type, the compiler turns it into a single load
+CRC32_NO_SANITIZE_ADDRESS static inline uint64_t CRC32LoadWord ( const unsigned char *inBytes )
 {
-	const char 	   *p			= inStr;
-	size_t			siI			= 0;
-	size_t			siStrLen	= 0;
-	UInt32			uiCRC		= 0xFFFFFFFF;
-	CRCCalc			aCRCCalc;
+	uint64_t word;
 	
-	if ( inStr != NULL )
+	memcpy( &word, inBytes, sizeof(word) );
+	
+	return word;
+}
+
+#if defined(__ARM_FEATURE_CRC32)
+
+static inline UInt32 CRC32Fold8 ( UInt32 inCRC, uint64_t inWord )
+{
+	return __crc32d( inCRC, inWord );
+}
+
+#else
+
+static UInt32			gCRCSliceTab[8][256];
+static pthread_once_t	gCRCSliceTabOnce	= PTHREAD_ONCE_INIT;
+
+static void BuildCRCSliceTab ( void )
+{
+	for ( int i = 0; i < 256; i++ )
 	{
-		siStrLen = ::strlen( inStr );
-		
-		for ( siI = 0; siI < siStrLen; ++siI )
+		gCRCSliceTab[0][i] = (UInt32) cr3tab[i];
+	}
+	
+	for ( int i = 0; i < 256; i++ )
+	{
+		for ( int k = 1; k < 8; k++ )
 		{
-			uiCRC = aCRCCalc.UPDC32( *p, uiCRC );
-			p++;
+			UInt32 c = gCRCSliceTab[k - 1][i];
+			gCRCSliceTab[k][i] = (c >> 8) ^ gCRCSliceTab[0][c & 0xff];
 		}
 	}
+}
+
+static inline UInt32 CRC32Fold8 ( UInt32 inCRC, uint64_t inWord )
+{
+	UInt32 one = (UInt32) inWord ^ inCRC;
+	UInt32 two = (UInt32) (inWord >> 32);
+	
+	return	gCRCSliceTab[7][one & 0xff] ^ gCRCSliceTab[6][(one >> 8) & 0xff] ^
+			gCRCSliceTab[5][(one >> 16) & 0xff] ^ gCRCSliceTab[4][one >> 24] ^
+			gCRCSliceTab[3][two & 0xff] ^ gCRCSliceTab[2][(two >> 8) & 0xff] ^
+			gCRCSliceTab[1][(two >> 16) & 0xff] ^ gCRCSliceTab[0][two >> 24];
+}
+
+#endif
+
+// words are folded in memory order which only works out on little endian hosts
+#if defined(__ARM_FEATURE_CRC32) || defined(__LITTLE_ENDIAN__) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	#define CRC32_FOLD_WORDS	1
+#else
+	#define CRC32_FOLD_WORDS	0
+#endif
+
+static inline void CRC32Init ( void )
+{
+#if CRC32_FOLD_WORDS && !defined(__ARM_FEATURE_CRC32)
+	pthread_once( &gCRCSliceTabOnce, BuildCRCSliceTab );
+#endif
+}
+
+// ---------------------------------------------------------------------------
+//	* CalcCRC
+//
+//	Finds the end of the string as it goes rather than taking strlen first.
+//	Aligned 8 byte reads can't cross into the next page so reading past the
+//	terminator within the last word is safe.
+// ---------------------------------------------------------------------------
+
+CRC32_NO_SANITIZE_ADDRESS UInt32 CalcCRC ( const char *inStr )
+{
+	const unsigned char	   *p		= (const unsigned char *)inStr;
+	UInt32					uiCRC	= 0xFFFFFFFF;
+	
+	if ( inStr == NULL )
+		return( uiCRC );
+	
+#if CRC32_FOLD_WORDS
+	CRC32Init();
+	
+	for ( ; ((uintptr_t)p & 7) != 0; p++ )
+	{
+		if ( *p == '\0' )
+			return( uiCRC );
+		uiCRC = CRC32_BYTE( uiCRC, *p );
+	}
+	
+	for ( ;; p += 8 )
+	{
+		uint64_t word = CRC32LoadWord( p );
+		
+		// stop folding words once one of the bytes is zero
+		if ( ((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) != 0 )
+			break;
+		
+		uiCRC = CRC32Fold8( uiCRC, word );
+	}
+#endif
+	
+	for ( ; *p != '\0'; p++ )
+	{
+		uiCRC = CRC32_BYTE( uiCRC, *p );
+	}
 	
 	return( uiCRC );
 	
@@ -184,19 +298,29 @@ UInt32 CalcCRCWithLength ( const void *inData, UInt32 inLength )
 {
 	const unsigned char	   *p		= (const unsigned char *)inData;
 	UInt32					uiCRC	= 0xFFFFFFFF;
-	CRCCalc					aCRCCalc;
 	
-	if ( inData != nil )
+	if ( inData == nil )
+		return( uiCRC );
+	
+#if CRC32_FOLD_WORDS
+	CRC32Init();
+	
+	for ( ; inLength > 0 && ((uintptr_t)p & 7) != 0; inLength-- )
 	{
-		for ( UInt32 i = 0; i < inLength; ++i )
-		{
-			uiCRC = aCRCCalc.UPDC32( *p, uiCRC );
-			p++;
-		}
+		uiCRC = CRC32_BYTE( uiCRC, *p++ );
+	}
+	
+	for ( ; inLength >= 8; inLength -= 8, p += 8 )
+	{
+		uiCRC = CRC32Fold8( uiCRC, CRC32LoadWord(p) );
+	}
+#endif
+	
+	for ( ; inLength > 0; inLength-- )
+	{
+		uiCRC = CRC32_BYTE( uiCRC, *p++ );
 	}
 	
 	return( uiCRC );
 	
 } // CalcCRCWithLength
-
-
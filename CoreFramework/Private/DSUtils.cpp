@@ -35,6 +35,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>		// for offsetof()
 #include <stdarg.h>
 #include <stdio.h>
 #include <mach/mach_time.h>	// for dsTimeStamp
@@ -444,6 +445,8 @@ tDirStatus dsAppendStringToListAllocPriv (	tDataList	   *inOutDataList,
 			pNewNodeData->fScriptCode = kASCIICodeScript;
 
 			inOutDataList->fDataNodeCount++;
+
+			::dsSetListTailPriv( inOutDataList, pNewNode );
 		}
 		else
 		{
@@ -525,6 +528,99 @@ tDataNodePtr dsAllocListNodeFromBuffPriv ( const void *inData, const UInt32 inSi
 } // dsAllocListNodeFromBuffPriv
 
 
+//--------------------------------------------------------------------------------------------------
+//	Name:	dsGetMsgObjPriv
+//
+//	Finds the object of inType in the message.  Each call for a given API puts its values
+//	in the same order, so the slot a type was last found in is kept as a hint and checked
+//	first.  The hint is only a guess shared by all threads, a hit is verified against the
+//	message and a miss falls back to the scan, so the wire layout is untouched.
+//--------------------------------------------------------------------------------------------------
+
+#define kMsgObjCount		10
+#define kMsgObjTypeCount	(ktNodeRefMap - kResult + 1)
+
+static UInt8 gMsgObjSlotHint[ kMsgObjTypeCount ] = { 0 };
+
+tDirStatus dsGetMsgObjPriv ( sComData *inMsg, UInt32 inType, sObject **outObj )
+{
+	UInt32		hintIndex	= inType - kResult;
+	UInt32		i;
+
+	if ( hintIndex < kMsgObjTypeCount )
+	{
+		i = gMsgObjSlotHint[ hintIndex ];
+		if ( inMsg->obj[ i ].type == inType )
+		{
+			*outObj = &inMsg->obj[ i ];
+			return( eDSNoErr );
+		}
+	}
+
+	for ( i = 0; i < kMsgObjCount; i++ )
+	{
+		if ( inMsg->obj[ i ].type == inType )
+		{
+			if ( hintIndex < kMsgObjTypeCount )
+			{
+				gMsgObjSlotHint[ hintIndex ] = i;
+			}
+			
+			*outObj = &inMsg->obj[ i ];
+			return( eDSNoErr );
+		}
+	}
+
+	return( eDSIndexNotFound );
+
+} // dsGetMsgObjPriv
+
+
+//--------------------------------------------------------------------------------------------------
+//	Name:	dsGetEmptyMsgObjPriv
+//
+//	Objects are added in order, so the first empty slot follows the last used one and its
+//	data starts where the previous object's data ends.  Fails if inType is already present.
+//--------------------------------------------------------------------------------------------------
+
+tDirStatus dsGetEmptyMsgObjPriv ( sComData *inMsg, UInt32 inType, sObject **outObj )
+{
+	UInt32		hintIndex	= inType - kResult;
+	UInt32		i;
+
+	for ( i = 0; i < kMsgObjCount; i++ )
+	{
+		if ( inMsg->obj[ i ].type == 0 )
+		{
+			*outObj = &inMsg->obj[ i ];
+			if ( i == 0 )
+			{
+				(*outObj)->offset = offsetof(struct sComData, data);
+			}
+			else
+			{
+				(*outObj)->offset = inMsg->obj[ i - 1 ].offset + inMsg->obj[ i - 1 ].length;
+			}
+			
+			// the reader will most likely look for this type here
+			if ( hintIndex < kMsgObjTypeCount )
+			{
+				gMsgObjSlotHint[ hintIndex ] = i;
+			}
+			
+			return( eDSNoErr );
+		}
+		else if ( inMsg->obj[ i ].type == inType )
+		{
+			break;
+		}
+	}
+
+	return( eDSIndexNotFound );
+
+} // dsGetEmptyMsgObjPriv
+
+
 //--------------------------------------------------------------------------------------------------
 //	Name:	dsGetThisNodePriv
 //
@@ -569,6 +665,13 @@ tDataNodePtr dsGetLastNodePriv ( tDataNode *inFirsNode )
 	pCurrNode = inFirsNode;
 	pPrivData = (tDataBufferPriv *)pCurrNode;
 
+	// the head of a list carries a back link to the tail (see dsSetListTailPriv), any other
+	//	node's back link is its predecessor which will never have a nil fNextPtr
+	if ( (pPrivData->fPrevPtr != nil) && (((tDataBufferPriv *)pPrivData->fPrevPtr)->fNextPtr == nil) )
+	{
+		return( pPrivData->fPrevPtr );
+	}
+
 	while ( pPrivData->fNextPtr != nil )
 	{
 		pCurrNode = pPrivData->fNextPtr;
@@ -580,6 +683,85 @@ tDataNodePtr dsGetLastNodePriv ( tDataNode *inFirsNode )
 } // dsGetLastNodePriv
 
 
+//--------------------------------------------------------------------------------------------------
+//	Name:	dsSetListTailPriv
+//
+//	The head node has no predecessor so its fPrevPtr is used to hold the last node of the list,
+//	this keeps appends and lookups near the end of the list from walking the whole thing.
+//	Anything that changes the head or the tail of a list must call this; pass nil to have the
+//	tail found by walking the list.
+//--------------------------------------------------------------------------------------------------
+
+void dsSetListTailPriv ( tDataListPtr inDataList, tDataNodePtr inTail )
+{
+	tDataBufferPriv    *pHeadData	= nil;
+
+	if ( (inDataList == nil) || (inDataList->fDataListHead == nil) )
+	{
+		return;
+	}
+
+	pHeadData = (tDataBufferPriv *)inDataList->fDataListHead;
+	if ( inTail == nil )
+	{
+		// don't trust whatever link is there now
+		pHeadData->fPrevPtr = nil;
+		inTail = ::dsGetLastNodePriv( inDataList->fDataListHead );
+	}
+
+	pHeadData->fPrevPtr = (inTail != inDataList->fDataListHead) ? inTail : nil;
+
+} // dsSetListTailPriv
+
+
+//--------------------------------------------------------------------------------------------------
+//	Name:	dsGetListNodePriv
+//
+//	Same as dsGetThisNodePriv but uses the node count to walk from whichever end of the list
+//	is closer to inIndex.
+//--------------------------------------------------------------------------------------------------
+
+tDataNodePtr dsGetListNodePriv ( const tDataList *inDataList, const UInt32 inIndex )
+{
+	UInt32				i			= 0;
+	tDataNode		   *pCurrNode	= nil;
+	tDataBufferPriv    *pPrivData	= nil;
+
+	if ( (inDataList == nil) || (inDataList->fDataListHead == nil) )
+	{
+		return( nil );
+	}
+
+	if ( (inIndex <= inDataList->fDataNodeCount / 2) || (inIndex > inDataList->fDataNodeCount) )
+	{
+		return( ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex ) );
+	}
+
+	pCurrNode = ::dsGetLastNodePriv( inDataList->fDataListHead );
+	for ( i = inDataList->fDataNodeCount; i > inIndex && pCurrNode != nil; i-- )
+	{
+		// the head's back link is the tail so never step past it
+		if ( pCurrNode == inDataList->fDataListHead )
+		{
+			pCurrNode = nil;
+			break;
+		}
+
+		pPrivData = (tDataBufferPriv *)pCurrNode;
+		pCurrNode = pPrivData->fPrevPtr;
+	}
+
+	// a list built without back links or with a stale count, the forward walk doesn't depend on either
+	if ( pCurrNode == nil )
+	{
+		return( ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex ) );
+	}
+
+	return( pCurrNode );
+
+} // dsGetListNodePriv
+
+
 //--------------------------------------------------------------------------------------------------
 //	Name:	dsAppendStringToListPriv
 //
@@ -644,6 +826,8 @@ tDirStatus dsAppendStringToListPriv ( tDataListPtr inOutDataList, const char *in
 			pNewNodeData->fScriptCode = kASCIICodeScript;
 
 			inOutDataList->fDataNodeCount++;
+
+			::dsSetListTailPriv( inOutDataList, pNewNode );
 		}
 		else
 		{
@@ -716,30 +900,20 @@ tDirStatus dsDataListGetNodePriv ( tDataListPtr		inDataList,
 									UInt32			inNodeIndex,
 									tDataNodePtr	*outDataListNode )
 {
-	UInt32				i			= 0;
 	tDirStatus			tdsResult	= eDSNoErr;
 	tDataNodePtr		pCurrNode	= nil;
-	tDataBufferPriv    *pPrivData	= nil;
 
 	*outDataListNode = nil;
 
 	if ( inDataList != nil )
 	{
-		pCurrNode = inDataList->fDataListHead;
-
-		// Get the list total length
-		for ( i = 1; i < inNodeIndex; i++ )
+		if ( inNodeIndex <= 1 )
 		{
-			pPrivData = (tDataBufferPriv *)pCurrNode;
-			if ( pPrivData->fNextPtr == nil )
-			{
-				pCurrNode = nil;
-				break;
-			}
-			else
-			{
-				pCurrNode = pPrivData->fNextPtr;
-			}
+			pCurrNode = inDataList->fDataListHead;
+		}
+		else
+		{
+			pCurrNode = ::dsGetListNodePriv( inDataList, inNodeIndex );
 		}
 
 		if ( pCurrNode != nil )
@@ -765,31 +939,14 @@ tDirStatus dsDataListGetNodePriv ( tDataListPtr		inDataList,
 char* dsDataListGetNodeStringPriv (	tDataListPtr	inDataList,
 									UInt32			inNodeIndex )
 {
-	UInt32				iSegment	= 0;
 	tDataNodePtr		pCurrNode	= nil;
 	tDataBufferPriv    *pPrivData	= nil;
 	char			   *outSegStr	= nil;
 
 	if ( ( inDataList != nil ) && ( inNodeIndex > 0 ) && ( inNodeIndex <= inDataList->fDataNodeCount ) )
 	{
-		pCurrNode = inDataList->fDataListHead;
-
 		// Find the one we are interested in
-		iSegment = 1;
-		while ( (iSegment < inNodeIndex ) && ( pCurrNode != nil) )
-		{
-			pPrivData = (tDataBufferPriv *)pCurrNode;
-			
-			if ( pPrivData->fNextPtr == nil )
-			{
-				pCurrNode = nil;
-			}
-			else
-			{
-				pCurrNode = pPrivData->fNextPtr;
-			}
-			iSegment++;
-		}
+		pCurrNode = ::dsGetListNodePriv( inDataList, inNodeIndex );
 
 		if ( pCurrNode != nil )
 		{
@@ -895,6 +1052,7 @@ tDataList* dsBuildListFromStringsPriv ( const char *in1stCString, ... )
 	va_end( args );
 
 	pOutList->fDataNodeCount = nodeCount;
+	::dsSetListTailPriv( pOutList, pPrevNode );
 
 	return( pOutList );
 
@@ -929,7 +1087,7 @@ tDirStatus dsDataListGetNodeAllocPriv ( const tDataList		   *inDataList,
 		return( eDSEmptyDataList );
 	}
 
-	pCurrNode = ::dsGetThisNodePriv( inDataList->fDataListHead, inIndex );
+	pCurrNode = ::dsGetListNodePriv( inDataList, inIndex );
 	if ( pCurrNode == nil )
 	{
 		return( eDSIndexOutOfRange );
@@ -1100,6 +1258,10 @@ tDirStatus dsAuthBufferGetDataListPriv ( tDataBufferPtr inAuthBuff, tDataListPtr
 		// clean up if there was an errors
 		dsDataListDeallocatePriv(inOutDataList);
 	}
+	else
+	{
+		::dsSetListTailPriv( inOutDataList, pPrevNode );
+	}
 	return( tResult );
 
 } // dsAuthBufferGetDataListPriv
@@ -1560,6 +1722,8 @@ tDataListPtr dsConvertCFArrayToDataList( CFArrayRef inArray )
 				pCurNodeData = pNewNodeData;
 			}
 		}
+		
+		dsSetListTailPriv( dsDataList, (tDataNodePtr) pCurNodeData );
 	}
 	
 	return dsDataList;
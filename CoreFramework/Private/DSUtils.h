@@ -39,6 +39,9 @@
 
 #define kDSNodeEvent							"com.apple.DirectoryService.node.event"
 
+struct sComData;
+struct sObject;
+
 __BEGIN_DECLS
 
 tDataBufferPtr			dsDataBufferAllocatePriv			( UInt32 inBufferSize );
@@ -52,6 +55,8 @@ tDirStatus				dsAppendStringToListAllocPriv		( tDataList *inOutDataList, const c
 tDataNodePtr			dsAllocListNodeFromStringPriv		( const char *inString );
 tDataNodePtr			dsGetThisNodePriv					( tDataNode *inFirsNode, const UInt32 inIndex );
 tDataNodePtr			dsGetLastNodePriv					( tDataNode *inFirsNode );
+void					dsSetListTailPriv					( tDataListPtr inDataList, tDataNodePtr inTail );
+tDataNodePtr			dsGetListNodePriv					( const tDataList *inDataList, const UInt32 inIndex );
 tDirStatus				dsAppendStringToListPriv			( tDataList *inDataList, const char *inCString );
 tDirStatus				dsDeleteLastNodePriv				( tDataList *inDataList );
 UInt32					dsDataListGetNodeCountPriv			( tDataList *inDataList );
@@ -63,6 +68,9 @@ tDataListPtr			dsAuthBufferGetDataListAllocPriv	( tDataBufferPtr inAuthBuff );
 tDirStatus				dsAuthBufferGetDataListPriv			( tDataBufferPtr inAuthBuff, tDataListPtr inOutDataList );
 char*					dsCStrFromCharacters				( const char *inChars, size_t inLen );
 
+tDirStatus				dsGetMsgObjPriv						( struct sComData *inMsg, UInt32 inType, struct sObject **outObj );
+tDirStatus				dsGetEmptyMsgObjPriv				( struct sComData *inMsg, UInt32 inType, struct sObject **outObj );
+
 void					BinaryToHexConversion				( const unsigned char *inBinary, UInt32 inLength, char *outHexStr );
 void					HexToBinaryConversion				( const char *inHexStr, UInt32 *outLength, unsigned char *outBinary );
 
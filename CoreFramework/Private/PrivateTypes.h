@@ -29,6 +29,8 @@
 #define	__PrivateTypes_h__	1
 
 #include <DirectoryService/DirServicesTypes.h>
+#include <stdint.h>
+#include <stddef.h>
 
 #ifdef DSDEBUGLOGFW
 	#include <syslog.h>
@@ -167,7 +169,7 @@ typedef struct
 	UInt32		fBufferSize;
 	UInt32		fBufferLength;
 
-	tDataNodePtr		fPrevPtr;
+	tDataNodePtr		fPrevPtr;		// the head node of a list keeps the last node here
 	tDataNodePtr		fNextPtr;
 	UInt32				fType;
 	eScriptCode			fScriptCode;
@@ -300,4 +302,28 @@ class CIPCVirtualClass
 #define DSexpect_true(x) ((typeof(x))__builtin_expect((long)(x), 1l))
 #define DSexpect_false(x) ((typeof(x))__builtin_expect((long)(x), 0l))
 
+// 32-bit FNV-1a, used to key the daemon's in-memory hash tables
+static inline uint32_t DSHashBytes( const void *inData, size_t inLength )
+{
+	const uint8_t	*bytes		= (const uint8_t *) inData;
+	uint32_t		hashval		= 2166136261U;
+	
+	for ( size_t ii = 0; ii < inLength; ii++ ) {
+		hashval = (hashval ^ bytes[ii]) * 16777619U;
+	}
+	
+	return hashval;
+}
+
+static inline uint32_t DSHashString( const char *inString )
+{
+	uint32_t	hashval	= 2166136261U;
+	
+	while ( (*inString) != '\0' ) {
+		hashval = (hashval ^ (uint8_t) (*inString++)) * 16777619U;
+	}
+	
+	return hashval;
+}
+
 #endif
@@ -2391,12 +2391,11 @@ tDirStatus BaseDirectoryPlugin::GetRecAttrValueByID( sGetRecordAttributeValueByI
 			
 			if ( cfValues != NULL )
 			{
-				CFIndex	valueCount	= CFArrayGetCount( cfValues );
-				bool	bFoundOrErr	= false;
+				CFIndex	valueIndex	= FindValueIndexByID( pContext, cfAttribute, cfValues, inData->fInValueID );
 				
-				for( CFIndex ii = 0; ii < valueCount && bFoundOrErr == false; ii++ )
+				if ( valueIndex != kCFNotFound )
 				{
-					CFTypeRef	cfValue		= CFArrayGetValueAtIndex( cfValues, ii );
+					CFTypeRef	cfValue		= CFArrayGetValueAtIndex( cfValues, valueIndex );
 					char		*pString	= NULL;
 					const char	*pValue		= NULL;
 					UInt32		valueLen	= 0;
@@ -2412,28 +2411,23 @@ tDirStatus BaseDirectoryPlugin::GetRecAttrValueByID( sGetRecordAttributeValueByI
 						valueLen = strlen( pString );
 					}
 					
-					if ( CalcCRCWithLength(pValue, valueLen) == inData->fInValueID )
+					tAttributeValueEntry *pAttrValue = (tAttributeValueEntry *) calloc( 1, sizeof(tAttributeValueEntry) + valueLen + kBPDIBufferTax );
+					
+					if ( pAttrValue != NULL )
 					{
-						tAttributeValueEntry *pAttrValue = (tAttributeValueEntry *) calloc( 1, sizeof(tAttributeValueEntry) + valueLen + kBPDIBufferTax );
+						pAttrValue->fAttributeValueData.fBufferSize		= valueLen + kBPDIBufferTax;
+						pAttrValue->fAttributeValueData.fBufferLength	= valueLen;
+						pAttrValue->fAttributeValueID					= inData->fInValueID;
 						
-						if ( pAttrValue != NULL )
-						{
-							pAttrValue->fAttributeValueData.fBufferSize		= valueLen + kBPDIBufferTax;
-							pAttrValue->fAttributeValueData.fBufferLength	= valueLen;
-							pAttrValue->fAttributeValueID					= inData->fInValueID;
-							
-							bcopy( pValue, pAttrValue->fAttributeValueData.fBufferData, valueLen );
-							
-							inData->fOutEntryPtr = pAttrValue;
-
-							siResult = eDSNoErr;
-							bFoundOrErr = true;
-						}
-						else
-						{
-							siResult = eMemoryAllocError;
-							bFoundOrErr = true;
-						}
+						bcopy( pValue, pAttrValue->fAttributeValueData.fBufferData, valueLen );
+						
+						inData->fOutEntryPtr = pAttrValue;
+						
+						siResult = eDSNoErr;
+					}
+					else
+					{
+						siResult = eMemoryAllocError;
 					}
 					
 					DSFreeString( pString );
@@ -2698,40 +2692,19 @@ tDirStatus BaseDirectoryPlugin::RemoveAttributeValue( sRemoveAttributeValue *inD
 			
 			if ( cfValues != NULL )
 			{
-				CFIndex	valueCount	= CFArrayGetCount( cfValues );
-				bool	bFoundOrErr	= false;
+				CFIndex	valueIndex	= FindValueIndexByID( pContext, cfAttribute, cfValues, inData->fInAttrValueID );
 				
-				for( CFIndex ii = 0; ii < valueCount && bFoundOrErr == false; ii++ )
+				if ( valueIndex != kCFNotFound )
 				{
-					CFTypeRef	cfValue		= CFArrayGetValueAtIndex( cfValues, ii );
-					char		*pString	= NULL;
-					const char	*pValue		= NULL;
-					UInt32		valueLen	= 0;
-					
-					if ( CFGetTypeID(cfValue) == CFDataGetTypeID() )
-					{
-						pValue = (const char *) CFDataGetBytePtr( (CFDataRef) cfValue );
-						valueLen = CFDataGetLength( (CFDataRef) cfValue );
-					}
-					else
-					{
-						pValue = GetCStringFromCFString( (CFStringRef) cfValue, &pString );
-						valueLen = strlen( pString );
-					}
+					CFTypeRef	cfValue	= CFArrayGetValueAtIndex( cfValues, valueIndex );
 					
-					if ( CalcCRCWithLength(pValue, valueLen) == inData->fInAttrValueID )
-					{
 #ifndef __OBJC__
-						siResult = pContext->fVirtualNode->RecordRemoveValueFromAttribute( pContext->fRecord, cfAttribute, cfValue );
+					siResult = pContext->fVirtualNode->RecordRemoveValueFromAttribute( pContext->fRecord, cfAttribute, cfValue );
 #else
-						siResult = [pContext->fVirtualNode record: (NSMutableDictionary *)pContext->fRecord
-													  removeValue: (id)cfValue
-													fromAttribute: (NSString *)cfAttribute];
+					siResult = [pContext->fVirtualNode record: (NSMutableDictionary *)pContext->fRecord
+												  removeValue: (id)cfValue
+												fromAttribute: (NSString *)cfAttribute];
 #endif
-						bFoundOrErr = true;
-					}
-					
-					DSFreeString( pString );
 				}
 			}
 		}
@@ -2786,61 +2759,40 @@ tDirStatus BaseDirectoryPlugin::SetAttributeValue ( sSetAttributeValue *inData,
 			{
 				cfValues = CFArrayCreateMutableCopy( kCFAllocatorDefault, 0, cfOldValues );
 				
-				// we need to loop through the values and find the value we are replacing
-				CFIndex	cfCount		= CFArrayGetCount( cfValues );
+				// find the value we are replacing
+				CFIndex	ii			= FindValueIndexByID( pContext, cfAttribute, cfOldValues, valueID );
 				bool	bFoundOrErr	= false;
 				
-				for( CFIndex ii = 0; ii < cfCount && bFoundOrErr == false; ii++ )
+				if ( ii != kCFNotFound )
 				{
-					CFTypeRef	cfValue		= CFArrayGetValueAtIndex( cfValues, ii );
-					char		*pString	= NULL;
-					const char	*pValue		= NULL;
-					UInt32		valueLen	= 0;
+					CFStringRef cfNewValue = CFStringCreateWithBytes( kCFAllocatorDefault, 
+																	 (const UInt8 *) inData->fInAttrValueEntry->fAttributeValueData.fBufferData, 
+																	 inData->fInAttrValueEntry->fAttributeValueData.fBufferLength,
+																	 kCFStringEncodingUTF8, false );
 					
-					if ( CFGetTypeID(cfValue) == CFDataGetTypeID() )
-					{
-						pValue = (const char *) CFDataGetBytePtr( (CFDataRef) cfValue );
-						valueLen = CFDataGetLength( (CFDataRef) cfValue );
-					}
-					else
-					{
-						pValue = GetCStringFromCFString( (CFStringRef) cfValue, &pString );
-						valueLen = strlen( pString );
-					}
-					
-					if ( CalcCRCWithLength(pValue, valueLen) == valueID )
+					if ( cfNewValue != NULL )
 					{
-						CFStringRef cfNewValue = CFStringCreateWithBytes( kCFAllocatorDefault, 
-																		 (const UInt8 *) inData->fInAttrValueEntry->fAttributeValueData.fBufferData, 
-																		 inData->fInAttrValueEntry->fAttributeValueData.fBufferLength,
-																		 kCFStringEncodingUTF8, false );
-						
-						if ( cfNewValue != NULL )
+						CFDataRef cfData = CFDataCreate( kCFAllocatorDefault, 
+														 (const UInt8 *) inData->fInAttrValueEntry->fAttributeValueData.fBufferData,
+														 inData->fInAttrValueEntry->fAttributeValueData.fBufferLength );
+						if ( cfData != NULL )
 						{
-							CFDataRef cfData = CFDataCreate( kCFAllocatorDefault, 
-															 (const UInt8 *) inData->fInAttrValueEntry->fAttributeValueData.fBufferData,
-															 inData->fInAttrValueEntry->fAttributeValueData.fBufferLength );
-							if ( cfData != NULL )
-							{
-								CFArraySetValueAtIndex( cfValues, ii, cfData );
-								DSCFRelease( cfData );
-							}
-							else
-							{
-								siResult = eMemoryAllocError;
-								DSCFRelease( cfValues );
-							}
+							CFArraySetValueAtIndex( cfValues, ii, cfData );
+							DSCFRelease( cfData );
 						}
 						else
 						{
-							CFArraySetValueAtIndex( cfValues, ii, cfNewValue );
-							DSCFRelease( cfNewValue );
+							siResult = eMemoryAllocError;
+							DSCFRelease( cfValues );
 						}
-						
-						bFoundOrErr = true;
+					}
+					else
+					{
+						CFArraySetValueAtIndex( cfValues, ii, cfNewValue );
+						DSCFRelease( cfNewValue );
 					}
 					
-					DSFreeString( pString );
+					bFoundOrErr = true;
 				}
 				
 				// if not found
@@ -2982,8 +2934,9 @@ tDirStatus BaseDirectoryPlugin::FillBuffer( CFMutableArrayRef inRecordList, BDPI
     UInt32			startTag			= 'StdA';
     UInt32			endTag				= 'EndT';
     UInt32			outRecEntryCount	= 0;
+	CFIndex			recordCount			= (inRecordList != NULL ? CFArrayGetCount(inRecordList) : 0);
 
-	if ( inRecordList != NULL && CFArrayGetCount(inRecordList) > 0 )
+	if ( recordCount > 0 )
 	{
         // make buffer size and length the same
         inDataBuff->fBufferLength = inDataBuff->fBufferSize;
@@ -2994,47 +2947,46 @@ tDirStatus BaseDirectoryPlugin::FillBuffer( CFMutableArrayRef inRecordList, BDPI
         *numRecords = 0;
 
         // Now lets loop through the records until we fill the buffer...
-        while (buffLeft && CFArrayGetCount(inRecordList))
+        while ( buffLeft > 9 && (CFIndex) outRecEntryCount < recordCount )
 		{
-			CFDictionaryRef	cfRecDict	= (CFDictionaryRef) CFArrayGetValueAtIndex( inRecordList, 0 );
-            CFDataRef		pData		= GetDSBufferFromDictionary( cfRecDict );
-            UInt32			dataLength	= (UInt32) CFDataGetLength( pData );
+			CFDictionaryRef	cfRecDict	= (CFDictionaryRef) CFArrayGetValueAtIndex( inRecordList, outRecEntryCount );
+
+			// Need room for (record offset, Block length field = 8 bytes) + the Block and one spare byte, so pack
+			// the block just past where this record's offset will go and slide it up to the end of the free space
+			char			*packLoc	= bufferLoc + 8;
+            UInt32			dataLength	= PackRecordBlock( cfRecDict, packLoc, buffLeft - 9 );
 
-			// Need room for (record offset, Block length field = 8 bytes) + the Block, only need 8
-            if( dataLength && ((dataLength + 8) < buffLeft) )
+            if ( dataLength == 0 )
 			{
-                // Now lets update all the offsets and buffer size
-                bufferOffset -= dataLength + 4;
-                buffLeft -= dataLength + 8;
+                // break if we can't fit it so we can return....
+                break;
+            }
 
-                // first put the offest in the buffer for the record
-                bcopy( (const void *)&bufferOffset, bufferLoc, 4 );
-                bufferLoc += 4; // move past the new byte
+			// Now lets update all the offsets and buffer size
+			bufferOffset -= dataLength + 4;
+			buffLeft -= dataLength + 8;
 
-                // Now copy length before the data block....
-                bcopy( (const void *)&dataLength, (bufferStart + bufferOffset), 4 );
+			// Now move the block into place
+			memmove( bufferStart + bufferOffset + 4, packLoc, dataLength );
 
-                // Now copy the bytes into the new location
-				CFDataGetBytes( pData, CFRangeMake(0, dataLength), (UInt8 *) (bufferStart + bufferOffset + 4) );
+			// first put the offest in the buffer for the record
+			bcopy( (const void *)&bufferOffset, bufferLoc, 4 );
+			bufferLoc += 4; // move past the new byte
 
-                // Since we added a buffer, lets increment number of records
-                *numRecords += 1;
-                outRecEntryCount++;
+			// Now copy length before the data block....
+			bcopy( (const void *)&dataLength, (bufferStart + bufferOffset), 4 );
 
-                // remove now that we added it to the buffer
-				CFArrayRemoveValueAtIndex( inRecordList, 0 );
-            }
-			else
-			{
-                // break if we can't fit it so we can return....
-				DSCFRelease( pData );
-                break;
-            }
-			
-			DSCFRelease( pData );
+			// Since we added a buffer, lets increment number of records
+			*numRecords += 1;
+			outRecEntryCount++;
         }
+
         // Close the record list....
         bcopy( (const void *)&endTag, bufferLoc, 4 );
+
+		// remove the ones we added to the buffer in one shot so the rest are left for the continuation
+		if ( outRecEntryCount > 0 )
+			CFArrayReplaceValues( inRecordList, CFRangeMake(0, outRecEntryCount), NULL, 0 );
     }
 	
     return (tDirStatus)outRecEntryCount;
@@ -3127,6 +3079,7 @@ tDirStatus BaseDirectoryPlugin::CleanContextData ( void *inContext )
 			tmpRecEntry = (sBDPIRecordEntryContext *) inContext;
 			tmpRecEntry->fVirtualNode = NULL;
 			DSCFRelease( tmpRecEntry->fRecord );
+			DSCFRelease( tmpRecEntry->fValueIDIndex );
             break;
         case kBDPIAttributeEntry:
             tmpAttrib = (sBDPIAttributeEntryContext *) inContext;
@@ -3150,6 +3103,85 @@ UInt32 BaseDirectoryPlugin::CalculateCRCWithLength( const void *inData, UInt32 i
 	return CalcCRCWithLength( inData, inLength );
 }
 
+// value IDs are the CRC of the value's bytes, strings are taken as UTF8
+UInt32 BaseDirectoryPlugin::GetValueID( CFTypeRef inValue )
+{
+	UInt32	valueID		= 0;
+	
+	if ( CFGetTypeID(inValue) == CFDataGetTypeID() )
+	{
+		valueID = CalcCRCWithLength( CFDataGetBytePtr((CFDataRef) inValue), CFDataGetLength((CFDataRef) inValue) );
+	}
+	else
+	{
+		char		*pString	= NULL;
+		const char	*pValue		= CFStringGetCStringPtr( (CFStringRef) inValue, kCFStringEncodingUTF8 );
+		
+		if ( pValue == NULL )
+			pValue = GetCStringFromCFString( (CFStringRef) inValue, &pString );
+		
+		if ( pValue != NULL )
+			valueID = CalcCRCWithLength( pValue, strlen(pValue) );
+		
+		DSFreeString( pString );
+	}
+	
+	return valueID;
+}
+
+// Returns the index of the first value in inValues whose ID is inValueID, or kCFNotFound.  The IDs of an
+// attribute's values are computed once and kept on the record context so repeated lookups by ID against
+// large attributes (group members, etc.) don't recompute the CRC of every value.  A hit is re-checked
+// against the value itself and a miss rebuilds the index, so changes to the record can't go unnoticed.
+CFIndex BaseDirectoryPlugin::FindValueIndexByID( sBDPIRecordEntryContext *inContext, CFStringRef inAttribute, CFArrayRef inValues,
+												 UInt32 inValueID )
+{
+	CFIndex					valueCount	= CFArrayGetCount( inValues );
+	CFMutableDictionaryRef	cfIDIndex	= NULL;
+	const void				*indexValue	= NULL;
+	
+	if ( inContext->fValueIDIndex == NULL )
+	{
+		inContext->fValueIDIndex = CFDictionaryCreateMutable( kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks,
+															  &kCFTypeDictionaryValueCallBacks );
+	}
+	
+	cfIDIndex = (CFMutableDictionaryRef) CFDictionaryGetValue( inContext->fValueIDIndex, inAttribute );
+	if ( cfIDIndex != NULL && CFDictionaryGetValueIfPresent(cfIDIndex, (const void *)(uintptr_t) inValueID, &indexValue) )
+	{
+		// stored as index + 1
+		CFIndex valueIndex = (CFIndex)(uintptr_t) indexValue - 1;
+		
+		if ( valueIndex < valueCount && GetValueID(CFArrayGetValueAtIndex(inValues, valueIndex)) == inValueID )
+			return valueIndex;
+	}
+	
+	// (re)build the index for this attribute, keys and values are plain integers
+	cfIDIndex = CFDictionaryCreateMutable( kCFAllocatorDefault, valueCount, NULL, NULL );
+	if ( cfIDIndex == NULL )
+		return kCFNotFound;
+	
+	CFIndex foundIndex = kCFNotFound;
+	for ( CFIndex ii = 0; ii < valueCount; ii++ )
+	{
+		UInt32 valueID = GetValueID( CFArrayGetValueAtIndex(inValues, ii) );
+		
+		// first one wins, same as walking the values
+		if ( CFDictionaryContainsKey(cfIDIndex, (const void *)(uintptr_t) valueID) == false )
+		{
+			CFDictionarySetValue( cfIDIndex, (const void *)(uintptr_t) valueID, (const void *)(uintptr_t) (ii + 1) );
+			
+			if ( valueID == inValueID )
+				foundIndex = ii;
+		}
+	}
+	
+	CFDictionarySetValue( inContext->fValueIDIndex, inAttribute, cfIDIndex );
+	DSCFRelease( cfIDIndex );
+	
+	return foundIndex;
+}
+
 CFMutableArrayRef BaseDirectoryPlugin::CreateCFArrayFromList( tDataListPtr attribList )
 {
 	UInt32				count			= dsDataListGetNodeCountPriv( attribList );
@@ -3186,111 +3218,149 @@ CFMutableArrayRef BaseDirectoryPlugin::CreateCFArrayFromList( tDataListPtr attri
 	return cfReturnValue;
 }
 
-CFDataRef BaseDirectoryPlugin::GetDSBufferFromDictionary( CFDictionaryRef inDictionary )
+// cursor used while packing a record block directly into the caller's buffer
+typedef struct sBDPIPackCursor
 {
-	CFMutableDataRef	cfData		= CFDataCreateMutable( kCFAllocatorDefault, 0 );
-	char				*tmpStr		= NULL;
-	const char			*pValue		= NULL;
-	UInt16				usLength	= 0;
+	char	*fPos;
+	char	*fEnd;
+} sBDPIPackCursor;
+
+static inline bool PackBytes( sBDPIPackCursor &inCursor, const void *inBytes, UInt32 inLength )
+{
+	if ( inLength > (UInt32) (inCursor.fEnd - inCursor.fPos) )
+		return false;
 	
-	// First do the Type of the record
-	CFStringRef	cfRecType = (CFStringRef) CFDictionaryGetValue( inDictionary, kBDPITypeKey );
+	bcopy( inBytes, inCursor.fPos, inLength );
+	inCursor.fPos += inLength;
 	
-	pValue = BaseDirectoryPlugin::GetCStringFromCFString( cfRecType, &tmpStr ); 
-	usLength = (UInt16) (pValue ? strlen( pValue ) : 0);
+	return true;
+}
+
+// writes the 2 or 4 byte length followed by the UTF8 bytes of the string, converting straight into the buffer
+static bool PackString( sBDPIPackCursor &inCursor, CFStringRef inString, UInt32 inLengthSize, const char *inDefault )
+{
+	char		*lengthLoc	= inCursor.fPos;
+	UInt32		length		= 0;
 	
-	CFDataAppendBytes( cfData, (const UInt8 *) &usLength, 2 );
-	CFDataAppendBytes( cfData, (const UInt8 *) pValue, usLength );
+	if ( inLengthSize > (UInt32) (inCursor.fEnd - inCursor.fPos) )
+		return false;
 	
-	DSFreeString( tmpStr );
+	inCursor.fPos += inLengthSize;
 	
-	// now get the record type and put that
-	// Next fill in the Name of the Record, if it has a RecordName, then lets give it....
-	CFStringRef	cfRecName = (CFStringRef) CFDictionaryGetValue( inDictionary, kBDPINameKey );
+	if ( inString != NULL )
+	{
+		const char	*cStr		= CFStringGetCStringPtr( inString, kCFStringEncodingUTF8 );
+		
+		if ( cStr != NULL )
+		{
+			length = (UInt32) strlen( cStr );
+			if ( PackBytes(inCursor, cStr, length) == false )
+				return false;
+		}
+		else
+		{
+			CFIndex	strLen		= CFStringGetLength( inString );
+			CFIndex	usedBytes	= 0;
+			
+			if ( CFStringGetBytes(inString, CFRangeMake(0, strLen), kCFStringEncodingUTF8, '?', false, (UInt8 *) inCursor.fPos,
+								  inCursor.fEnd - inCursor.fPos, &usedBytes) != strLen )
+				return false;
+			
+			length = (UInt32) usedBytes;
+			inCursor.fPos += usedBytes;
+		}
+	}
+	else if ( inDefault != NULL )
+	{
+		length = (UInt32) strlen( inDefault );
+		if ( PackBytes(inCursor, inDefault, length) == false )
+			return false;
+	}
 	
-	pValue = BaseDirectoryPlugin::GetCStringFromCFString( cfRecName, &tmpStr ); 
-	if( pValue == NULL )
-		pValue = "No RecordName";
+	if ( inLengthSize == 2 )
+	{
+		UInt16 usLength = (UInt16) length;
+		bcopy( &usLength, lengthLoc, 2 );
+	}
+	else
+	{
+		bcopy( &length, lengthLoc, 4 );
+	}
 	
-	usLength = (UInt16) strlen( pValue );
-	CFDataAppendBytes( cfData, (const UInt8 *) &usLength, 2 );
-	CFDataAppendBytes( cfData, (const UInt8 *) pValue, usLength );
+	return true;
+}
+
+// Packs the record block (type, name, attribute count, then each attribute block) for inDictionary at inDest
+// and returns its length, or 0 if it does not fit in inDestSize bytes
+UInt32 BaseDirectoryPlugin::PackRecordBlock( CFDictionaryRef inDictionary, char *inDest, UInt32 inDestSize )
+{
+	sBDPIPackCursor		cursor		= { inDest, inDest + inDestSize };
+	bool				bFits		= true;
 	
-	DSFreeString( tmpStr );
+	// First do the Type of the record
+	bFits = PackString( cursor, (CFStringRef) CFDictionaryGetValue(inDictionary, kBDPITypeKey), 2, NULL );
+	
+	// Next fill in the Name of the Record, if it has a RecordName, then lets give it....
+	if ( bFits )
+		bFits = PackString( cursor, (CFStringRef) CFDictionaryGetValue(inDictionary, kBDPINameKey), 2, "No RecordName" );
 	
 	CFDictionaryRef cfAttributes = (CFDictionaryRef) CFDictionaryGetValue( inDictionary, kBDPIAttributeKey );
-	if ( cfAttributes != NULL )
+	if ( bFits && cfAttributes != NULL )
 	{
 		UInt16	usNumberAttribs	= CFDictionaryGetCount( cfAttributes );
 		
-		CFDataAppendBytes( cfData, (const UInt8 *) &usNumberAttribs, 2 );
+		bFits = PackBytes( cursor, &usNumberAttribs, 2 );
 		
-		if ( usNumberAttribs > 0 )
+		if ( bFits && usNumberAttribs > 0 )
 		{
-			CFTypeRef	*cfKeysList		= (CFTypeRef *) calloc( usNumberAttribs, sizeof(CFTypeRef *) );
-			CFTypeRef	*cfValuesList	= (CFTypeRef *) calloc( usNumberAttribs, sizeof(CFTypeRef *) );
+			CFTypeRef	*cfKeysList		= (CFTypeRef *) calloc( 2 * usNumberAttribs, sizeof(CFTypeRef) );
+			CFTypeRef	*cfValuesList	= cfKeysList + usNumberAttribs;
 			
 			CFDictionaryGetKeysAndValues( cfAttributes, cfKeysList, cfValuesList );
 			
-			for (UInt16 ii = 0; ii < usNumberAttribs; ii++)
+			for ( UInt16 ii = 0; bFits && ii < usNumberAttribs; ii++ )
 			{
-				CFStringRef	cfKey		= (CFStringRef) cfKeysList[ii];
-				CFArrayRef	cfValues	= (CFArrayRef) cfValuesList[ii];
-				
-				// Now build the attributes in a temp data object
-				CFMutableDataRef	cfTempData	= CFDataCreateMutable( kCFAllocatorDefault, 0 );
-				
-				pValue = BaseDirectoryPlugin::GetCStringFromCFString( cfKey, &tmpStr );
-				usLength = (UInt16) strlen( pValue );
+				CFArrayRef	cfValues		= (CFArrayRef) cfValuesList[ii];
+				UInt16		usValuesCount	= (UInt16) CFArrayGetCount( cfValues );
+				char		*blockLoc		= cursor.fPos;
+				UInt32		attribBlockLen	= 0;
 				
-				// first add the attribute name
-				CFDataAppendBytes( cfTempData, (const UInt8 *) &usLength, 2 );
-				CFDataAppendBytes( cfTempData, (const UInt8 *) pValue, usLength );
+				// leave room for the attribute block length, filled in once the block is done
+				if ( (bFits = PackBytes(cursor, &attribBlockLen, 4)) == false )
+					break;
 				
-				DSFreeString( tmpStr );
-				
-				// Number of values
-				UInt16 usValuesCount = (UInt16) CFArrayGetCount( cfValues );
-				CFDataAppendBytes( cfTempData, (const UInt8 *) &usValuesCount, 2 );
+				// first add the attribute name, then the number of values
+				bFits = PackString( cursor, (CFStringRef) cfKeysList[ii], 2, NULL ) && PackBytes( cursor, &usValuesCount, 2 );
 				
 				// Loop through values
-				for( UInt16 zz = 0; zz < usValuesCount; zz++ )
+				for ( UInt16 zz = 0; bFits && zz < usValuesCount; zz++ )
 				{
 					CFTypeRef	cfValue	= CFArrayGetValueAtIndex( cfValues, zz );
 					
 					if ( CFGetTypeID(cfValue) == CFStringGetTypeID() )
 					{
-						pValue = GetCStringFromCFString( (CFStringRef) cfValue, &tmpStr );
-						UInt32 attribLen = (UInt32) strlen( pValue );
-						
-						CFDataAppendBytes( cfTempData, (const UInt8 *) &attribLen, 4 );
-						CFDataAppendBytes( cfTempData, (const UInt8 *) pValue, attribLen );
-						
-						DSFreeString( tmpStr );
+						bFits = PackString( cursor, (CFStringRef) cfValue, 4, NULL );
 					}
 					else
 					{
 						UInt32 attribLen = CFDataGetLength( (CFDataRef) cfValue );
 						
-						CFDataAppendBytes( cfTempData, (const UInt8 *) &attribLen, 4 );
-						CFDataAppendBytes( cfTempData, CFDataGetBytePtr((CFDataRef) cfValue), attribLen );
+						bFits = PackBytes( cursor, &attribLen, 4 ) && PackBytes( cursor, CFDataGetBytePtr((CFDataRef) cfValue), attribLen );
 					}
 				}
 				
-				// Now append this attribute block
-				UInt32 attribBlockLen = CFDataGetLength( cfTempData );
-				CFDataAppendBytes( cfData, (const UInt8 *) &attribBlockLen, 4 );
-				CFDataAppendBytes( cfData, CFDataGetBytePtr(cfTempData), attribBlockLen );
-				
-				DSCFRelease( cfTempData );
+				if ( bFits )
+				{
+					attribBlockLen = (UInt32) (cursor.fPos - blockLoc - 4);
+					bcopy( &attribBlockLen, blockLoc, 4 );
+				}
 			}
 			
 			DSFree( cfKeysList );
-			DSFree( cfValuesList );
 		}
 	}
 	
-	return cfData;
+	return (bFits ? (UInt32) (cursor.fPos - inDest) : 0);
 }
 
 void BaseDirectoryPlugin::FilterAttributes( CFMutableDictionaryRef inRecord, CFArrayRef inRequestedAttribs, CFStringRef inNodeName )
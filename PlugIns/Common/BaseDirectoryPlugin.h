@@ -166,7 +166,10 @@ class BaseDirectoryPlugin : public CServerPlugin
 	
 	private:
 		static CFMutableArrayRef	CreateCFArrayFromList( tDataListPtr attribList );
-		static CFDataRef			GetDSBufferFromDictionary( CFDictionaryRef inDictionary );
+		static UInt32				PackRecordBlock			( CFDictionaryRef inDictionary, char *inDest, UInt32 inDestSize );
+		static UInt32				GetValueID				( CFTypeRef inValue );
+		static CFIndex				FindValueIndexByID		( sBDPIRecordEntryContext *inContext, CFStringRef inAttribute, CFArrayRef inValues,
+															  UInt32 inValueID );
 };
 
 #endif
@@ -94,6 +94,7 @@ struct sBDPIRecordEntryContext
 	enum CntxDataType		fType;
 	BDPIVirtualNode			*fVirtualNode;
 	CFMutableDictionaryRef	fRecord;
+	CFMutableDictionaryRef	fValueIDIndex;		// attribute name -> (value ID -> value index), built on first lookup by ID
 };
 
 struct sBDPIAttributeEntryContext
@@ -32,6 +32,11 @@ SQLiteHelper::SQLiteHelper( const char *inDatabasePath, uint32_t inExpectedVersi
 	fDatabasePath = strdup( inDatabasePath );
 	fVersion = inExpectedVersion;
 	fNewDatabase = false;
+	fStmtCacheTick = 0;
+	bzero( fStmtCache, sizeof(fStmtCache) );
+	fGeneration = 0;
+	fWALEnabled = false;
+	bzero( fReaders, sizeof(fReaders) );
 }
 
 SQLiteHelper::~SQLiteHelper( void )
@@ -72,6 +77,10 @@ bool SQLiteHelper::OpenDatabase( bool inIntegrityCheck )
 	// let the disk cache for the system do most of the work as our indexes shouldn't be too large
 	ExecSync( "PRAGMA cache_size = 2" ); // 4k is plenty for anything we do
 	
+	if ( fDatabase != NULL ) {
+		EnableWAL();
+	}
+	
 	fMutex.SignalLock();
 	
 	return (fDatabase != NULL);
@@ -94,6 +103,8 @@ void SQLiteHelper::CreateDatabase( void )
 		snprintf( pCommand, sizeof(pCommand), "PRAGMA user_version = %d", fVersion );
 		
 		status = ExecSync( pCommand );
+		
+		EnableWAL();
 	}
 	else {
 		DbgLog( kLogError, "SQLiteHelper::CreateDatabase - failed to open the DB for creation at '%s' (%d)", fDatabasePath, status );
@@ -114,9 +125,15 @@ void SQLiteHelper::CloseDatabase( void )
 	fMutex.WaitLock();
 
 	if ( fDatabase != NULL ) {
+		// cached statements have to be finalized or the close will fail with SQLITE_BUSY
+		FlushStatementCache();
+		
 		sqlite3_close( fDatabase );
 		fDatabase = NULL;
 		
+		// readers still in use are closed when they are checked back in
+		CloseIdleReaders();
+		
 		DbgLog( kLogPlugin, "SQLiteHelper::CloseDatabase is closing database '%s'", fDatabasePath );
 	}
 	
@@ -136,6 +153,14 @@ void SQLiteHelper::RemoveDatabase( void )
 	
 	unlink( fDatabasePath );
 	unlink( journal );
+	
+	strlcpy( journal, fDatabasePath, sizeof(journal) );
+	strlcat( journal, "-wal", sizeof(journal) );
+	unlink( journal );
+	
+	strlcpy( journal, fDatabasePath, sizeof(journal) );
+	strlcat( journal, "-shm", sizeof(journal) );
+	unlink( journal );
 
 	fMutex.SignalLock();
 
@@ -148,17 +173,22 @@ int SQLiteHelper::ExecSync( const char *command, int length )
 {
 	int				status	= SQLITE_ERROR;
 	sqlite3_stmt	*pStmt	= NULL;
+	bool			bCached	= false;
 	
 	fMutex.WaitLock();
 
 	if ( fDatabase != NULL )
 	{
-		status = sqlite3_prepare_v2( fDatabase, command, length, &pStmt, NULL );	
+		status = AcquireStatement( command, length, &pStmt, &bCached );
 		if ( SQLITE_OK == status )
 		{
 			status = sqlite3_step( pStmt );
-			sqlite3_finalize( pStmt );
+			ReleaseStatement( pStmt, bCached );
 		}
+		
+		// a new schema version means none of the cached statements can be trusted
+		if ( strncasecmp(command, "PRAGMA user_version", sizeof("PRAGMA user_version") - 1) == 0 )
+			FlushStatementCache();
 	}
 	
 	fMutex.SignalLock();
@@ -170,12 +200,13 @@ int SQLiteHelper::ExecSyncWithTypes( const char *command, int length, ... )
 {
 	int				status	= SQLITE_ERROR;
 	sqlite3_stmt	*pStmt	= NULL;
+	bool			bCached	= false;
 	
 	fMutex.WaitLock();
 	
 	if ( fDatabase != NULL )
 	{
-		status = sqlite3_prepare_v2( fDatabase, command, length, &pStmt, NULL );	
+		status = AcquireStatement( command, length, &pStmt, &bCached );
 		if ( SQLITE_OK == status )
 		{
 			int				argIndex;
@@ -225,7 +256,7 @@ int SQLiteHelper::ExecSyncWithTypes( const char *command, int length, ... )
 			if ( status == SQLITE_OK )
 				status = sqlite3_step( pStmt );
 			
-			sqlite3_finalize( pStmt );
+			ReleaseStatement( pStmt, bCached );
 		}
 	}
 	
@@ -253,11 +284,25 @@ int SQLiteHelper::Step( sqlite3_stmt *inStmt )
 {
 	int	status	= SQLITE_ERROR;
 	
+	if ( inStmt == NULL ) {
+		return status;
+	}
+	
+	// statements from PrepareRead have their own connection and don't need the writer lock
+	if ( IsCheckedOutReader(sqlite3_db_handle(inStmt)) ) {
+		status = sqlite3_step( inStmt );
+		return (status == SQLITE_DONE ? SQLITE_OK : status);
+	}
+	
 	fMutex.WaitLock();
 	
-	if ( fDatabase != NULL && inStmt != NULL ) {
+	// anything else must be on the current writer, not one left over from before a close or rebuild
+	if ( fDatabase != NULL && sqlite3_db_handle(inStmt) == fDatabase ) {
 		status = sqlite3_step( inStmt );
 	}
+	else {
+		DbgLog( kLogError, "SQLiteHelper::Step - statement is not on a connection for '%s'", fDatabasePath );
+	}
 	
 	fMutex.SignalLock();
 	
@@ -280,6 +325,47 @@ int SQLiteHelper::Finalize( sqlite3_stmt *&inStmt )
 	return status;
 }
 
+int SQLiteHelper::PrepareRead( const char *command, int length, sqlite3_stmt **stmt )
+{
+	sqlite3	*reader	= CheckOutReader();
+	int		result;
+	
+	if ( reader == NULL ) {
+		return Prepare( command, length, stmt );
+	}
+	
+	result = sqlite3_prepare_v2( reader, command, length, stmt, NULL );
+	
+	// nothing will come back through FinalizeRead so give the connection back now
+	if ( result != SQLITE_OK || (*stmt) == NULL ) {
+		CheckInReader( reader );
+	}
+	
+	return result;
+}
+
+int SQLiteHelper::FinalizeRead( sqlite3_stmt *&inStmt )
+{
+	sqlite3	*reader;
+	int		status;
+	
+	if ( inStmt == NULL ) {
+		return SQLITE_ERROR;
+	}
+	
+	reader = sqlite3_db_handle( inStmt );
+	if ( IsCheckedOutReader(reader) == false ) {
+		return Finalize( inStmt );
+	}
+	
+	status = sqlite3_finalize( inStmt );
+	inStmt = NULL;
+	
+	CheckInReader( reader );
+	
+	return status;
+}
+
 bool SQLiteHelper::BeginTransaction( const char *inName )
 {
 	char	command[256];
@@ -405,3 +491,286 @@ bool SQLiteHelper::IsDatabaseVersionCurrent( void )
 	return bIsCurrent;
 }
 
+#pragma mark -
+#pragma mark Statement cache
+
+// ---------------------------------------------------------------------------
+//	* AcquireStatement
+//
+//	Returns a prepared statement for the command, reusing one from the cache
+//	when the same SQL text was run recently.  sqlite3_prepare_v2 statements
+//	re-prepare themselves on an ordinary schema change, the cache is only
+//	flushed when the database is closed/recreated or user_version is written.
+//	PRAGMAs are one-offs and are not cached.  Must be called with fMutex held.
+// ---------------------------------------------------------------------------
+
+int SQLiteHelper::AcquireStatement( const char *command, int length, sqlite3_stmt **outStmt, bool *outCached )
+{
+	sSQLCachedStatement	*entry		= NULL;
+	sSQLCachedStatement	*victim		= NULL;
+	uint32_t			hash;
+	int					status;
+	
+	(*outStmt) = NULL;
+	(*outCached) = false;
+	
+	if ( length < 0 )
+		length = strlen( command );
+	
+	if ( strncasecmp(command, "PRAGMA", sizeof("PRAGMA") - 1) == 0 )
+		return sqlite3_prepare_v2( fDatabase, command, length, outStmt, NULL );
+	
+	hash = DSHashBytes( command, length );
+	
+	for ( int ii = 0; ii < kSQLStatementCacheSize; ii++ )
+	{
+		entry = &fStmtCache[ii];
+		if ( entry->fStmt == NULL ) {
+			if ( victim == NULL || victim->fStmt != NULL )
+				victim = entry;
+			continue;
+		}
+		
+		if ( entry->fHash == hash && entry->fLength == length && memcmp(entry->fCommand, command, length) == 0 ) {
+			entry->fLastUse = ++fStmtCacheTick;
+			(*outStmt) = entry->fStmt;
+			(*outCached) = true;
+			return SQLITE_OK;
+		}
+		
+		if ( victim == NULL || (victim->fStmt != NULL && entry->fLastUse < victim->fLastUse) )
+			victim = entry;
+	}
+	
+	status = sqlite3_prepare_v2( fDatabase, command, length, outStmt, NULL );
+	if ( status != SQLITE_OK || (*outStmt) == NULL )
+		return status;
+	
+	char *copy = (char *) malloc( length );
+	if ( copy == NULL )
+		return status;
+	memcpy( copy, command, length );
+	
+	if ( victim->fStmt != NULL ) {
+		sqlite3_finalize( victim->fStmt );
+		DSFree( victim->fCommand );
+	}
+	
+	victim->fCommand = copy;
+	victim->fLength = length;
+	victim->fHash = hash;
+	victim->fLastUse = ++fStmtCacheTick;
+	victim->fStmt = (*outStmt);
+	
+	(*outCached) = true;
+	
+	return status;
+}
+
+// ---------------------------------------------------------------------------
+//	* ReleaseStatement
+//
+//	Resets a cached statement so it doesn't hold a read lock open, otherwise
+//	finalizes it.
+// ---------------------------------------------------------------------------
+
+void SQLiteHelper::ReleaseStatement( sqlite3_stmt *inStmt, bool inCached )
+{
+	if ( inStmt == NULL )
+		return;
+	
+	if ( inCached ) {
+		sqlite3_reset( inStmt );
+		sqlite3_clear_bindings( inStmt );
+	}
+	else {
+		sqlite3_finalize( inStmt );
+	}
+}
+
+void SQLiteHelper::FlushStatementCache( void )
+{
+	fMutex.WaitLock();
+	
+	for ( int ii = 0; ii < kSQLStatementCacheSize; ii++ )
+	{
+		sSQLCachedStatement *entry = &fStmtCache[ii];
+		
+		if ( entry->fStmt != NULL ) {
+			sqlite3_finalize( entry->fStmt );
+			entry->fStmt = NULL;
+		}
+		
+		DSFree( entry->fCommand );
+		entry->fLength = 0;
+		entry->fHash = 0;
+		entry->fLastUse = 0;
+	}
+	
+	fMutex.SignalLock();
+}
+
+#pragma mark -
+#pragma mark Readers
+
+// ---------------------------------------------------------------------------
+//	* EnableWAL
+//
+//	In WAL mode readers see the last committed state without blocking the
+//	writer, which is what makes the reader pool worth having.  If the mode
+//	can't be changed PrepareRead just uses the writer connection.
+//	Called with fMutex held.
+// ---------------------------------------------------------------------------
+
+void SQLiteHelper::EnableWAL( void )
+{
+	bool	bEnabled	= false;
+	
+#if SQLITE_VERSION_NUMBER >= 3007000
+	sqlite3_stmt	*pStmt	= NULL;
+	
+	if ( sqlite3_prepare_v2(fDatabase, "PRAGMA journal_mode = WAL", -1, &pStmt, NULL) == SQLITE_OK ) {
+		if ( sqlite3_step(pStmt) == SQLITE_ROW ) {
+			const char *mode = (const char *) sqlite3_column_text( pStmt, 0 );
+			bEnabled = ( mode != NULL && strcasecmp(mode, "wal") == 0 );
+		}
+		
+		sqlite3_finalize( pStmt );
+	}
+	
+	if ( bEnabled == false )
+		DbgLog( kLogError, "SQLiteHelper::EnableWAL - database '%s' could not be put in WAL mode, reads will use the writer", fDatabasePath );
+#endif
+	
+	fReaderMutex.WaitLock();
+	fWALEnabled = bEnabled;
+	fReaderMutex.SignalLock();
+}
+
+sqlite3 *SQLiteHelper::CheckOutReader( void )
+{
+	sSQLReader	*freeSlot	= NULL;
+	sqlite3		*reader		= NULL;
+	
+	fReaderMutex.WaitLock();
+	
+	if ( fWALEnabled == false ) {
+		fReaderMutex.SignalLock();
+		return NULL;
+	}
+	
+	for ( int ii = 0; ii < kSQLReaderPoolSize; ii++ )
+	{
+		sSQLReader *entry = &fReaders[ii];
+		
+		if ( entry->fInUse )
+			continue;
+		
+		if ( entry->fDatabase != NULL && entry->fGeneration == fGeneration ) {
+			entry->fInUse = true;
+			reader = entry->fDatabase;
+			break;
+		}
+		
+		if ( freeSlot == NULL )
+			freeSlot = entry;
+	}
+	
+	// when the pool is exhausted the caller falls back to the writer
+	if ( reader == NULL && freeSlot != NULL ) {
+		int status = sqlite3_open_v2( fDatabasePath, &reader, SQLITE_OPEN_READONLY, NULL );
+		if ( status == SQLITE_OK ) {
+			sqlite3_busy_timeout( reader, 1000 );
+			
+			if ( freeSlot->fDatabase != NULL )
+				sqlite3_close( freeSlot->fDatabase );
+			
+			freeSlot->fDatabase = reader;
+			freeSlot->fGeneration = fGeneration;
+			freeSlot->fInUse = true;
+		}
+		else {
+			DbgLog( kLogError, "SQLiteHelper::CheckOutReader - failed to open reader for '%s' (%d)", fDatabasePath, status );
+			sqlite3_close( reader );
+			reader = NULL;
+		}
+	}
+	
+	fReaderMutex.SignalLock();
+	
+	return reader;
+}
+
+void SQLiteHelper::CheckInReader( sqlite3 *inDatabase )
+{
+	fReaderMutex.WaitLock();
+	
+	for ( int ii = 0; ii < kSQLReaderPoolSize; ii++ )
+	{
+		sSQLReader *entry = &fReaders[ii];
+		
+		if ( entry->fDatabase == inDatabase && entry->fInUse ) {
+			entry->fInUse = false;
+			
+			// database was closed or rebuilt while this one was out
+			if ( entry->fGeneration != fGeneration ) {
+				sqlite3_close( entry->fDatabase );
+				entry->fDatabase = NULL;
+			}
+			
+			break;
+		}
+	}
+	
+	fReaderMutex.SignalLock();
+}
+
+// ---------------------------------------------------------------------------
+//	* IsCheckedOutReader
+//
+//	True only for a pool connection handed out by PrepareRead, every other
+//	handle has to go through the writer.
+// ---------------------------------------------------------------------------
+
+bool SQLiteHelper::IsCheckedOutReader( sqlite3 *inDatabase )
+{
+	bool	bReader	= false;
+	
+	if ( inDatabase == NULL ) {
+		return false;
+	}
+	
+	fReaderMutex.WaitLock();
+	
+	for ( int ii = 0; ii < kSQLReaderPoolSize; ii++ )
+	{
+		if ( fReaders[ii].fDatabase == inDatabase && fReaders[ii].fInUse ) {
+			bReader = true;
+			break;
+		}
+	}
+	
+	fReaderMutex.SignalLock();
+	
+	return bReader;
+}
+
+void SQLiteHelper::CloseIdleReaders( void )
+{
+	fReaderMutex.WaitLock();
+	
+	fGeneration++;
+	fWALEnabled = false;
+	
+	for ( int ii = 0; ii < kSQLReaderPoolSize; ii++ )
+	{
+		sSQLReader *entry = &fReaders[ii];
+		
+		if ( entry->fInUse == false && entry->fDatabase != NULL ) {
+			sqlite3_close( entry->fDatabase );
+			entry->fDatabase = NULL;
+		}
+	}
+	
+	fReaderMutex.SignalLock();
+}
@@ -38,6 +38,28 @@ typedef enum
 	kSQLTypeDone	= 99
 } SQLValueType;
 
+// number of prepared statements kept around for ExecSync/ExecSyncWithTypes
+#define kSQLStatementCacheSize	16
+
+typedef struct sSQLCachedStatement
+{
+	char			*fCommand;
+	int				fLength;
+	uint32_t		fHash;
+	uint32_t		fLastUse;
+	sqlite3_stmt	*fStmt;
+} sSQLCachedStatement;
+
+// read-only connections kept open for PrepareRead, once they are all busy lookups use the writer
+#define kSQLReaderPoolSize		4
+
+typedef struct sSQLReader
+{
+	sqlite3			*fDatabase;
+	uint32_t		fGeneration;
+	bool			fInUse;
+} sSQLReader;
+
 class SQLiteHelper
 {
 	public:
@@ -72,6 +94,11 @@ class SQLiteHelper
 		int				Prepare( const char *command, int length, sqlite3_stmt **stmt, const char **pzTail = NULL );
 		int				Step( sqlite3_stmt *inStmt );
 		int				Finalize( sqlite3_stmt *&inStmt );
+	
+		// lookups that don't need to see an open transaction, runs on a read-only connection in parallel with
+		// the writer (falls back to Prepare when the database isn't in WAL mode), use Step and FinalizeRead
+		int				PrepareRead( const char *command, int length, sqlite3_stmt **stmt );
+		int				FinalizeRead( sqlite3_stmt *&inStmt );
 
 		bool			BeginTransaction( const char *inName = NULL );
 		void			EndTransaction( const char *inName = NULL );
@@ -85,10 +112,26 @@ class SQLiteHelper
 		char				*fDatabasePath;
 		uint32_t			fVersion;
 		bool				fNewDatabase;
+		sSQLCachedStatement	fStmtCache[kSQLStatementCacheSize];
+		uint32_t			fStmtCacheTick;
+		DSMutexSemaphore	fReaderMutex;
+		sSQLReader			fReaders[kSQLReaderPoolSize];
+		uint32_t			fGeneration;
+		bool				fWALEnabled;
 	
 	private:
 		bool		IntegrityCheck( void );
 		bool		IsDatabaseVersionCurrent( void );
+	
+		int			AcquireStatement( const char *command, int length, sqlite3_stmt **outStmt, bool *outCached );
+		void		ReleaseStatement( sqlite3_stmt *inStmt, bool inCached );
+		void		FlushStatementCache( void );
+	
+		void		EnableWAL( void );
+		sqlite3		*CheckOutReader( void );
+		void		CheckInReader( sqlite3 *inDatabase );
+		void		CloseIdleReaders( void );
+		bool		IsCheckedOutReader( sqlite3 *inDatabase );
 };
 
 #endif
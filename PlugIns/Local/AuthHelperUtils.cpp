@@ -28,6 +28,9 @@
 #include "CDSPluginUtils.h"
 #include "CRefTable.h"
 #include <PasswordServer/AuthFile.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <dispatch/dispatch.h>
 
 extern pid_t gDaemonPID;
 extern in_addr_t gDaemonIPAddress;
@@ -158,6 +161,485 @@ tDirStatus GetStateFilePath( const char *inHashPath, char **outStateFilePath )
 }
 
 
+#pragma mark -
+#pragma mark Shadow Hash Cache
+
+//--------------------------------------------------------------------------------------------------
+//	Parsed hash and state files for recently used accounts, so an auth costs a stat of each file
+//	instead of reading, hex decoding and parsing them.  Entries are keyed by the hash file path
+//	(the GUID) and are trusted as long as the file's inode, size and mod time are unchanged.
+//	They hold password hashes, so the table is wired and entries are zeroed when they are reused.
+//	Last login date updates are kept in the entry and written back in batches, other state changes
+//	are written through.
+//--------------------------------------------------------------------------------------------------
+
+#define kShadowHashCacheSize			128
+#define kShadowHashCachePathMax			128
+#define kShadowHashStateFlushDelay		2		// seconds
+
+typedef struct sShadowHashCacheEntry
+{
+	char				fHashPath[kShadowHashCachePathMax];
+	UInt32				fLastUse;
+	
+	bool				fHashesValid;
+	dev_t				fHashDevice;
+	ino_t				fHashInode;
+	off_t				fHashSize;
+	struct timespec		fHashModTime;
+	UInt32				fHashDataLen;
+	unsigned char		fHashes[kHashTotalLength];
+	
+	bool				fStateValid;
+	bool				fStateDirty;		// newer than the file, waiting on the flush
+	bool				fStateFlushing;		// being written, still newer than the file
+	ino_t				fStateInode;
+	off_t				fStateSize;
+	struct timespec		fStateModTime;
+	sHashState			fState;
+} sShadowHashCacheEntry;
+
+static sShadowHashCacheEntry	*sShadowHashCache			= NULL;
+static pthread_once_t			sShadowHashCacheOnce		= PTHREAD_ONCE_INIT;
+static pthread_mutex_t			sShadowHashCacheLock		= PTHREAD_MUTEX_INITIALIZER;
+static UInt32					sShadowHashCacheTick		= 0;
+static UInt32					sShadowHashCacheGeneration	= 0;	// bumped by every write so stale disk reads aren't cached
+static bool						sShadowHashFlushScheduled	= false;
+static dispatch_queue_t			sShadowHashFlushQueue		= NULL;
+
+static int WriteHashStateFileToDisk( const char *inFilePath, sHashState *inHashState );
+
+static void ShadowHashCacheInit( void )
+{
+	size_t	pageSize	= (size_t) getpagesize();
+	size_t	size		= (sizeof(sShadowHashCacheEntry) * kShadowHashCacheSize + pageSize - 1) & ~(pageSize - 1);
+	void	*cache		= mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0 );
+	
+	if ( cache == MAP_FAILED ) {
+		DbgLog( kLogError, "ShadowHashCacheInit - unable to allocate the cache (%d), hash files will be read for every auth", errno );
+		return;
+	}
+	
+	// hashes must never hit the swap file, no cache at all is better than one that can be paged out
+	if ( mlock(cache, size) != 0 ) {
+		DbgLog( kLogError, "ShadowHashCacheInit - unable to wire the cache (%d), hash files will be read for every auth", errno );
+		munmap( cache, size );
+		return;
+	}
+	
+	sShadowHashFlushQueue = dispatch_queue_create( "com.apple.DirectoryService.shadowhash", NULL );
+	sShadowHashCache = (sShadowHashCacheEntry *) cache;
+}
+
+// must hold sShadowHashCacheLock
+static sShadowHashCacheEntry *ShadowHashCacheFind( const char *inHashPath, bool inCreate )
+{
+	sShadowHashCacheEntry	*victim	= NULL;
+	
+	if ( sShadowHashCache == NULL || strlen(inHashPath) >= kShadowHashCachePathMax )
+		return NULL;
+	
+	for ( int ii = 0; ii < kShadowHashCacheSize; ii++ )
+	{
+		sShadowHashCacheEntry *entry = &sShadowHashCache[ii];
+		
+		if ( entry->fHashPath[0] == '\0' ) {
+			if ( victim == NULL || victim->fHashPath[0] != '\0' )
+				victim = entry;
+			continue;
+		}
+		
+		if ( strcmp(entry->fHashPath, inHashPath) == 0 ) {
+			entry->fLastUse = ++sShadowHashCacheTick;
+			return entry;
+		}
+		
+		// state that hasn't been written yet can't be evicted
+		if ( entry->fStateDirty || entry->fStateFlushing )
+			continue;
+		
+		if ( victim == NULL || (victim->fHashPath[0] != '\0' && entry->fLastUse < victim->fLastUse) )
+			victim = entry;
+	}
+	
+	if ( inCreate == false || victim == NULL )
+		return NULL;
+	
+	bzero( victim, sizeof(sShadowHashCacheEntry) );
+	strlcpy( victim->fHashPath, inHashPath, sizeof(victim->fHashPath) );
+	victim->fLastUse = ++sShadowHashCacheTick;
+	
+	return victim;
+}
+
+// the hash path the state file belongs to, false if it isn't a state file path
+static bool ShadowHashPathForStateFile( const char *inStatePath, char *outHashPath, size_t inHashPathSize )
+{
+	size_t len = strlen( inStatePath );
+	
+	if ( len < sizeof(kShadowHashStateFileSuffix) || len - (sizeof(kShadowHashStateFileSuffix) - 1) >= inHashPathSize )
+		return false;
+	
+	len -= sizeof(kShadowHashStateFileSuffix) - 1;
+	if ( strcmp(inStatePath + len, kShadowHashStateFileSuffix) != 0 )
+		return false;
+	
+	memcpy( outHashPath, inStatePath, len );
+	outHashPath[len] = '\0';
+	
+	return true;
+}
+
+// only the fields that are kept in the state file
+static void ShadowHashCopyState( sHashState *outState, const sHashState *inState )
+{
+	outState->creationDate = inState->creationDate;
+	outState->lastLoginDate = inState->lastLoginDate;
+	outState->failedLoginAttempts = inState->failedLoginAttempts;
+	outState->newPasswordRequired = inState->newPasswordRequired;
+}
+
+static bool ShadowHashCacheGetHashes( const char *inHashPath, const struct stat *inStat, unsigned char outHashes[kHashTotalLength],
+	UInt32 *outHashDataLen, UInt32 *outGeneration )
+{
+	sShadowHashCacheEntry	*entry;
+	bool					bFound	= false;
+	
+	pthread_once( &sShadowHashCacheOnce, ShadowHashCacheInit );
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	(*outGeneration) = sShadowHashCacheGeneration;
+	
+	entry = ShadowHashCacheFind( inHashPath, false );
+	if ( entry != NULL && entry->fHashesValid &&
+		 entry->fHashDevice == inStat->st_dev && entry->fHashInode == inStat->st_ino && entry->fHashSize == inStat->st_size &&
+		 entry->fHashModTime.tv_sec == inStat->st_mtimespec.tv_sec && entry->fHashModTime.tv_nsec == inStat->st_mtimespec.tv_nsec )
+	{
+		memcpy( outHashes, entry->fHashes, kHashTotalLength );
+		(*outHashDataLen) = entry->fHashDataLen;
+		bFound = true;
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+	
+	return bFound;
+}
+
+static void ShadowHashCacheSetHashes( const char *inHashPath, const struct stat *inStat, const unsigned char inHashes[kHashTotalLength],
+	UInt32 inHashDataLen, UInt32 inGeneration )
+{
+	sShadowHashCacheEntry	*entry;
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	// something was written since the file was read, what we have may be older than the file
+	if ( inGeneration == sShadowHashCacheGeneration )
+	{
+		entry = ShadowHashCacheFind( inHashPath, true );
+		if ( entry != NULL )
+		{
+			entry->fHashDevice = inStat->st_dev;
+			entry->fHashInode = inStat->st_ino;
+			entry->fHashSize = inStat->st_size;
+			entry->fHashModTime = inStat->st_mtimespec;
+			entry->fHashDataLen = inHashDataLen;
+			memcpy( entry->fHashes, inHashes, kHashTotalLength );
+			entry->fHashesValid = true;
+		}
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+}
+
+//--------------------------------------------------------------------------------------------------
+// * ShadowHashCacheWriteThrough ()
+//
+//  Called with NULL before a hash file is rewritten and with the new hashes after, file times only
+//  have a one second resolution so a rewrite can't be detected from the stat alone.
+//--------------------------------------------------------------------------------------------------
+
+void ShadowHashCacheWriteThrough( const char *inHashPath, const unsigned char inHashes[kHashTotalLength] )
+{
+	sShadowHashCacheEntry	*entry;
+	struct stat				sb;
+	
+	pthread_once( &sShadowHashCacheOnce, ShadowHashCacheInit );
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	sShadowHashCacheGeneration++;
+	
+	entry = ShadowHashCacheFind( inHashPath, (inHashes != NULL) );
+	if ( entry != NULL )
+	{
+		entry->fHashesValid = false;
+		
+		if ( inHashes != NULL && stat(inHashPath, &sb) == 0 )
+		{
+			entry->fHashDevice = sb.st_dev;
+			entry->fHashInode = sb.st_ino;
+			entry->fHashSize = sb.st_size;
+			entry->fHashModTime = sb.st_mtimespec;
+			entry->fHashDataLen = kHashTotalLength;
+			memcpy( entry->fHashes, inHashes, kHashTotalLength );
+			entry->fHashesValid = true;
+		}
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+}
+
+//--------------------------------------------------------------------------------------------------
+// * ShadowHashCacheRemove ()
+//
+//  Drops everything known about the hash file, including state that hasn't been written yet.
+//  Runs on the flush queue so a state write that is in progress can't re-create the file after
+//  the caller removes it.
+//--------------------------------------------------------------------------------------------------
+
+void ShadowHashCacheRemove( const char *inHashPath )
+{
+	pthread_once( &sShadowHashCacheOnce, ShadowHashCacheInit );
+	
+	if ( sShadowHashFlushQueue == NULL )
+		return;
+	
+	dispatch_sync( sShadowHashFlushQueue,
+				   ^(void) {
+					   sShadowHashCacheEntry *entry;
+					   
+					   pthread_mutex_lock( &sShadowHashCacheLock );
+					   
+					   sShadowHashCacheGeneration++;
+					   
+					   entry = ShadowHashCacheFind( inHashPath, false );
+					   if ( entry != NULL )
+						   bzero( entry, sizeof(sShadowHashCacheEntry) );
+					   
+					   pthread_mutex_unlock( &sShadowHashCacheLock );
+				   } );
+}
+
+static bool ShadowHashCacheGetState( const char *inStatePath, sHashState *inOutHashState, struct stat *outStat, bool *outHaveStat,
+	UInt32 *outGeneration )
+{
+	sShadowHashCacheEntry	*entry;
+	char					hashPath[kShadowHashCachePathMax];
+	bool					bFound	= false;
+	
+	(*outHaveStat) = ( stat(inStatePath, outStat) == 0 );
+	
+	if ( ShadowHashPathForStateFile(inStatePath, hashPath, sizeof(hashPath)) == false )
+		return false;
+	
+	pthread_once( &sShadowHashCacheOnce, ShadowHashCacheInit );
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	(*outGeneration) = sShadowHashCacheGeneration;
+	
+	entry = ShadowHashCacheFind( hashPath, false );
+	if ( entry != NULL && entry->fStateValid )
+	{
+		if ( entry->fStateDirty || entry->fStateFlushing ||
+			 ((*outHaveStat) && entry->fStateInode == outStat->st_ino && entry->fStateSize == outStat->st_size &&
+			  entry->fStateModTime.tv_sec == outStat->st_mtimespec.tv_sec &&
+			  entry->fStateModTime.tv_nsec == outStat->st_mtimespec.tv_nsec) )
+		{
+			ShadowHashCopyState( inOutHashState, &entry->fState );
+			bFound = true;
+		}
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+	
+	return bFound;
+}
+
+static void ShadowHashCacheSetState( const char *inStatePath, const struct stat *inStat, const sHashState *inHashState,
+	UInt32 inGeneration )
+{
+	sShadowHashCacheEntry	*entry;
+	char					hashPath[kShadowHashCachePathMax];
+	
+	if ( ShadowHashPathForStateFile(inStatePath, hashPath, sizeof(hashPath)) == false )
+		return;
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	if ( inGeneration == sShadowHashCacheGeneration )
+	{
+		entry = ShadowHashCacheFind( hashPath, true );
+		if ( entry != NULL && entry->fStateDirty == false && entry->fStateFlushing == false )
+		{
+			entry->fStateInode = inStat->st_ino;
+			entry->fStateSize = inStat->st_size;
+			entry->fStateModTime = inStat->st_mtimespec;
+			ShadowHashCopyState( &entry->fState, inHashState );
+			entry->fStateValid = true;
+		}
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+}
+
+// must hold sShadowHashCacheLock and be on the flush queue, the lock is dropped for the write
+static int ShadowHashCacheWriteEntry( sShadowHashCacheEntry *entry )
+{
+	char		statePath[kShadowHashCachePathMax + sizeof(kShadowHashStateFileSuffix)];
+	char		hashPath[kShadowHashCachePathMax];
+	sHashState	state;
+	struct stat	sb;
+	bool		bHaveStat;
+	int			result;
+	
+	entry->fStateDirty = false;
+	entry->fStateFlushing = true;
+	
+	bzero( &state, sizeof(state) );
+	ShadowHashCopyState( &state, &entry->fState );
+	strlcpy( hashPath, entry->fHashPath, sizeof(hashPath) );
+	snprintf( statePath, sizeof(statePath), "%s%s", hashPath, kShadowHashStateFileSuffix );
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+	
+	result = WriteHashStateFileToDisk( statePath, &state );
+	bHaveStat = ( stat(statePath, &sb) == 0 );
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	// removal waits for the write, but check the entry still belongs to the same file
+	if ( entry->fStateFlushing && strcmp(entry->fHashPath, hashPath) == 0 )
+	{
+		entry->fStateFlushing = false;
+		
+		if ( bHaveStat ) {
+			entry->fStateInode = sb.st_ino;
+			entry->fStateSize = sb.st_size;
+			entry->fStateModTime = sb.st_mtimespec;
+		}
+		else if ( entry->fStateDirty == false ) {
+			entry->fStateValid = false;
+		}
+	}
+	
+	return result;
+}
+
+// runs on the flush queue
+static void ShadowHashCacheFlushDirty( void )
+{
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	sShadowHashFlushScheduled = false;
+	
+	for ( int ii = 0; ii < kShadowHashCacheSize; ii++ )
+	{
+		if ( sShadowHashCache[ii].fStateDirty )
+			ShadowHashCacheWriteEntry( &sShadowHashCache[ii] );
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+}
+
+//--------------------------------------------------------------------------------------------------
+// * ShadowHashCacheFlush ()
+//
+//  Writes any deferred state now, called when the daemon shuts down.
+//--------------------------------------------------------------------------------------------------
+
+void ShadowHashCacheFlush( void )
+{
+	pthread_once( &sShadowHashCacheOnce, ShadowHashCacheInit );
+	
+	if ( sShadowHashFlushQueue == NULL )
+		return;
+	
+	dispatch_sync( sShadowHashFlushQueue, ^(void) { ShadowHashCacheFlushDirty(); } );
+}
+
+// true if only the last login date differs, the lockout policy depends on everything else
+static bool ShadowHashStateOnlyLoginChanged( const sHashState *inOldState, const sHashState *inNewState )
+{
+	const struct tm *oldDate = &inOldState->creationDate;
+	const struct tm *newDate = &inNewState->creationDate;
+	
+	return ( inOldState->failedLoginAttempts == inNewState->failedLoginAttempts &&
+			 inOldState->newPasswordRequired == inNewState->newPasswordRequired &&
+			 oldDate->tm_year == newDate->tm_year && oldDate->tm_mon == newDate->tm_mon &&
+			 oldDate->tm_mday == newDate->tm_mday && oldDate->tm_hour == newDate->tm_hour &&
+			 oldDate->tm_min == newDate->tm_min && oldDate->tm_sec == newDate->tm_sec );
+}
+
+// takes the state for the file, false if it can't be cached and the caller has to write it.
+// A new last login date is written back later, any other change is written before returning.
+static bool ShadowHashCacheWriteState( const char *inStatePath, const sHashState *inHashState, int *outResult )
+{
+	sShadowHashCacheEntry	*entry;
+	char					hashPath[kShadowHashCachePathMax];
+	const char				*hashPathPtr	= hashPath;
+	bool					bTaken			= false;
+	bool					bDefer			= false;
+	__block int				result			= 0;
+	
+	if ( ShadowHashPathForStateFile(inStatePath, hashPath, sizeof(hashPath)) == false )
+		return false;
+	
+	pthread_once( &sShadowHashCacheOnce, ShadowHashCacheInit );
+	
+	if ( sShadowHashFlushQueue == NULL )
+		return false;
+	
+	pthread_mutex_lock( &sShadowHashCacheLock );
+	
+	entry = ShadowHashCacheFind( hashPath, true );
+	if ( entry != NULL )
+	{
+		sShadowHashCacheGeneration++;
+		
+		bDefer = ( entry->fStateValid && ShadowHashStateOnlyLoginChanged(&entry->fState, inHashState) );
+		
+		ShadowHashCopyState( &entry->fState, inHashState );
+		entry->fStateValid = true;
+		entry->fStateDirty = true;
+		
+		if ( bDefer && sShadowHashFlushScheduled == false )
+		{
+			sShadowHashFlushScheduled = true;
+			dispatch_after( dispatch_time(DISPATCH_TIME_NOW, kShadowHashStateFlushDelay * NSEC_PER_SEC), sShadowHashFlushQueue,
+							^(void) { ShadowHashCacheFlushDirty(); } );
+		}
+		
+		bTaken = true;
+	}
+	
+	pthread_mutex_unlock( &sShadowHashCacheLock );
+	
+	if ( bTaken && bDefer == false )
+	{
+		// behind any flush in progress, and skipped if the entry was removed or flushed meanwhile
+		dispatch_sync( sShadowHashFlushQueue,
+					   ^(void) {
+						   sShadowHashCacheEntry *dirtyEntry;
+						   
+						   pthread_mutex_lock( &sShadowHashCacheLock );
+						   
+						   dirtyEntry = ShadowHashCacheFind( hashPathPtr, false );
+						   if ( dirtyEntry != NULL && dirtyEntry->fStateDirty )
+							   result = ShadowHashCacheWriteEntry( dirtyEntry );
+						   
+						   pthread_mutex_unlock( &sShadowHashCacheLock );
+					   } );
+	}
+	
+	(*outResult) = result;
+	
+	return bTaken;
+}
+
+#pragma mark -
+
 //--------------------------------------------------------------------------------------------------
 // * ReadShadowHash ()
 //
@@ -180,6 +662,10 @@ tDirStatus ReadShadowHash(
 	UInt32		outBytes							= 0;
 	CFile		*hashFile							= NULL;
 	UInt32		pathSize							= 0;
+	struct stat	hashStat;
+	bool		bHaveStat							= false;
+	bool		bFromCache							= false;
+	UInt32		cacheGeneration						= 0;
 	
 	try
 	{
@@ -216,15 +702,28 @@ tDirStatus ReadShadowHash(
 				strcat( path, inUserName );
 			}
 			
+			if ( readHashes && stat(path, &hashStat) == 0 )
+			{
+				bHaveStat = true;
+				bFromCache = ShadowHashCacheGetHashes( path, &hashStat, outHashes, &outBytes, &cacheGeneration );
+			}
+			
 			// CFile throws, so let's catch, otherwise our logic won't work, could use stat,
 			// but for consistency using try/catch
 			try {
-				hashFile = new CFile(path, false);
+				if ( bFromCache == false )
+					hashFile = new CFile(path, false);
 			} catch ( ... ) {
 				
 			}
 			
-			if (hashFile != NULL && hashFile->is_open())
+			if ( bFromCache )
+			{
+				if ( outModTime != NULL )
+					*outModTime = hashStat.st_mtimespec;
+				siResult = eDSNoErr;
+			}
+			else if (hashFile != NULL && hashFile->is_open())
 			{
 				if ( outModTime != NULL )
 					hashFile->ModDate( outModTime );
@@ -245,6 +744,9 @@ tDirStatus ReadShadowHash(
 							readBytes - kHashOffsetToSaltedSHA1 );
 						bzero( outHashes + kHashOffsetToCramMD5, kHashCramLength );
 					}
+					
+					if ( bHaveStat )
+						ShadowHashCacheSetHashes( path, &hashStat, outHashes, outBytes, cacheGeneration );
 				}
 				siResult = eDSNoErr;
 			}
@@ -366,7 +868,50 @@ tDirStatus ReadStateFile(
 //  Returns: -1 = error, 0 = ok.
 //----------------------------------------------------------------------------------------------------
 
+static int ReadHashStateFileFromDisk( const char *inFilePath, sHashState *inOutHashState );
+
 int ReadHashStateFile( const char *inFilePath, sHashState *inOutHashState )
+{
+	struct stat	sb;
+	bool		bHaveStat		= false;
+	UInt32		generation		= 0;
+	int			returnValue;
+	
+	if ( inFilePath == NULL || inOutHashState == NULL )
+		return -1;
+	
+	if ( ShadowHashCacheGetState(inFilePath, inOutHashState, &sb, &bHaveStat, &generation) )
+		return 0;
+	
+	returnValue = ReadHashStateFileFromDisk( inFilePath, inOutHashState );
+	if ( returnValue == 0 && bHaveStat )
+		ShadowHashCacheSetState( inFilePath, &sb, inOutHashState, generation );
+	
+	return returnValue;
+}
+
+
+//----------------------------------------------------------------------------------------------------
+//  WriteHashStateFile
+//
+//  Returns: -1 = error, 0 = ok.  A login date update is deferred, see ShadowHashCacheWriteState().
+//----------------------------------------------------------------------------------------------------
+
+int WriteHashStateFile( const char *inFilePath, sHashState *inHashState )
+{
+	int result = 0;
+	
+	if ( inFilePath == NULL || inHashState == NULL )
+		return -1;
+	
+	if ( ShadowHashCacheWriteState(inFilePath, inHashState, &result) )
+		return result;
+	
+	return WriteHashStateFileToDisk( inFilePath, inHashState );
+}
+
+
+static int ReadHashStateFileFromDisk( const char *inFilePath, sHashState *inOutHashState )
 {
 	CFStringRef myReplicaDataFilePathRef;
 	CFURLRef myReplicaDataFileRef;
@@ -512,6 +1057,113 @@ int ReadHashStateFile( const char *inFilePath, sHashState *inOutHashState )
 }
 
 
+static int WriteHashStateFileToDisk( const char *inFilePath, sHashState *inHashState )
+{
+	CFStringRef myReplicaDataFilePathRef;
+	CFURLRef myReplicaDataFileRef;
+	CFWriteStreamRef myWriteStreamRef;
+	CFStringRef errorString;
+	int err = 0;
+    //struct stat sb;
+	CFMutableDictionaryRef prefsDict;
+	CFDateRef aDateRef;
+	
+	if ( inFilePath == NULL || inHashState == NULL )
+		return -1;
+	
+	// make the dict
+	prefsDict = CFDictionaryCreateMutable( kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks,
+		&kCFTypeDictionaryValueCallBacks );
+	if ( prefsDict == NULL )
+		return -1;
+	
+	do
+	{
+		if ( pwsf_ConvertBSDTimeToCFDate( &inHashState->creationDate, &aDateRef ) )
+		{
+			CFDictionaryAddValue( prefsDict, CFSTR("CreationDate"), aDateRef );
+			CFRelease( aDateRef );
+		}
+		if ( pwsf_ConvertBSDTimeToCFDate( &inHashState->lastLoginDate, &aDateRef ) )
+		{
+			CFDictionaryAddValue( prefsDict, CFSTR("LastLoginDate"), aDateRef );
+			CFRelease( aDateRef );
+		}
+		
+		CFNumberRef failedAttemptCountRef = CFNumberCreate( kCFAllocatorDefault, kCFNumberSInt16Type,
+			&(inHashState->failedLoginAttempts) );
+		if ( failedAttemptCountRef != NULL )
+		{
+			CFDictionaryAddValue( prefsDict, CFSTR("FailedLoginCount"), failedAttemptCountRef );
+			CFRelease( failedAttemptCountRef );
+		}
+		
+		CFNumberRef newPasswordRequiredRef = CFNumberCreate( kCFAllocatorDefault, kCFNumberSInt16Type,
+			&(inHashState->newPasswordRequired) );
+		if ( newPasswordRequiredRef != NULL )
+		{
+			CFDictionaryAddValue( prefsDict, CFSTR("NewPasswordRequired"), newPasswordRequiredRef );
+			CFRelease( newPasswordRequiredRef );
+		}
+		
+		// WARNING: make sure the path to the file exists or CFStream code is unhappy
+		/*
+			err = stat( kPWReplicaDir, &sb );
+			if ( err != 0 )
+			{
+				// make sure the directory exists
+				err = mkdir( kPWReplicaDir, S_IRWXU );
+				if ( err != 0 )
+					return -1;
+			}
+		*/
+		
+		myReplicaDataFilePathRef = CFStringCreateWithCString( kCFAllocatorDefault, inFilePath, kCFStringEncodingUTF8 );
+		if ( myReplicaDataFilePathRef == NULL )
+		{
+			err = -1;
+			break;
+		}
+		
+		myReplicaDataFileRef = CFURLCreateWithFileSystemPath( kCFAllocatorDefault, myReplicaDataFilePathRef,
+			kCFURLPOSIXPathStyle, false );
+		
+		CFRelease( myReplicaDataFilePathRef );
+		
+		if ( myReplicaDataFileRef == NULL )
+		{
+			err = -1;
+			break;
+		}
+		
+		myWriteStreamRef = CFWriteStreamCreateWithFile( kCFAllocatorDefault, myReplicaDataFileRef );
+		
+		CFRelease( myReplicaDataFileRef );
+		
+		if ( myWriteStreamRef == NULL )
+		{
+			err = -1;
+			break;
+		}
+		
+		CFWriteStreamOpen( myWriteStreamRef );
+		chmod( inFilePath, 0600 );
+		
+		errorString = NULL;
+		CFPropertyListWriteToStream( prefsDict, myWriteStreamRef, kCFPropertyListBinaryFormat_v1_0, NULL );
+		
+		CFWriteStreamClose( myWriteStreamRef );
+		CFRelease( myWriteStreamRef );
+		
+	} while( false );
+	
+	if ( prefsDict != NULL )
+		CFRelease( prefsDict );
+	
+	return err;
+}
+
+
 tDirStatus GetUserPolicies(
 	CFMutableDictionaryRef inMutableRecordDict,
 	sHashState* inState,
@@ -55,6 +55,11 @@ tDirStatus ReadStateFile(
 	SInt32 *outHashDataLen );
 
 int ReadHashStateFile( const char *inFilePath, sHashState *inOutHashState );
+int WriteHashStateFile( const char *inFilePath, sHashState *inHashState );
+
+void ShadowHashCacheWriteThrough( const char *inHashPath, const unsigned char inHashes[kHashTotalLength] );
+void ShadowHashCacheRemove( const char *inHashPath );
+void ShadowHashCacheFlush( void );
 
 tDirStatus GetUserPolicies(
 	CFMutableDictionaryRef inMutableRecordDict,
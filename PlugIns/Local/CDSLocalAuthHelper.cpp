@@ -56,6 +56,7 @@
 #include <openssl/evp.h>
 #include <mach/mach_time.h>	// for dsTimeStamp
 #include <uuid/uuid.h>
+#include <dispatch/dispatch.h>
 
 #include "chap.h"
 #include "chap_ms.h"
@@ -3911,6 +3912,8 @@ tDirStatus CDSLocalAuthHelper::WriteShadowHash ( const char *inUserName, const c
 				}
 			}
 			
+			ShadowHashCacheWriteThrough( path, NULL );
+			
 			// CFile throws, but it is okay here
 			hashFile = new CFile(path, true);
 			if (hashFile->is_open())
@@ -3922,6 +3925,8 @@ tDirStatus CDSLocalAuthHelper::WriteShadowHash ( const char *inUserName, const c
 				delete(hashFile);
 				hashFile = NULL;
 				result = eDSNoErr;
+				
+				ShadowHashCacheWriteThrough( path, inHashes );
 			}
 		}
 	}
@@ -3982,6 +3987,8 @@ void CDSLocalAuthHelper::RemoveShadowHash ( const char *inUserName, const char *
 					sprintf(path, "%s%s", kShadowHashDirPath, inUserName);
 				}
 				
+				ShadowHashCacheRemove( path );
+				
 				// CFile throws, so we need to catch here so we can continue
 				try
 				{
@@ -4136,108 +4143,7 @@ bool CDSLocalAuthHelper::HashesEqual( const unsigned char *inUserHashes, const u
 
 int CDSLocalAuthHelper::WriteHashStateFile( const char *inFilePath, sHashState *inHashState )
 {
-	CFStringRef myReplicaDataFilePathRef;
-	CFURLRef myReplicaDataFileRef;
-	CFWriteStreamRef myWriteStreamRef;
-	CFStringRef errorString;
-	int err = 0;
-    //struct stat sb;
-	CFMutableDictionaryRef prefsDict;
-	CFDateRef aDateRef;
-	
-	if ( inFilePath == NULL || inHashState == NULL )
-		return -1;
-	
-	// make the dict
-	prefsDict = CFDictionaryCreateMutable( kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks,
-		&kCFTypeDictionaryValueCallBacks );
-	if ( prefsDict == NULL )
-		return -1;
-	
-	do
-	{
-		if ( pwsf_ConvertBSDTimeToCFDate( &inHashState->creationDate, &aDateRef ) )
-		{
-			CFDictionaryAddValue( prefsDict, CFSTR("CreationDate"), aDateRef );
-			CFRelease( aDateRef );
-		}
-		if ( pwsf_ConvertBSDTimeToCFDate( &inHashState->lastLoginDate, &aDateRef ) )
-		{
-			CFDictionaryAddValue( prefsDict, CFSTR("LastLoginDate"), aDateRef );
-			CFRelease( aDateRef );
-		}
-		
-		CFNumberRef failedAttemptCountRef = CFNumberCreate( kCFAllocatorDefault, kCFNumberSInt16Type,
-			&(inHashState->failedLoginAttempts) );
-		if ( failedAttemptCountRef != NULL )
-		{
-			CFDictionaryAddValue( prefsDict, CFSTR("FailedLoginCount"), failedAttemptCountRef );
-			CFRelease( failedAttemptCountRef );
-		}
-		
-		CFNumberRef newPasswordRequiredRef = CFNumberCreate( kCFAllocatorDefault, kCFNumberSInt16Type,
-			&(inHashState->newPasswordRequired) );
-		if ( newPasswordRequiredRef != NULL )
-		{
-			CFDictionaryAddValue( prefsDict, CFSTR("NewPasswordRequired"), newPasswordRequiredRef );
-			CFRelease( newPasswordRequiredRef );
-		}
-		
-		// WARNING: make sure the path to the file exists or CFStream code is unhappy
-		/*
-			err = stat( kPWReplicaDir, &sb );
-			if ( err != 0 )
-			{
-				// make sure the directory exists
-				err = mkdir( kPWReplicaDir, S_IRWXU );
-				if ( err != 0 )
-					return -1;
-			}
-		*/
-		
-		myReplicaDataFilePathRef = CFStringCreateWithCString( kCFAllocatorDefault, inFilePath, kCFStringEncodingUTF8 );
-		if ( myReplicaDataFilePathRef == NULL )
-		{
-			err = -1;
-			break;
-		}
-		
-		myReplicaDataFileRef = CFURLCreateWithFileSystemPath( kCFAllocatorDefault, myReplicaDataFilePathRef,
-			kCFURLPOSIXPathStyle, false );
-		
-		CFRelease( myReplicaDataFilePathRef );
-		
-		if ( myReplicaDataFileRef == NULL )
-		{
-			err = -1;
-			break;
-		}
-		
-		myWriteStreamRef = CFWriteStreamCreateWithFile( kCFAllocatorDefault, myReplicaDataFileRef );
-		
-		CFRelease( myReplicaDataFileRef );
-		
-		if ( myWriteStreamRef == NULL )
-		{
-			err = -1;
-			break;
-		}
-		
-		CFWriteStreamOpen( myWriteStreamRef );
-		chmod( inFilePath, 0600 );
-		
-		errorString = NULL;
-		CFPropertyListWriteToStream( prefsDict, myWriteStreamRef, kCFPropertyListBinaryFormat_v1_0, NULL );
-		
-		CFWriteStreamClose( myWriteStreamRef );
-		CFRelease( myWriteStreamRef );
-		
-	} while( false );
-	
-	if ( prefsDict != NULL )
-		CFRelease( prefsDict );
-	
-	return err;
+	return ::WriteHashStateFile( inFilePath, inHashState );
 }
 
 
@@ -4440,102 +4346,142 @@ tDirStatus CDSLocalAuthHelper::SetShadowHashGlobalPolicies( CDSLocalPlugin* inPl
 
 //--------------------------------------------------------------------------------------------------
 // * GenerateShadowHashes
+//
+//	Each hash type fills its own slice of <outHashes>, so they are independent jobs.  When enough of
+//	them are enabled they run concurrently, otherwise the dispatch overhead isn't worth it.
 //--------------------------------------------------------------------------------------------------
 
+#define kShadowHashMinParallelJobs		3
+
+typedef struct sShadowHashJob
+{
+	const char		*fPassword;
+	long			fPasswordLen;
+	UInt32			fSalt;
+	unsigned char	*fHashes;
+} sShadowHashJob;
+
+typedef void (*ShadowHashJobProc)( sShadowHashJob *inJob );
+
+static void ShadowHashJobNT( sShadowHashJob *inJob )
+{
+	CalculateSMBNTHash( inJob->fPassword, inJob->fHashes + kHashOffsetToNT );
+}
+
+static void ShadowHashJobLM( sShadowHashJob *inJob )
+{
+	CalculateSMBLANManagerHash( inJob->fPassword, inJob->fHashes + kHashOffsetToLM );
+}
+
+/* SHA1 - Deprecated BUT required for automated legacy upgrades */
+static void ShadowHashJobSHA1( sShadowHashJob *inJob )
+{
+	CC_SHA1_CTX sha_context = {};
+	
+	CC_SHA1_Init( &sha_context );
+	CC_SHA1_Update( &sha_context, (unsigned char *)inJob->fPassword, inJob->fPasswordLen );
+	CC_SHA1_Final( inJob->fHashes + kHashOffsetToSHA1, &sha_context );
+}
+
+static void ShadowHashJobCramMD5( sShadowHashJob *inJob )
+{
+	unsigned long cramHashLen = 0;
+	
+	pwsf_getHashCramMD5( (const unsigned char *)inJob->fPassword, inJob->fPasswordLen, inJob->fHashes + kHashOffsetToCramMD5,
+		&cramHashLen );
+}
+
+/* 4-byte Salted SHA1 */
+static void ShadowHashJobSaltedSHA1( sShadowHashJob *inJob )
+{
+	CC_SHA1_CTX sha_context = {};
+	
+	memcpy( inJob->fHashes + kHashOffsetToSaltedSHA1, &inJob->fSalt, 4 );
+	
+	CC_SHA1_Init( &sha_context );
+	CC_SHA1_Update( &sha_context, (unsigned char *)&inJob->fSalt, 4 );
+	CC_SHA1_Update( &sha_context, (unsigned char *)inJob->fPassword, inJob->fPasswordLen );
+	CC_SHA1_Final( inJob->fHashes + kHashOffsetToSaltedSHA1 + 4, &sha_context );
+}
+
+static void ShadowHashJobRecoverable( sShadowHashJob *inJob )
+{
+	unsigned char iv[kCCBlockSizeAES128];
+	size_t dataMoved;
+	unsigned char passCopy[kHashRecoverableLength + kCCBlockSizeAES128];
+	
+	bzero( passCopy, sizeof(passCopy) );
+	memcpy( passCopy, inJob->fPassword,
+		(inJob->fPasswordLen < kHashRecoverableLength) ? inJob->fPasswordLen : (kHashRecoverableLength - 1) );
+	
+	memcpy( iv, kAESVector, sizeof(iv) );
+	
+	CCCrypt(
+		kCCEncrypt,
+		kCCAlgorithmAES128,
+		0,
+		(const unsigned char *)"key4now-key4now-key4now", kCCKeySizeAES128,
+		iv,
+		passCopy,
+		kHashRecoverableLength,
+		inJob->fHashes + kHashOffsetToRecoverable,
+		kHashRecoverableLength,
+		&dataMoved );
+	
+	bzero( passCopy, sizeof(passCopy) );
+}
+
 void CDSLocalAuthHelper::GenerateShadowHashes( bool inServerOS, const char *inPassword, long inPasswordLen,
 											   UInt32 inAdditionalHashList, const unsigned char *inSHA1Salt, unsigned char *outHashes,
 											   UInt32 *outHashTotalLength )
 {
-	CC_SHA1_CTX		sha_context						= {};
-	unsigned char	digestData[kHashSecureLength]	= {0};
-	long			pos								= 0;
+	ShadowHashJobProc	jobs[6];
+	size_t				jobCount	= 0;
+	sShadowHashJob		job;
 	
 	/* start clean */
 	bzero( outHashes, kHashTotalLength );
 	
-	/* NT */
-	if ( (inAdditionalHashList & ePluginHashNT) )
-		CalculateSMBNTHash( inPassword, outHashes );
-	pos = kHashShadowOneLength;
+	job.fPassword = inPassword;
+	job.fPasswordLen = inPasswordLen;
+	job.fHashes = outHashes;
+	job.fSalt = 0;
 	
-	/* LM */
+	if ( (inAdditionalHashList & ePluginHashNT) )
+		jobs[jobCount++] = ShadowHashJobNT;
 	if ( (inAdditionalHashList & ePluginHashLM) )
-		CalculateSMBLANManagerHash( inPassword, outHashes + kHashShadowOneLength );
-	pos = kHashShadowBothLength;
-	
-	/* SHA1 - Deprecated BUT required for automated legacy upgrades */
+		jobs[jobCount++] = ShadowHashJobLM;
 	if ( (inAdditionalHashList & ePluginHashSHA1) )
-	{
-		CC_SHA1_Init( &sha_context );
-		CC_SHA1_Update( &sha_context, (unsigned char *)inPassword, inPasswordLen );
-		CC_SHA1_Final( digestData, &sha_context );
-		memmove( outHashes + pos, digestData, kHashSecureLength );
-	}
-	pos += kHashSecureLength;
-	
-	/* CRAM-MD5 */
+		jobs[jobCount++] = ShadowHashJobSHA1;
 	if ( (inAdditionalHashList & ePluginHashCRAM_MD5) )
-	{
-		unsigned long cramHashLen = 0;
-		pwsf_getHashCramMD5( (const unsigned char *)inPassword, inPasswordLen, outHashes + pos, &cramHashLen );
-	}
-	pos += kHashCramLength;
-	
-	/* 4-byte Salted SHA1 */
+		jobs[jobCount++] = ShadowHashJobCramMD5;
 	if ( (inAdditionalHashList & ePluginHashSaltedSHA1) )
 	{
-		UInt32 salt;
-		
 		if ( inSHA1Salt != NULL )
-		{
-			memcpy( &salt, inSHA1Salt, 4 );
-			memcpy( outHashes + pos, inSHA1Salt, 4 );
-		}
+			memcpy( &job.fSalt, inSHA1Salt, 4 );
 		else
-		{
-			salt = (UInt32) arc4random();
-			memcpy( outHashes + pos, &salt, 4 );
-		}
+			job.fSalt = (UInt32) arc4random();
 		
-		pos += 4;
-		CC_SHA1_Init( &sha_context );
-		CC_SHA1_Update( &sha_context, (unsigned char *)&salt, 4 );
-		CC_SHA1_Update( &sha_context, (unsigned char *)inPassword, inPasswordLen );
-		CC_SHA1_Final( digestData, &sha_context );
-		memmove( outHashes + pos, digestData, kHashSecureLength );
-		pos += kHashSecureLength;
-	}
-	else
-	{
-		pos += 4 + kHashSecureLength;
+		jobs[jobCount++] = ShadowHashJobSaltedSHA1;
 	}
-	
-	/* recoverable */
 	if ( inServerOS && (inAdditionalHashList & ePluginHashRecoverable) )
+		jobs[jobCount++] = ShadowHashJobRecoverable;
+	
+	if ( jobCount >= kShadowHashMinParallelJobs )
 	{
-		CCCryptorStatus status = kCCSuccess;
-		unsigned char iv[kCCBlockSizeAES128];
-		size_t dataMoved;
-		unsigned char passCopy[kHashRecoverableLength + kCCBlockSizeAES128];
-		
-		bzero( passCopy, sizeof(passCopy) );
-		memcpy( passCopy, inPassword, (inPasswordLen < kHashRecoverableLength) ? inPasswordLen : (kHashRecoverableLength - 1) );
-		
-		memcpy( iv, kAESVector, sizeof(iv) );
+		// blocks can't capture arrays
+		ShadowHashJobProc	*jobList	= jobs;
+		sShadowHashJob		*jobData	= &job;
 		
-		status = CCCrypt(
-					kCCEncrypt,
-					kCCAlgorithmAES128,
-					0,
-					(const unsigned char *)"key4now-key4now-key4now", kCCKeySizeAES128,
-					iv,
-					passCopy,
-					kHashRecoverableLength,
-					outHashes + pos,
-					kHashRecoverableLength,
-					&dataMoved );
+		dispatch_apply( jobCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+			jobList[index]( jobData );
+		} );
+	}
+	else
+	{
+		for ( size_t ii = 0; ii < jobCount; ii++ )
+			jobs[ii]( &job );
 	}
-	pos += kHashRecoverableLength;
 	
 	*outHashTotalLength = kHashTotalLength;
 }
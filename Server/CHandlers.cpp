@@ -1025,6 +1025,27 @@ SInt32 CRequestHandler::HandleServerCall ( sComData **inMsg )
 } // HandleServerCall
 
 
+//--------------------------------------------------------------------------------------------------
+//	* GetPluginState()
+//
+//		Goes through the plug-in's handle so a request doesn't look the plug-in up by name, falls
+//		back to the name for a plug-in without a handle.
+//--------------------------------------------------------------------------------------------------
+
+static SInt32 GetPluginState ( CServerPlugin *inPlugin, UInt32 *outState )
+{
+	SInt32 handle = inPlugin->GetPlugInHandle();
+	
+	if ( handle != kInvalidPlugInHandle )
+	{
+		return( gPlugins->GetStateForHandle(handle, outState) );
+	}
+	
+	return( gPlugins->GetState(inPlugin->GetPluginName(), outState) );
+
+} // GetPluginState
+
+
 //--------------------------------------------------------------------------------------------------
 //	* HandlePluginCall()
 //
@@ -1058,7 +1079,7 @@ SInt32 CRequestHandler::HandlePluginCall ( sComData **inMsg )
 		{
 			if ( fPluginPtr != nil )
 			{
-				siResult = gPlugins->GetState( fPluginPtr->GetPluginName(), &uiState );
+				siResult = GetPluginState( fPluginPtr, &uiState );
 				if ( siResult == eDSNoErr )
 				{
 					//debug output the request always
@@ -1077,7 +1098,7 @@ SInt32 CRequestHandler::HandlePluginCall ( sComData **inMsg )
 
 						while (!( uiState & kActive ))
 						{
-							siResult = gPlugins->GetState( fPluginPtr->GetPluginName(), &uiState );
+							siResult = GetPluginState( fPluginPtr, &uiState );
 							if ( siResult == eDSNoErr )
 							{
 								// Wait for .2 seconds
@@ -1207,7 +1228,7 @@ SInt32 CRequestHandler::HandlePluginCall ( sComData **inMsg )
 
 							while ( uiState & kUninitialized )
 							{
-								siResult = gPlugins->GetState( fPluginPtr->GetPluginName(), &uiState );
+								siResult = GetPluginState( fPluginPtr, &uiState );
 								if ( siResult == eDSNoErr )
 								{
 									// Wait for .5 seconds
@@ -3132,7 +3153,13 @@ SInt32 CRequestHandler::PackageReply ( void *inData, sComData **inMsg )
 			case kRemoveAttribute:
 			case kRemoveAttributeValue:
 				if ( ( gPlugins != NULL ) && ( fPluginPtr != NULL ) )
-					gPlugins->UpdateValidDataStamp( fPluginPtr->GetPluginName() );
+				{
+					SInt32 handle = fPluginPtr->GetPlugInHandle();
+					if ( handle != kInvalidPlugInHandle )
+						gPlugins->UpdateValidDataStampForHandle( handle );
+					else
+						gPlugins->UpdateValidDataStamp( fPluginPtr->GetPluginName() );
+				}
 				break;
 			default:
 				break;
@@ -3988,6 +4015,7 @@ void* CRequestHandler::DoAttributeValueSearch ( sComData *inMsg, SInt32 *outStat
 	sDoAttrValueSearch *p				= nil;
 	UInt32				uiBuffSize		= 0;
 	CSrvrMessaging		cMsg;
+	char				*nodeName		= NULL;
 
 	try
 	{
@@ -4000,7 +4028,7 @@ void* CRequestHandler::DoAttributeValueSearch ( sComData *inMsg, SInt32 *outStat
 		if ( siResult != eDSNoErr ) throw( (SInt32)eServerReceiveError );
 
 		// Verify the Node reference
-		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket );
+		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket, &nodeName );
 		if ( siResult != eDSNoErr ) throw( siResult );
 
 		siResult = cMsg.Get_Value_FromMsg( inMsg, &uiBuffSize, kOutBuffLen );
@@ -4036,7 +4064,6 @@ void* CRequestHandler::DoAttributeValueSearch ( sComData *inMsg, SInt32 *outStat
 		if (fPluginPtr != NULL)
 		{
 			char* requestedRecTypes = dsGetPathFromListPriv( p->fInRecTypeList, (const char *)";" );
-			char *nodeName = gRefTable.CopyNodeRefName( p->fInNodeRef );
 			if ( gPlugins->IsOKToServiceQuery( fPluginPtr->GetPluginName(), nodeName, requestedRecTypes, p->fInRecTypeList->fDataNodeCount ) )
 			{
 				*outStatus = eDSNoErr;
@@ -4045,7 +4072,6 @@ void* CRequestHandler::DoAttributeValueSearch ( sComData *inMsg, SInt32 *outStat
 			{
 				*outStatus = eDSRecordTypeDisabled;
 			}
-			DSFreeString( nodeName );
 			DSFreeString(requestedRecTypes);
 		}
 		else
@@ -4064,6 +4090,8 @@ void* CRequestHandler::DoAttributeValueSearch ( sComData *inMsg, SInt32 *outStat
 		*outStatus = err;
 	}
 
+	DSFreeString( nodeName );
+
 	return( p );
 
 } // DoAttributeValueSearch
@@ -4080,6 +4108,7 @@ void* CRequestHandler::DoMultipleAttributeValueSearch ( sComData *inMsg, SInt32
 	sDoMultiAttrValueSearch    *p				= nil;
 	UInt32						uiBuffSize		= 0;
 	CSrvrMessaging				cMsg;
+	char						*nodeName		= NULL;
 
 	try
 	{
@@ -4092,7 +4121,7 @@ void* CRequestHandler::DoMultipleAttributeValueSearch ( sComData *inMsg, SInt32
 		if ( siResult != eDSNoErr ) throw( (SInt32)eServerReceiveError );
 
 		// Verify the Node reference
-		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket );
+		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket, &nodeName );
 		if ( siResult != eDSNoErr ) throw( siResult );
 
 		siResult = cMsg.Get_Value_FromMsg( inMsg, &uiBuffSize, kOutBuffLen );
@@ -4128,7 +4157,6 @@ void* CRequestHandler::DoMultipleAttributeValueSearch ( sComData *inMsg, SInt32
 		if (fPluginPtr != NULL)
 		{
 			char* requestedRecTypes = dsGetPathFromListPriv( p->fInRecTypeList, (const char *)";" );
-			char *nodeName = gRefTable.CopyNodeRefName( p->fInNodeRef );
 			if ( gPlugins->IsOKToServiceQuery( fPluginPtr->GetPluginName(), nodeName, requestedRecTypes, p->fInRecTypeList->fDataNodeCount ) )
 			{
 				*outStatus = eDSNoErr;
@@ -4137,7 +4165,6 @@ void* CRequestHandler::DoMultipleAttributeValueSearch ( sComData *inMsg, SInt32
 			{
 				*outStatus = eDSRecordTypeDisabled;
 			}
-			DSFreeString( nodeName );
 			DSFreeString(requestedRecTypes);
 		}
 		else
@@ -4156,6 +4183,8 @@ void* CRequestHandler::DoMultipleAttributeValueSearch ( sComData *inMsg, SInt32
 		*outStatus = err;
 	}
 
+	DSFreeString( nodeName );
+
 	return( p );
 
 } // DoMultipleAttributeValueSearch
@@ -4172,6 +4201,7 @@ void* CRequestHandler::DoAttributeValueSearchWithData ( sComData *inMsg, SInt32
 	sDoAttrValueSearchWithData *p				= nil;
 	UInt32						uiBuffSize		= 0;
 	CSrvrMessaging				cMsg;
+	char						*nodeName		= NULL;
 	UInt32						aBoolValue		= 0;
 
 	try
@@ -4185,7 +4215,7 @@ void* CRequestHandler::DoAttributeValueSearchWithData ( sComData *inMsg, SInt32
 		if ( siResult != eDSNoErr ) throw( (SInt32)eServerReceiveError );
 
 		// Verify the Node reference
-		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket );
+		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket, &nodeName );
 		if ( siResult != eDSNoErr ) throw( siResult );
 
 		siResult = cMsg.Get_Value_FromMsg( inMsg, &uiBuffSize, kOutBuffLen );
@@ -4228,7 +4258,6 @@ void* CRequestHandler::DoAttributeValueSearchWithData ( sComData *inMsg, SInt32
 		if (fPluginPtr != NULL)
 		{
 			char* requestedRecTypes = dsGetPathFromListPriv( p->fInRecTypeList, (const char *)";" );
-			char *nodeName = gRefTable.CopyNodeRefName( p->fInNodeRef );
 			if ( gPlugins->IsOKToServiceQuery( fPluginPtr->GetPluginName(), nodeName, requestedRecTypes, p->fInRecTypeList->fDataNodeCount ) )
 			{
 				*outStatus = eDSNoErr;
@@ -4237,7 +4266,6 @@ void* CRequestHandler::DoAttributeValueSearchWithData ( sComData *inMsg, SInt32
 			{
 				*outStatus = eDSRecordTypeDisabled;
 			}
-			DSFreeString( nodeName );
 			DSFreeString(requestedRecTypes);
 		}
 		else
@@ -4262,6 +4290,8 @@ void* CRequestHandler::DoAttributeValueSearchWithData ( sComData *inMsg, SInt32
 		*outStatus = err;
 	}
 
+	DSFreeString( nodeName );
+
 	return( p );
 
 } // DoAttributeValueSearchWithData
@@ -4278,6 +4308,7 @@ void* CRequestHandler::DoMultipleAttributeValueSearchWithData ( sComData *inMsg,
 	sDoMultiAttrValueSearchWithData		   *p				= nil;
 	UInt32									uiBuffSize		= 0;
 	CSrvrMessaging							cMsg;
+	char									*nodeName		= NULL;
 	UInt32									aBoolValue		= 0;
 
 	try
@@ -4291,7 +4322,7 @@ void* CRequestHandler::DoMultipleAttributeValueSearchWithData ( sComData *inMsg,
 		if ( siResult != eDSNoErr ) throw( (SInt32)eServerReceiveError );
 
 		// Verify the Node reference
-		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket );
+		siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket, &nodeName );
 		if ( siResult != eDSNoErr ) throw( siResult );
 
 		siResult = cMsg.Get_Value_FromMsg( inMsg, &uiBuffSize, kOutBuffLen );
@@ -4334,7 +4365,6 @@ void* CRequestHandler::DoMultipleAttributeValueSearchWithData ( sComData *inMsg,
 		if (fPluginPtr != NULL)
 		{
 			char* requestedRecTypes = dsGetPathFromListPriv( p->fInRecTypeList, (const char *)";" );
-			char *nodeName = gRefTable.CopyNodeRefName( p->fInNodeRef );
 			if ( gPlugins->IsOKToServiceQuery( fPluginPtr->GetPluginName(), nodeName, requestedRecTypes, p->fInRecTypeList->fDataNodeCount ) )
 			{
 				*outStatus = eDSNoErr;
@@ -4343,7 +4373,6 @@ void* CRequestHandler::DoMultipleAttributeValueSearchWithData ( sComData *inMsg,
 			{
 				*outStatus = eDSRecordTypeDisabled;
 			}
-			DSFreeString( nodeName );
 			DSFreeString(requestedRecTypes);
 		}
 		else
@@ -4368,6 +4397,8 @@ void* CRequestHandler::DoMultipleAttributeValueSearchWithData ( sComData *inMsg,
 		*outStatus = err;
 	}
 
+	DSFreeString( nodeName );
+
 	return( p );
 
 } // DoMultipleAttributeValueSearchWithData
@@ -4600,6 +4631,7 @@ void* CRequestHandler::DoGetRecordList ( sComData *inMsg, SInt32 *outStatus )
 	UInt32				uiBuffSize	= 0;
 	sGetRecordList	   *p			= nil;
 	CSrvrMessaging		cMsg;
+	char				*nodeName	= NULL;
 	UInt32				aBoolValue	= 0;
 
 	try
@@ -4616,7 +4648,7 @@ void* CRequestHandler::DoGetRecordList ( sComData *inMsg, SInt32 *outStatus )
 			if ( siResult != eDSNoErr ) throw( siResult );
 
 			// Verify the node reference
-			siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket );
+			siResult = gRefTable.VerifyReference( p->fInNodeRef, eRefTypeDirNode, &fPluginPtr, inMsg->fMachPort, inMsg->fSocket, &nodeName );
 			if ( siResult != eDSNoErr ) throw( siResult );
 
 			//is this an update corresponding to server version 1?
@@ -4671,7 +4703,6 @@ void* CRequestHandler::DoGetRecordList ( sComData *inMsg, SInt32 *outStatus )
 		if (fPluginPtr != NULL)
 		{
 			char* requestedRecTypes = dsGetPathFromListPriv( p->fInRecTypeList, (const char *)";" );
-			char *nodeName = gRefTable.CopyNodeRefName( p->fInNodeRef );
 			if ( gPlugins->IsOKToServiceQuery( fPluginPtr->GetPluginName(), nodeName, requestedRecTypes, p->fInRecTypeList->fDataNodeCount ) )
 			{
 				*outStatus = eDSNoErr;
@@ -4680,7 +4711,6 @@ void* CRequestHandler::DoGetRecordList ( sComData *inMsg, SInt32 *outStatus )
 			{
 				*outStatus = eDSRecordTypeDisabled;
 			}
-			DSFreeString( nodeName );
 			DSFreeString(requestedRecTypes);
 		}
 		else
@@ -4699,6 +4729,8 @@ void* CRequestHandler::DoGetRecordList ( sComData *inMsg, SInt32 *outStatus )
 		*outStatus = err;
 	}
 
+	DSFreeString( nodeName );
+
 	return( p );
 
 } // DoGetRecordList
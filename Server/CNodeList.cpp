@@ -31,6 +31,9 @@
 #include <ctype.h>
 #include <mach/mach_time.h>	// for dsTimeStamp
 
+#include <vector>
+#include <algorithm>
+
 #include "CLog.h"
 #include "CNodeList.h"
 #include "CRefTable.h"
@@ -66,13 +69,43 @@ extern DSEventSemaphore gKickNodeRequests;
 
 extern	dsBool			gDSInstallDaemonMode;
 
+// ---------------------------------------------------------------------------
+//	* FoldNodeName ()
+//
+//		the case-folded key used by the eDSi* patterns, same toupper() rule
+//		that DoGetNode has always applied character by character
+// ---------------------------------------------------------------------------
+
+static string FoldNodeName ( const char *inStr )
+{
+	string	folded( inStr );
+
+	for ( string::iterator iter = folded.begin(); iter != folded.end(); ++iter )
+	{
+		*iter = ::toupper( (unsigned char) *iter );
+	}
+
+	return( folded );
+
+} // FoldNodeName
+
+
+// ---------------------------------------------------------------------------
+//	* NodeNameLessThan ()
+// ---------------------------------------------------------------------------
+
+static bool NodeNameLessThan ( CNodeList::sTreeNode *inNode_1, CNodeList::sTreeNode *inNode_2 )
+{
+	return( ::strcmp(inNode_1->fNodeName, inNode_2->fNodeName) < 0 );
+} // NodeNameLessThan
+
+
 // ---------------------------------------------------------------------------
 //	* CNodeList ()
 // ---------------------------------------------------------------------------
 
 CNodeList::CNodeList ( void ) : fMutex("CNodeList::fMutex")
 {
-	fTreePtr					= nil;
 	fCount						= 0;
 	fNodeChangeToken			= 1001;	//some arbitrary start value
 	fLocalNode					= nil;
@@ -81,8 +114,6 @@ CNodeList::CNodeList ( void ) : fMutex("CNodeList::fMutex")
 	fContactsSearchNode			= nil;
 	fNetworkSearchNode			= nil;
 	fConfigureNode				= nil;
-	fLocalHostedNodes			= nil;
-	fDefaultNetworkNodes		= nil;
 	fBSDNode					= nil;
 } // CNodeList
 
@@ -93,8 +124,7 @@ CNodeList::CNodeList ( void ) : fMutex("CNodeList::fMutex")
 
 CNodeList::~CNodeList ( void )
 {
-	this->DeleteTree( &fTreePtr );
-	fTreePtr = nil;
+	this->DeleteTree( fDirNodes );
 
 	if ( fLocalNode != nil )
 	{
@@ -156,17 +186,8 @@ CNodeList::~CNodeList ( void )
 		fConfigureNode = nil;
 	}
 	
-	if ( fLocalHostedNodes != nil )
-	{
-		this->DeleteTree( &fLocalHostedNodes );
-		fLocalHostedNodes = nil;
-	}
-
-	if ( fDefaultNetworkNodes != nil )
-	{
-		this->DeleteTree( &fDefaultNetworkNodes );
-		fDefaultNetworkNodes = nil;
-	}
+	this->DeleteTree( fLocalHostedNodes );
+	this->DeleteTree( fDefaultNetworkNodes );
 	
 } // ~CNodeList
 
@@ -175,26 +196,30 @@ CNodeList::~CNodeList ( void )
 //	* DeleteTree ()
 // ---------------------------------------------------------------------------
 
-SInt32 CNodeList::DeleteTree ( sTreeNode **inTree )
+SInt32 CNodeList::DeleteTree ( sNodeIndex &inIndex )
 {
+	sTreeNode	   *aTree	= nil;
+
 	fMutex.WaitLock();
 
 	try
 	{
-		if ( *inTree != nil )
+		for ( NodeNameIndexI iter = inIndex.fByName.begin(); iter != inIndex.fByName.end(); ++iter )
 		{
-			this->DeleteTree( &((*inTree)->left) );
-			this->DeleteTree( &((*inTree)->right) );
-			if ( (*inTree)->fDataListPtr != nil )
+			aTree = iter->second;
+			if ( aTree->fDataListPtr != nil )
 			{
-				::dsDataListDeallocatePriv( (*inTree)->fDataListPtr );
+				::dsDataListDeallocatePriv( aTree->fDataListPtr );
 				//need to free the header as well
-				free( (*inTree)->fDataListPtr );
-				(*inTree)->fDataListPtr = nil;
+				free( aTree->fDataListPtr );
+				aTree->fDataListPtr = nil;
 			}
-			delete( *inTree );
+			DSFree( aTree->fNodeName );
+			DSFree( aTree->fFoldedNodeName );
+			free( aTree );
 		}
-		*inTree = nil;
+		inIndex.fByName.clear();
+		inIndex.fByFoldedName.clear();
 	}
 
 	catch( SInt32 err )
@@ -228,10 +253,10 @@ SInt32 CNodeList::AddNode ( const char		*inNodeName,
 		switch(inType)
 		{
 			case kLocalHostedType:
-				siResult = AddNodeToTree( &fLocalHostedNodes, inNodeName, inListPtr, inType, inPlugInPtr, inToken );
+				siResult = AddNodeToTree( fLocalHostedNodes, inNodeName, inListPtr, inType, inPlugInPtr, inToken );
 				break;
 			case kDefaultNetworkNodeType:
-				siResult = AddNodeToTree( &fDefaultNetworkNodes, inNodeName, inListPtr, inType, inPlugInPtr, inToken );
+				siResult = AddNodeToTree( fDefaultNetworkNodes, inNodeName, inListPtr, inType, inPlugInPtr, inToken );
 				break;
 			case kSearchNodeType:
 				if (fAuthenticationSearchNode == nil)
@@ -305,7 +330,7 @@ SInt32 CNodeList::AddNode ( const char		*inNodeName,
 				}
 				break;
 			case kDirNodeType:
-				siResult = AddNodeToTree( &fTreePtr, inNodeName, inListPtr, inType, inPlugInPtr, inToken );
+				siResult = AddNodeToTree( fDirNodes, inNodeName, inListPtr, inType, inPlugInPtr, inToken );
 				
 				// not really tDirStatus, anything other than 0 is success
 				if ( siResult != 0 )
@@ -398,8 +423,6 @@ SInt32 CNodeList::AddLocalNode (	const char		*inNodeName,
 		aLocalNode->fPlugInPtr		= inPlugInPtr;
 		aLocalNode->fPlugInToken	= inToken;
 		aLocalNode->fType			= inType;
-		aLocalNode->left			= nil;
-		aLocalNode->right			= nil;
 		fLocalNode					= aLocalNode;
 		fWaitForLN.PostEvent();
 		DbgLog( kLogApplication, "Added local node to node list." );
@@ -479,8 +502,6 @@ SInt32 CNodeList::AddCacheNode (	const char		*inNodeName,
 		aCacheNode->fPlugInPtr		= inPlugInPtr;
 		aCacheNode->fPlugInToken	= inToken;
 		aCacheNode->fType			= inType;
-		aCacheNode->left			= nil;
-		aCacheNode->right			= nil;
 		fCacheNode					= aCacheNode;
 		fWaitForCacheN.PostEvent();
 	}
@@ -555,8 +576,6 @@ SInt32 CNodeList:: AddAuthenticationSearchNode (	const char		*inNodeName,
 		anAuthenticationSearchNode->fPlugInPtr		= inPlugInPtr;
 		anAuthenticationSearchNode->fPlugInToken	= inToken;
 		anAuthenticationSearchNode->fType			= inType;
-		anAuthenticationSearchNode->left			= nil;
-		anAuthenticationSearchNode->right			= nil;
 		fAuthenticationSearchNode					= anAuthenticationSearchNode;
 		fWaitForAuthenticationSN.PostEvent();
 		DbgLog( kLogApplication, "Added authentication search node to node list." );
@@ -632,8 +651,6 @@ SInt32 CNodeList:: AddContactsSearchNode (	const char		*inNodeName,
 		aContactsSearchNode->fPlugInPtr		= inPlugInPtr;
 		aContactsSearchNode->fPlugInToken	= inToken;
 		aContactsSearchNode->fType			= inType;
-		aContactsSearchNode->left			= nil;
-		aContactsSearchNode->right			= nil;
 		fContactsSearchNode					= aContactsSearchNode;
 		fWaitForContactsSN.PostEvent();
 	}
@@ -708,8 +725,6 @@ SInt32 CNodeList:: AddNetworkSearchNode (	const char		*inNodeName,
 		aNetworkSearchNode->fPlugInPtr		= inPlugInPtr;
 		aNetworkSearchNode->fPlugInToken	= inToken;
 		aNetworkSearchNode->fType			= inType;
-		aNetworkSearchNode->left			= nil;
-		aNetworkSearchNode->right			= nil;
 		fNetworkSearchNode					= aNetworkSearchNode;
 		fWaitForNetworkSN.PostEvent();
 	}
@@ -784,8 +799,6 @@ SInt32 CNodeList:: AddConfigureNode (	const char		*inNodeName,
 		aConfigureNode->fPlugInPtr		= inPlugInPtr;
 		aConfigureNode->fPlugInToken	= inToken;
 		aConfigureNode->fType			= inType;
-		aConfigureNode->left			= nil;
-		aConfigureNode->right			= nil;
 		fConfigureNode					= aConfigureNode;
 		fWaitForConfigureN.PostEvent();
 	}
@@ -859,8 +872,6 @@ SInt32 CNodeList:: AddBSDNode (	const char		*inNodeName,
 		aBSDNode->fPlugInPtr	= inPlugInPtr;
 		aBSDNode->fPlugInToken	= inToken;
 		aBSDNode->fType			= inType;
-		aBSDNode->left			= nil;
-		aBSDNode->right			= nil;
 		fBSDNode				= aBSDNode;
 		fWaitForBSDN.PostEvent();
 	}
@@ -898,7 +909,7 @@ SInt32 CNodeList:: AddBSDNode (	const char		*inNodeName,
 //	* AddNodeToTree ()
 // ---------------------------------------------------------------------------
 
-SInt32 CNodeList:: AddNodeToTree (	sTreeNode	  **inTree,
+SInt32 CNodeList:: AddNodeToTree (	sNodeIndex	   &inIndex,
 									const char	   *inNodeName,
 									tDataList	   *inListPtr,
 									eDirNodeType	inType,
@@ -906,44 +917,24 @@ SInt32 CNodeList:: AddNodeToTree (	sTreeNode	  **inTree,
 									UInt32			 inToken )
 {
 	SInt32			siResult	= 1;
-	sTreeNode	   *current		= nil;
-	sTreeNode	   *parent		= nil;
 	sTreeNode	   *pNewNode	= nil;
-	bool			bAddNode	= true;
 
 	fMutex.WaitLock();
 
 	try
 	{
-		// Go down tree to find parent node of new insertion node
-		current = *inTree;
-		while ( current != nil )
+		if ( inIndex.fByName.find(inNodeName) != inIndex.fByName.end() ) //we found a duplicate
 		{
-			parent = current;
-			siResult = CompareCString( inNodeName, current->fNodeName );
-			if ( siResult < 0 )
-			{
-				current = current->left;
-			}
-			else if ( siResult > 0 )
+			if (inListPtr != nil)
 			{
-				current = current->right;
-			}
-			else //we found a duplicate
-			{
-				current = nil;
-				if (inListPtr != nil)
-				{
-					::dsDataListDeallocatePriv( inListPtr );
-					//need to free the header as well
-					free ( inListPtr );
-					inListPtr = nil;
-				}
-				bAddNode = false;
+				::dsDataListDeallocatePriv( inListPtr );
+				//need to free the header as well
+				free ( inListPtr );
+				inListPtr = nil;
 			}
+			siResult = 0;
 		}
-
-		if (bAddNode)
+		else
 		{
 			pNewNode = (sTreeNode *)::calloc( 1, sizeof( sTreeNode ) );
 			if ( pNewNode == nil ) throw((SInt32)eMemoryAllocError);
@@ -956,41 +947,25 @@ SInt32 CNodeList:: AddNodeToTree (	sTreeNode	  **inTree,
 			pNewNode->fPlugInPtr	= inPlugInPtr;
 			pNewNode->fPlugInToken	= inToken;
 			pNewNode->fType			= inType;
-			pNewNode->left			= nil;
-			pNewNode->right			= nil;
-	
-			// If this is the first insertion then you are defining the root
-			if ( parent == nil )
-			{
-				*inTree = pNewNode;
+
+			string	foldedName	= FoldNodeName( inNodeName );
+
+			pNewNode->fFoldedNodeName = ::strdup( foldedName.c_str() );
+			if ( pNewNode->fFoldedNodeName == nil ) throw((SInt32)eMemoryAllocError);
 	
-				siResult = 1;
-			}
-			else
-			{
-				// Otherwise we are assigning a newnode to the left or right of the parent leaf node
-				siResult = CompareCString( inNodeName, parent->fNodeName );
-				if ( siResult < 0 )
-				{
-					parent->left = pNewNode;
-				}
-				else if ( siResult > 0 )
-				{
-					parent->right = pNewNode;
-				}
-			}
-		} //if (bAddNode)
+			inIndex.fByName[ inNodeName ] = pNewNode;
+			inIndex.fByFoldedName.insert( make_pair(foldedName, pNewNode) );
+
+			siResult = 1;
+		}
 	}
 
 	catch( SInt32 err )
 	{
 		if ( pNewNode != nil )
 		{
-			if (pNewNode->fNodeName != nil)
-			{
-				free(pNewNode->fNodeName);
-				pNewNode->fNodeName = nil;
-			}
+			DSFree( pNewNode->fNodeName );
+			DSFree( pNewNode->fFoldedNodeName );
 			if (pNewNode->fDataListPtr != nil)
 			{
 				::dsDataListDeallocatePriv( pNewNode->fDataListPtr );
@@ -1251,7 +1226,7 @@ void CNodeList::RegisterAll ( void )
 
 	try
 	{
-		this->Register( fTreePtr );
+		this->Register( fDirNodes );
 		if (fAuthenticationSearchNode != NULL) {
 			od_passthru_register_node(fAuthenticationSearchNode->fNodeName, false);
 		}
@@ -1288,16 +1263,13 @@ void CNodeList::RegisterAll ( void )
 //	* Register ()
 // ---------------------------------------------------------------------------
 
-void CNodeList::Register ( sTreeNode *inTree )
+void CNodeList::Register ( sNodeIndex &inIndex )
 {
-	if ( inTree != nil )
+	for ( NodeNameIndexI iter = inIndex.fByName.begin(); iter != inIndex.fByName.end(); ++iter )
 	{
-		if (inTree->fType == kDirNodeType) {
-			od_passthru_register_node(inTree->fNodeName, false);
+		if (iter->second->fType == kDirNodeType) {
+			od_passthru_register_node(iter->second->fNodeName, false);
 		}
-		
-		Register( inTree->left );
-		Register( inTree->right );
 	}
 } // Register
 
@@ -1332,7 +1304,7 @@ void CNodeList::CountNodes ( UInt32 *outCount )
 
 	try
 	{
-		this->Count( fTreePtr, outCount );
+		*outCount += fDirNodes.fByName.size();
 	}
 
 	catch( SInt32 err )
@@ -1344,23 +1316,6 @@ void CNodeList::CountNodes ( UInt32 *outCount )
 } // CountNodes
 
 
-// ---------------------------------------------------------------------------
-//	* Count ()
-// ---------------------------------------------------------------------------
-
-
-void CNodeList::Count ( sTreeNode *inTree, UInt32 *outCount )
-{
-	if ( inTree != nil )
-	{
-		Count( inTree->left, outCount );
-		*outCount += 1;
-		Count( inTree->right, outCount );
-	}
-
-} // Count
-
-
 // ---------------------------------------------------------------------------
 //	* GetNodes ()
 // ---------------------------------------------------------------------------
@@ -1516,7 +1471,7 @@ SInt32 CNodeList::GetNodes ( char			   *inStr,
 		}
 		else
 		{
-			siResult = this->DoGetNode( fTreePtr, inStr, inMatch, inBuff, &outNodePtr );
+			siResult = this->DoGetNode( fDirNodes, inStr, inMatch, inBuff, &outNodePtr );
 		}
 	}
 
@@ -1535,245 +1490,186 @@ SInt32 CNodeList::GetNodes ( char			   *inStr,
 //	* DoGetNode ()
 // ---------------------------------------------------------------------------
 
-SInt32 CNodeList::DoGetNode ( sTreeNode		   *inLeaf,
+SInt32 CNodeList::DoGetNode ( sNodeIndex		   &inIndex,
 							 char			   *inStr,
 							 tDirPatternMatch	inMatch,
 							 tDataBuffer	   *inBuff,
 							 sTreeNode		  **outNodePtr )
 {
-	char	   *aString1	= nil;
-	char	   *aString2	= nil;
-	bool		bAddToBuff	= false;
-	SInt32		uiStrLen	= 0;
-	SInt32		uiInStrLen	= 0;
-	SInt32		siResult	= eDSNoErr;
+	SInt32					siResult	= eDSNoErr;
+	size_t					uiInStrLen	= 0;
+	string					foldedStr;
+	vector<sTreeNode *>		matches;
 
-	if ( inLeaf != nil )
+	if ( inStr != nil )
 	{
-		siResult = DoGetNode( inLeaf->left, inStr, inMatch, inBuff, outNodePtr );
-
-		switch( inMatch )
-		{
-			case eDSLocalNodeNames:
-				if ( inLeaf->fType == kLocalNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-				
-			case eDSCacheNodeName:
-				if ( inLeaf->fType == kCacheNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-				
-			case eDSAuthenticationSearchNodeName:
-				if ( inLeaf->fType == kSearchNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-				
-			case eDSContactsSearchNodeName:
-				if ( inLeaf->fType == kContactsSearchNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-				
-			case eDSNetworkSearchNodeName:
-				if ( inLeaf->fType == kNetworkSearchNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-				
-			case eDSConfigNodeName:
-				if ( inLeaf->fType == kConfigNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-
-			case eDSLocalHostedNodes:
-				if ( inLeaf->fType == kLocalHostedType )
-				{
-					bAddToBuff = true;
-				}
-				break;
-
-			case eDSDefaultNetworkNodes:
-				if ( inLeaf->fType == kDefaultNetworkNodeType )
-				{
-					bAddToBuff = true;
-				}
-				break;
+		uiInStrLen = ::strlen( inStr );
+		foldedStr = FoldNodeName( inStr );
+	}
 
-			//KW is the following pattern matching UTF-8 capable?
-			case eDSExact:
-				if ( ::strcmp( inLeaf->fNodeName, inStr ) == 0 )
+	switch( inMatch )
+	{
+		//KW is the following pattern matching UTF-8 capable?
+		case eDSExact:
+			if ( inStr != nil )
+			{
+				NodeNameIndexI iter = inIndex.fByName.find( inStr );
+				if ( iter != inIndex.fByName.end() )
 				{
-					bAddToBuff = true;
+					matches.push_back( iter->second );
 				}
-				break;
+			}
+			break;
 
-			case eDSStartsWith:
-				uiInStrLen = ::strlen( inStr );
-				if ( ::strncmp( inLeaf->fNodeName, inStr, uiInStrLen ) == 0 )
+		case eDSStartsWith:
+			if ( inStr != nil )
+			{
+				for ( NodeNameIndexI iter = inIndex.fByName.lower_bound( inStr );
+					  iter != inIndex.fByName.end() && iter->first.compare( 0, uiInStrLen, inStr ) == 0;
+					  ++iter )
 				{
-					bAddToBuff = true;
+					matches.push_back( iter->second );
 				}
-				break;
+			}
+			break;
 
-			case eDSEndsWith:
-				uiInStrLen = ::strlen( inStr );
-				if (uiInStrLen > 1) //means that there is something after the first delimiter passed in with the inStr
+		case eDSiExact:
+		case eDSiStartsWith:
+			if ( inStr != nil )
+			{
+				for ( NodeFoldedIndexI iter = inIndex.fByFoldedName.lower_bound( foldedStr );
+					  iter != inIndex.fByFoldedName.end();
+					  ++iter )
 				{
-					uiStrLen = ::strlen( inLeaf->fNodeName );
-					if ( uiInStrLen <= uiStrLen )
+					if ( inMatch == eDSiExact ? (iter->first != foldedStr) : (iter->first.compare( 0, uiInStrLen, foldedStr ) != 0) )
 					{
-						aString1 = inLeaf->fNodeName + (uiStrLen - uiInStrLen + 1);
-						aString2 = inStr + 1;
-						if ( ::strcmp( aString1, aString2 ) == 0 )
-						{
-							bAddToBuff = true;
-						}
+						break;
 					}
+					matches.push_back( iter->second );
 				}
-				break;
 
-			case eDSContains:
-				uiInStrLen = ::strlen( inStr );
-				if (uiInStrLen > 1) //means that there is something after the first delimiter passed in with the inStr
-				{
-					aString2 = inStr + 1;
-					if ( ::strstr( inLeaf->fNodeName, aString2 ) != nil )
-					{
-						bAddToBuff = true;
-					}
-				}
-				break;
+				// the folded index groups names that differ only by case, hand them back in the
+				// same strcmp order a full walk of fByName would have produced
+				sort( matches.begin(), matches.end(), NodeNameLessThan );
+			}
+			break;
 
-			case eDSiExact:
-				uiInStrLen = ::strlen( inStr );
-				uiStrLen = ::strlen( inLeaf->fNodeName );
-				if ( uiInStrLen == uiStrLen )
+		default:
+			// type, ends with and contains patterns have no useful ordering so they still visit every node
+			for ( NodeNameIndexI iter = inIndex.fByName.begin(); iter != inIndex.fByName.end(); ++iter )
+			{
+				if ( NodeMatchesPattern( iter->second, inStr, foldedStr.c_str(), inMatch ) )
 				{
-					aString1 = inStr;
-					aString2 = inLeaf->fNodeName;
-					bAddToBuff = true;
-					while ( *aString1 != '\0' )
-					{
-						if ( ::toupper( *aString2 ) != ::toupper( *aString1 ) )
-						{
-							bAddToBuff = false;
-							break;
-						}
-						aString2++;
-						aString1++;
-					}
+					matches.push_back( iter->second );
 				}
-				break;
+			}
+			break;
+	}
 
-			case eDSiStartsWith:
-				uiInStrLen = ::strlen( inStr );
-				uiStrLen = ::strlen( inLeaf->fNodeName );
-				if ( uiInStrLen <= uiStrLen )
-				{
-					aString1 = inStr;
-					aString2 = inLeaf->fNodeName;
-					bAddToBuff = true;
-					while ( *aString1 != '\0' )
-					{
-						if ( ::toupper( *aString2 ) != ::toupper( *aString1 ) )
-						{
-							bAddToBuff = false;
-							break;
-						}
-						aString2++;
-						aString1++;
-					}
-				}
-				break;
+	for ( vector<sTreeNode *>::iterator iter = matches.begin(); iter != matches.end() && siResult == eDSNoErr; ++iter )
+	{
+		siResult = AddNodePathToTDataBuff( (*iter)->fDataListPtr, inBuff );
+		*outNodePtr = *iter;
+	}
 
-			case eDSiEndsWith:
-				uiInStrLen = ::strlen( inStr );
-				if (uiInStrLen > 1) //means that there is something after the first delimiter passed in with the inStr
-				{
-					uiStrLen = ::strlen( inLeaf->fNodeName );
-					if ( uiInStrLen <= uiStrLen )
-					{
-						aString1 = inStr + 1;
-						aString2 = inLeaf->fNodeName + ( uiStrLen - uiInStrLen + 1 );
-						bAddToBuff = true;
-						while ( *aString1 != '\0' )
-						{
-							if ( ::toupper( *aString2 ) != ::toupper( *aString1 ) )
-							{
-								bAddToBuff = false;
-								break;
-							}
-							aString2++;
-							aString1++;
-						}
-					}
-				}
-				break;
+	return( siResult );
 
-			case eDSiContains:
-				uiInStrLen = ::strlen( inStr );
-				if (uiInStrLen > 1) //means that there is something after the first delimiter passed in with the inStr
-				{
-					uiStrLen = ::strlen( inLeaf->fNodeName );
-					if ( uiInStrLen <= uiStrLen )
-					{
-						CString		tmpStr1( 128 );
-						CString		tmpStr2( 128 );
+} // DoGetNode
 
-						aString1 = inStr + 1;
-						aString2 = inLeaf->fNodeName;
-						bAddToBuff = false;
 
-						while ( *aString1 != '\0' )
-						{
-							tmpStr1.Append( ::toupper( *aString1 ) );
-							aString1++;
-						}
+// ---------------------------------------------------------------------------
+//	* NodeMatchesPattern ()
+// ---------------------------------------------------------------------------
 
-						while ( *aString2 != '\0' )
-						{
-							tmpStr2.Append( ::toupper( *aString2 ) );
-							aString2++;
-						}
+bool CNodeList::NodeMatchesPattern ( sTreeNode		   *inNode,
+									 const char		   *inStr,
+									 const char		   *inFoldedStr,
+									 tDirPatternMatch	inMatch )
+{
+	bool		bMatch		= false;
+	size_t		uiStrLen	= 0;
+	size_t		uiInStrLen	= 0;
 
-						if ( ::strstr( tmpStr2.GetData(), tmpStr1.GetData() ) != nil )
-						{
-							bAddToBuff = true;
-						}
-					}
-				}
+	switch( inMatch )
+	{
+		case eDSLocalNodeNames:
+			bMatch = ( inNode->fType == kLocalNodeType );
+			break;
+			
+		case eDSCacheNodeName:
+			bMatch = ( inNode->fType == kCacheNodeType );
+			break;
+			
+		case eDSAuthenticationSearchNodeName:
+			bMatch = ( inNode->fType == kSearchNodeType );
+			break;
+			
+		case eDSContactsSearchNodeName:
+			bMatch = ( inNode->fType == kContactsSearchNodeType );
+			break;
+			
+		case eDSNetworkSearchNodeName:
+			bMatch = ( inNode->fType == kNetworkSearchNodeType );
+			break;
+			
+		case eDSConfigNodeName:
+			bMatch = ( inNode->fType == kConfigNodeType );
+			break;
+
+		case eDSLocalHostedNodes:
+			bMatch = ( inNode->fType == kLocalHostedType );
+			break;
+
+		case eDSDefaultNetworkNodes:
+			bMatch = ( inNode->fType == kDefaultNetworkNodeType );
+			break;
+
+		case eDSEndsWith:
+		case eDSContains:
+		case eDSiEndsWith:
+		case eDSiContains:
+			if ( inStr == nil )
+			{
 				break;
+			}
 
-			default:
+			uiInStrLen = ::strlen( inStr );
+			uiStrLen = ::strlen( inNode->fNodeName );
+
+			//a length of one means there is nothing after the first delimiter passed in with the inStr
+			if ( uiInStrLen <= 1 )
+			{
 				break;
-		}
+			}
 
-		if ( bAddToBuff == true )
-		{
-			siResult = AddNodePathToTDataBuff( inLeaf->fDataListPtr, inBuff );
-			*outNodePtr = inLeaf;
-		}
+			if ( inMatch == eDSContains )
+			{
+				bMatch = ( ::strstr( inNode->fNodeName, inStr + 1 ) != nil );
+			}
+			else if ( uiInStrLen <= uiStrLen )
+			{
+				if ( inMatch == eDSEndsWith )
+				{
+					bMatch = ( ::strcmp( inNode->fNodeName + (uiStrLen - uiInStrLen + 1), inStr + 1 ) == 0 );
+				}
+				else if ( inMatch == eDSiEndsWith )
+				{
+					bMatch = ( ::strcmp( inNode->fFoldedNodeName + (uiStrLen - uiInStrLen + 1), inFoldedStr + 1 ) == 0 );
+				}
+				else
+				{
+					bMatch = ( ::strstr( inNode->fFoldedNodeName, inFoldedStr + 1 ) != nil );
+				}
+			}
+			break;
 
-		if ( siResult == eDSNoErr )
-		{
-			siResult = DoGetNode( inLeaf->right, inStr, inMatch, inBuff, outNodePtr );
-		}
+		default:
+			break;
 	}
 
-	return( siResult );
+	return( bMatch );
 
-} // DoGetNode
+} // NodeMatchesPattern
 
 
 // ---------------------------------------------------------------------------
@@ -1793,7 +1689,7 @@ bool CNodeList::DeleteNode ( char *inStr )
 	
 	found = DeleteNodeFromTree( inStr, fDefaultNetworkNodes ) || found;
 	
-	if (DeleteNodeFromTree( inStr, fTreePtr ))
+	if (DeleteNodeFromTree( inStr, fDirNodes ))
 	{
 		found = true;
 		fCount--;
@@ -1841,116 +1737,37 @@ bool CNodeList::DeleteNode ( char *inStr )
 //	* DeleteNodeFromTree ()
 // ---------------------------------------------------------------------------
 
-bool CNodeList::DeleteNodeFromTree ( char *inStr, sTreeNode  *inTree )
+bool CNodeList::DeleteNodeFromTree ( char *inStr, sNodeIndex &inIndex )
 {
-	bool			found  			= false;
-	SInt32			siResult		= 0;
-	sTreeNode	   *aTree			= inTree;
-	sTreeNode	   *aTreeParent		= nil;
-	sTreeNode	   *remTree			= nil;
-	sTreeNode	   *remTreeParent	= nil;
-	sTreeNode	   *remTreeChild	= nil;
-	eDirNodeType	aDirNodeType	= kUnknownNodeType;
+	bool				found  		= false;
+	sTreeNode		   *aTree		= nil;
+	NodeNameIndexI		nameIter;
+	NodeFoldedIndexI	foldedIter;
 
-	fMutex.WaitLock();
-
-	// looking only for the three node types that use trees
-	if (aTree == fLocalHostedNodes)
-	{
-		aDirNodeType = kLocalHostedType;
-	}
-	else if (aTree == fDefaultNetworkNodes)
-	{
-		aDirNodeType = kDefaultNetworkNodeType;
-	}
-	else if (aTree == fTreePtr)
-	{
-		aDirNodeType = kDirNodeType;
-	}
-	else
+	if ( inStr == nil )
 	{
-		aTree = nil;
+		return( false );
 	}
 
+	fMutex.WaitLock();
+
 	//find the matching node
-	while ( (!found) && (aTree != nil) )
+	nameIter = inIndex.fByName.find( inStr );
+	if ( nameIter != inIndex.fByName.end() )
 	{
-		siResult = CompareCString( inStr, aTree->fNodeName );
-		if ( siResult == 0 )
-		{
-			found = true;
-		}
-		else
-		{
-			aTreeParent = aTree;
-			if ( siResult < 0 )
-			{
-				aTree = aTree->left;
-			}
-			else
-			{
-				aTree = aTree->right;
-			}
-		}
-	}
+		found = true;
+		aTree = nameIter->second;
 
-	//remove the matching node from the tree
-	if ( found == true )
-	{
-		if ( aTree->left == nil )
-		{
-			remTree = aTree->right;
-		}
-		else
-		{
-			if ( aTree->right == nil )
-			{
-				remTree = aTree->left;
-			}
-			else
-			{
-				remTreeParent = aTree;
-				remTree = aTree->right;
-				remTreeChild = remTree->left;
-				while ( remTreeChild != nil )
-				{
-					remTreeParent = remTree;
-					remTree = remTreeChild;
-					remTreeChild = remTree->left;
-				}
-				if ( remTreeParent != aTree )
-				{
-					remTreeParent->left = remTree->right;
-					remTree->right = aTree->right;
-				}
-				remTree->left = aTree->left;
-			}
-		}
+		//remove the matching node from both indexes
+		inIndex.fByName.erase( nameIter );
 
-		if ( aTreeParent == nil )
+		pair<NodeFoldedIndexI, NodeFoldedIndexI> range = inIndex.fByFoldedName.equal_range( aTree->fFoldedNodeName );
+		for ( foldedIter = range.first; foldedIter != range.second; ++foldedIter )
 		{
-			if (aDirNodeType == kLocalHostedType)
+			if ( foldedIter->second == aTree )
 			{
-				fLocalHostedNodes = remTree;
-			}
-			else if (aDirNodeType == kDefaultNetworkNodeType)
-			{
-				fDefaultNetworkNodes = remTree;
-			}
-			else if (aDirNodeType == kDirNodeType)
-			{
-				fTreePtr = remTree;
-			}
-		}
-		else
-		{
-			if ( aTree == aTreeParent->left )
-			{
-				aTreeParent->left = remTree;
-			}
-			else
-			{
-				aTreeParent->right = remTree;
+				inIndex.fByFoldedName.erase( foldedIter );
+				break;
 			}
 		}
 		
@@ -1962,6 +1779,8 @@ bool CNodeList::DeleteNodeFromTree ( char *inStr, sTreeNode  *inTree )
 			aTree->fNodeName = nil;
 		}
 
+		DSFree( aTree->fFoldedNodeName );
+
 		if ( aTree->fDataListPtr != nil )
 		{
 			::dsDataListDeallocatePriv( aTree->fDataListPtr );
@@ -1970,7 +1789,7 @@ bool CNodeList::DeleteNodeFromTree ( char *inStr, sTreeNode  *inTree )
 			aTree->fDataListPtr = nil;
 		}
 
-		delete( aTree );
+		free( aTree );
 	}
 	
 	fMutex.SignalLock();
@@ -1987,8 +1806,7 @@ bool CNodeList::DeleteNodeFromTree ( char *inStr, sTreeNode  *inTree )
 bool CNodeList::IsPresent ( const char *inStr, eDirNodeType inType )
 {
 	bool		found		= false;
-	SInt32		siResult	= 0;
-	sTreeNode  *current		= nil;
+	sNodeIndex *current		= nil;
 
 	fMutex.WaitLock();
 
@@ -2002,35 +1820,20 @@ bool CNodeList::IsPresent ( const char *inStr, eDirNodeType inType )
 	}
 	else if (inType == kLocalHostedType)
 	{
-		current = fLocalHostedNodes;
+		current = &fLocalHostedNodes;
 	}
 	else if (inType == kDefaultNetworkNodeType)
 	{
-		current = fDefaultNetworkNodes;
+		current = &fDefaultNetworkNodes;
 	}
 	else //this will be the simple node type
 	{
-		current = fTreePtr;
+		current = &fDirNodes;
 	}
 	
-	while ( (!found) && (current != nil) )
+	if ( inStr != nil )
 	{
-		siResult = CompareCString( inStr, current->fNodeName );
-		if ( siResult == 0 )
-		{
-			found = true;
-		}
-		else
-		{
-			if ( siResult < 0 )
-			{
-				current = current->left;
-			}
-			else
-			{
-				current = current->right;
-			}
-		}
+		found = ( current->fByName.find( inStr ) != current->fByName.end() );
 	}
 
 	fMutex.SignalLock();
@@ -2046,9 +1849,8 @@ bool CNodeList::IsPresent ( const char *inStr, eDirNodeType inType )
 
 bool CNodeList::GetPluginHandle ( const char *inStr, CServerPlugin **outPlugInPtr )
 {
-	bool		found		= false;
-	SInt32		siResult	= 0;
-	sTreeNode  *current		= nil;
+	bool			found		= false;
+	NodeNameIndexI	current;
 
 	fMutex.WaitLock();
 
@@ -2141,28 +1943,13 @@ bool CNodeList::GetPluginHandle ( const char *inStr, CServerPlugin **outPlugInPt
 
 	//assumption here is that both the DefaultNetworkNodes and the LocalHostedNodes are also in the main node tree
 	//KW why do we keep duplicates across different node types?
-	current = fTreePtr;
-	while ( (!found) && (current != nil) )
+	current = fDirNodes.fByName.find( inStr );
+	if ( current != fDirNodes.fByName.end() )
 	{
-		siResult = CompareCString( inStr, current->fNodeName );
-		if ( siResult == 0 )
+		found = true;
+		if ( outPlugInPtr != nil )
 		{
-			found = true;
-			if ( outPlugInPtr != nil )
-			{
-				*outPlugInPtr = GetPluginPtr(current);
-			}
-		}
-		else
-		{
-			if ( siResult < 0 )
-			{
-				current = current->left;
-			}
-			else
-			{
-				current = current->right;
-			}
+			*outPlugInPtr = GetPluginPtr(current->second);
 		}
 	}
 
@@ -2197,24 +1984,6 @@ CServerPlugin* CNodeList::GetPluginPtr( sTreeNode* nodePtr )
 	return nodePtr->fPlugInPtr;
 } // GetPluginPtr
 
-// ---------------------------------------------------------------------------
-//	* CompareCString ()
-// ---------------------------------------------------------------------------
-
-SInt32 CNodeList::CompareCString ( const char *inStr_1, const char *inStr_2 )
-{
-	volatile SInt32	siResult = -22;
-
-	if ( (inStr_1 != nil) && (inStr_2 != nil) )
-	{
-		siResult = ::strcmp( inStr_1, inStr_2 );
-	}
-
-	return( siResult );
-
-} // CompareCString
-
-
 // ---------------------------------------------------------------------------
 //	* BuildNodeListBuff ()
 // ---------------------------------------------------------------------------
@@ -2228,7 +1997,7 @@ SInt32 CNodeList::BuildNodeListBuff ( sGetDirNodeList *inData )
 
 	inData->fIOContinueData = nil;
 
-	siResult = this->DoBuildNodeListBuff( fTreePtr, inData->fOutDataBuff, &outCount );
+	siResult = this->DoBuildNodeListBuff( fDirNodes, inData->fOutDataBuff, &outCount );
 	inData->fOutNodeCount = outCount;
 
 	fMutex.SignalLock();
@@ -2242,29 +2011,24 @@ SInt32 CNodeList::BuildNodeListBuff ( sGetDirNodeList *inData )
 //	* DoBuildNodeListBuff ()
 // ---------------------------------------------------------------------------
 
-SInt32 CNodeList::DoBuildNodeListBuff ( sTreeNode *inTree, tDataBuffer *inBuff, UInt32 *outCount )
+SInt32 CNodeList::DoBuildNodeListBuff ( sNodeIndex &inIndex, tDataBuffer *inBuff, UInt32 *outCount )
 {
 	SInt32			siResult	= eDSNoErr;
 	tDataList	   *pNodeList	= nil;
 
-	if ( inTree != nil )
+	for ( NodeNameIndexI iter = inIndex.fByName.begin(); iter != inIndex.fByName.end() && siResult == eDSNoErr; ++iter )
 	{
-		siResult = DoBuildNodeListBuff( inTree->left, inBuff, outCount );
-		if ( siResult == eDSNoErr )
+		pNodeList = iter->second->fDataListPtr;
+		if ( pNodeList != nil )
 		{
-			pNodeList = inTree->fDataListPtr;
-			if ( pNodeList != nil )
+			siResult = AddNodePathToTDataBuff( pNodeList, inBuff );
+			if ( siResult == eDSNoErr )
 			{
-				siResult = AddNodePathToTDataBuff( pNodeList, inBuff );
-				if ( siResult == eDSNoErr )
-				{
-					*outCount	+= 1;
-					siResult	= DoBuildNodeListBuff( inTree->right, inBuff, outCount );
-				}
-				else
-				{
-					*outCount = 0;
-				}
+				*outCount += 1;
+			}
+			else
+			{
+				*outCount = 0;
 			}
 		}
 	}
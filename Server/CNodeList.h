@@ -85,10 +85,22 @@ typedef struct sTreeNode
 	CServerPlugin	*fPlugInPtr;
 	UInt32			fPlugInToken;
 	eDirNodeType	fType;
-   	sTreeNode		*left;
-   	sTreeNode		*right;
+   	char			*fFoldedNodeName;	// upper cased copy of fNodeName, only set for nodes held in an sNodeIndex
 } sTreeNode;
 
+typedef map<string, sTreeNode*>			NodeNameIndex;
+typedef NodeNameIndex::iterator			NodeNameIndexI;
+typedef multimap<string, sTreeNode*>	NodeFoldedIndex;
+typedef NodeFoldedIndex::iterator		NodeFoldedIndexI;
+
+// balanced (red-black) indexes over the same set of nodes; fByName is in strcmp order so
+// exact and prefix matches are a lower_bound, fByFoldedName does the same for the eDSi* patterns
+typedef struct sNodeIndex
+{
+	NodeNameIndex		fByName;
+	NodeFoldedIndex		fByFoldedName;
+} sNodeIndex;
+
 enum {
 	kBuffFull		= -128,
 	kBuffTooSmall	= -129,
@@ -126,23 +138,22 @@ public:
 
 protected:
 	// Protected member functions
-	SInt32		DeleteTree				( sTreeNode **inTree );	// called by the destructor
-	bool		DeleteNodeFromTree		( char *inStr, sTreeNode  *inTree );
+	SInt32		DeleteTree				( sNodeIndex &inIndex );	// called by the destructor
+	bool		DeleteNodeFromTree		( char *inStr, sNodeIndex &inIndex );
 
 	SInt32		AddNodePathToTDataBuff	( tDataList *inPtr, tDataBuffer *inBuff );
 
 private:
 	// Private member functions
-	void		Count					( sTreeNode *inTree, UInt32 *outCount );
-	SInt32		DoGetNode				( sTreeNode *inTree, char *inStr, tDirPatternMatch inMatch, tDataBuffer *inBuff, sTreeNode **outNodePtr );
-	void		Register				( sTreeNode *inTree );
-	SInt32		CompareCString			( const char *inStr_1, const char *inStr_2 );
+	SInt32		DoGetNode				( sNodeIndex &inIndex, char *inStr, tDirPatternMatch inMatch, tDataBuffer *inBuff, sTreeNode **outNodePtr );
+	bool		NodeMatchesPattern		( sTreeNode *inNode, const char *inStr, const char *inFoldedStr, tDirPatternMatch inMatch );
+	void		Register				( sNodeIndex &inIndex );
 
-	SInt32		DoBuildNodeListBuff		( sTreeNode *inTree, tDataBuffer *outData, UInt32 *outCount );
+	SInt32		DoBuildNodeListBuff		( sNodeIndex &inIndex, tDataBuffer *outData, UInt32 *outCount );
 
 	SInt32	   	AddLocalNode					( const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
 	SInt32	   	AddCacheNode					( const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
-	SInt32	   	AddNodeToTree					( sTreeNode **inTree, const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
+	SInt32	   	AddNodeToTree					( sNodeIndex &inIndex, const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
 	SInt32	   	AddAuthenticationSearchNode		( const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
 	SInt32	   	AddContactsSearchNode			( const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
 	SInt32	   	AddNetworkSearchNode			( const char *inStr, tDataList *inListPtr, eDirNodeType inType, CServerPlugin *inPlugInPtr, UInt32 inToken );
@@ -168,15 +179,15 @@ private:
 	void		WaitForNetworkSearchNode		( void );
 
 	// Private data members
-	sTreeNode		   *fTreePtr;
+	sNodeIndex			fDirNodes;
 	sTreeNode		   *fLocalNode;
 	sTreeNode		   *fCacheNode;
 	sTreeNode		   *fConfigureNode;
 	sTreeNode		   *fAuthenticationSearchNode;
 	sTreeNode		   *fContactsSearchNode;
 	sTreeNode		   *fNetworkSearchNode;
-	sTreeNode		   *fLocalHostedNodes;
-	sTreeNode		   *fDefaultNetworkNodes;
+	sNodeIndex			fLocalHostedNodes;
+	sNodeIndex			fDefaultNetworkNodes;
 	sTreeNode		   *fBSDNode;
 	UInt32				fCount;
 	UInt32				fNodeChangeToken;
@@ -40,6 +40,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <sched.h>
+#include <libkern/OSAtomic.h>
 
 extern CFRunLoopRef			gPluginRunLoop;
 extern DSMutexSemaphore    *gKerberosMutex;
@@ -68,6 +70,13 @@ CPlugInList::CPlugInList ( void ) : fMutex("CPlugInList::fMutex")
 	fTable		= nil;
 	fTableTail  = nil;
 	fCFRecordTypeRestrictions = NULL;
+	fRecTypeRestrictionIndex = NULL;
+	fRecTypeEpoch = 0;
+	fRecTypeReaders[0] = 0;
+	fRecTypeReaders[1] = 0;
+	
+	bzero( fHandleTable, sizeof(fHandleTable) );
+	bzero( (void *) fNameHash, sizeof(fNameHash) );
 
 } // CPlugInList
 
@@ -155,7 +164,28 @@ SInt32 CPlugInList::AddPlugIn ( const char		*inName,
 		fTableTail->fKey = inKey;
 		
 		fTableTail->fState = pluginState | kUninitialized;
-
+		
+		// the handle is the table index, plugins past kMaxPlugIns are only found by walking the list
+		fTableTail->fHandle = kInvalidPlugInHandle;
+		if ( fPICount < kMaxPlugIns )
+		{
+			fTableTail->fHandle = fPICount;
+			fHandleTable[fPICount] = fTableTail;
+			
+			// first one wins for duplicate names, same as the list walk
+			if ( GetPlugInHandle(inName) == kInvalidPlugInHandle )
+			{
+				UInt32 slot = DSHashString( inName ) & (kPlugInNameHashSize - 1);
+				
+				while ( fNameHash[slot] != 0 )
+					slot = (slot + 1) & (kPlugInNameHashSize - 1);
+				
+				OSMemoryBarrier();
+				fNameHash[slot] = fPICount + 1;
+			}
+		}
+		
+		OSMemoryBarrier();
 		fPICount++;
 
 		siResult = eDSNoErr;
@@ -485,6 +515,12 @@ SInt32 CPlugInList::GetState ( const char *inName, UInt32 *outState )
 		return( eDSNullParameter );
 	}
 	
+	SInt32 handle = GetPlugInHandle( inName );
+	if ( handle != kInvalidPlugInHandle )
+	{
+		return( GetStateForHandle(handle, outState) );
+	}
+	
 	fMutex.WaitLock();
 
 	aTableEntry = fTable;
@@ -526,6 +562,12 @@ SInt32 CPlugInList::UpdateValidDataStamp ( const char *inName )
 		return( eDSNullParameter );
 	}
 	
+	SInt32 handle = GetPlugInHandle( inName );
+	if ( handle != kInvalidPlugInHandle )
+	{
+		return( UpdateValidDataStampForHandle(handle) );
+	}
+	
 	fMutex.WaitLock();
 
 	aTableEntry = fTable;
@@ -535,7 +577,7 @@ SInt32 CPlugInList::UpdateValidDataStamp ( const char *inName )
 		{
 			if ( ::strcmp( aTableEntry->fName, inName ) == 0 )
 			{
-				aTableEntry->fValidDataStamp++;
+				OSAtomicIncrement32Barrier( (volatile int32_t *) &aTableEntry->fValidDataStamp );
 
 				siResult = eDSNoErr;
 
@@ -567,6 +609,12 @@ UInt32 CPlugInList::GetValidDataStamp ( const char *inName )
 		return( eDSNullParameter );
 	}
 	
+	SInt32 handle = GetPlugInHandle( inName );
+	if ( handle != kInvalidPlugInHandle )
+	{
+		return( GetValidDataStampForHandle(handle) );
+	}
+	
 	fMutex.WaitLock();
 
 	aTableEntry = fTable;
@@ -591,6 +639,99 @@ UInt32 CPlugInList::GetValidDataStamp ( const char *inName )
 } // GetValidDataStamp
 
 
+// ---------------------------------------------------------------------------
+//	* GetPlugInHandle ()
+//
+//		Lock free, entries are only ever added to the hash and never removed.
+// ---------------------------------------------------------------------------
+
+SInt32 CPlugInList::GetPlugInHandle ( const char *inName )
+{
+	if ( inName == nil )
+	{
+		return( kInvalidPlugInHandle );
+	}
+	
+	UInt32 slot = DSHashString( inName ) & (kPlugInNameHashSize - 1);
+	
+	for ( UInt32 probes = 0; probes < kPlugInNameHashSize; probes++ )
+	{
+		SInt32 value = fNameHash[slot];
+		if ( value == 0 )
+		{
+			break;
+		}
+		
+		OSMemoryBarrier();
+		sTableData *aTableEntry = fHandleTable[value - 1];
+		if ( aTableEntry->fName != nil && ::strcmp(aTableEntry->fName, inName) == 0 )
+		{
+			return( value - 1 );
+		}
+		
+		slot = (slot + 1) & (kPlugInNameHashSize - 1);
+	}
+	
+	return( kInvalidPlugInHandle );
+
+} // GetPlugInHandle
+
+
+// ---------------------------------------------------------------------------
+//	* GetStateForHandle ()
+//
+// ---------------------------------------------------------------------------
+
+SInt32 CPlugInList::GetStateForHandle ( SInt32 inHandle, UInt32 *outState )
+{
+	if ( inHandle < 0 || inHandle >= (SInt32) kMaxPlugIns || fHandleTable[inHandle] == nil )
+	{
+		return( ePluginNameNotFound );
+	}
+	
+	*outState = fHandleTable[inHandle]->fState;
+	
+	return( eDSNoErr );
+
+} // GetStateForHandle
+
+
+// ---------------------------------------------------------------------------
+//	* UpdateValidDataStampForHandle ()
+//
+// ---------------------------------------------------------------------------
+
+SInt32 CPlugInList::UpdateValidDataStampForHandle ( SInt32 inHandle )
+{
+	if ( inHandle < 0 || inHandle >= (SInt32) kMaxPlugIns || fHandleTable[inHandle] == nil )
+	{
+		return( ePluginNameNotFound );
+	}
+	
+	OSAtomicIncrement32Barrier( (volatile int32_t *) &fHandleTable[inHandle]->fValidDataStamp );
+	
+	return( eDSNoErr );
+
+} // UpdateValidDataStampForHandle
+
+
+// ---------------------------------------------------------------------------
+//	* GetValidDataStampForHandle ()
+//
+// ---------------------------------------------------------------------------
+
+UInt32 CPlugInList::GetValidDataStampForHandle ( SInt32 inHandle )
+{
+	if ( inHandle < 0 || inHandle >= (SInt32) kMaxPlugIns || fHandleTable[inHandle] == nil )
+	{
+		return( 0 );
+	}
+	
+	return( fHandleTable[inHandle]->fValidDataStamp );
+
+} // GetValidDataStampForHandle
+
+
 // ---------------------------------------------------------------------------
 //	* GetPlugInCount ()
 //
@@ -942,6 +1083,18 @@ CPlugInList::sTableData* CPlugInList::GetPlugInInfo ( UInt32 inIndex )
 	UInt32				tableIndex		= 0;
 	sTableData		   *aTableEntry		= nil;
 
+	// the first kMaxPlugIns entries are in the handle table, published before fPICount
+	if ( inIndex < kMaxPlugIns )
+	{
+		if ( inIndex >= fPICount )
+		{
+			return( nil );
+		}
+		
+		OSMemoryBarrier();
+		return( fHandleTable[inIndex] );
+	}
+	
 	fMutex.WaitLock();
 
 	aTableEntry = fTable;
@@ -1001,6 +1154,7 @@ void CPlugInList::SetRecordTypeRestrictionsDictionary( CFMutableDictionaryRef in
 		
 		CFRetain( inDictionary );
 		fCFRecordTypeRestrictions = inDictionary;
+		CompileRecordTypeRestrictions();
 		
 		sPath = CFStringCreateWithCString( kCFAllocatorDefault, kRecTypeRestrictionsFilePath, kCFStringEncodingUTF8 );
 		if (sPath != NULL)
@@ -1198,6 +1352,8 @@ SInt32 CPlugInList::ReadRecordTypeRestrictions( void )
     
 	DSCFRelease(configFileCorruptedURL); // seems okay to dealloc since Create used and done with it now
 	
+	CompileRecordTypeRestrictions();
+	
 	fMutex.SignalLock();
 
     return( siResult );
@@ -1231,113 +1387,280 @@ bool CPlugInList::CreatePrefDirectory( void )
 
     
 // ---------------------------------------------------------------------------
-//	* IsOKToServiceQuery
+//	* CompileRecordTypeRestrictions
+//
+//		Called with fMutex held whenever fCFRecordTypeRestrictions changes.
+//		Builds the plain C index IsOKToServiceQuery uses and swaps it in.
 // ---------------------------------------------------------------------------
 
-bool CPlugInList::IsOKToServiceQuery( const char *inPluginName, const char *inNodeName, const char *inRecordTypeList, UInt32 inNumberRecordTypes )
+static char *RecTypeCopyCString( CFStringRef inString )
 {
-	bool isOK = true;
+	CFIndex	maxSize	= CFStringGetMaximumSizeForEncoding( CFStringGetLength(inString), kCFStringEncodingUTF8 ) + 1;
+	char	*outStr	= (char *) calloc( 1, maxSize );
 	
-	if (inRecordTypeList == NULL) //can't see this ever happening as we check before calling this routine
-		return(isOK);
+	if ( outStr != NULL )
+		CFStringGetCString( inString, outStr, maxSize, kCFStringEncodingUTF8 );
 	
-	fMutex.WaitLock();
+	return outStr;
+}
+
+static void RecTypeFreeIndex( void *inContext )
+{
+	sRecTypeRestrictionIndex *index = (sRecTypeRestrictionIndex *) inContext;
 	
-	if (fCFRecordTypeRestrictions != NULL && inPluginName != NULL)
+	for ( UInt32 i = 0; i < index->fPluginCount; i++ )
 	{
-		CFStringRef cfPluginName = NULL;
-		cfPluginName = CFStringCreateWithCString( kCFAllocatorDefault, inPluginName, kCFStringEncodingUTF8 );
-		if ( CFDictionaryContainsKey( fCFRecordTypeRestrictions, cfPluginName ) ) //plugin entry is in the dictionary
+		sRecTypePluginRestriction *plugin = &index->fPlugins[i];
+		
+		for ( UInt32 j = 0; j < plugin->fNodeCount; j++ )
 		{
-			CFDictionaryRef cfPluginRestrictions = NULL;
-			cfPluginRestrictions = (CFDictionaryRef)CFDictionaryGetValue( fCFRecordTypeRestrictions, cfPluginName );
-			if (inNodeName != NULL) //we have a node name that we can check for
+			for ( UInt32 k = 0; k < plugin->fNodes[j].fTypeCount; k++ )
+				DSFree( plugin->fNodes[j].fTypes[k] );
+			
+			DSFree( plugin->fNodes[j].fTypes );
+			DSFree( plugin->fNodes[j].fNodeName );
+		}
+		
+		DSFree( plugin->fNodes );
+		DSFree( plugin->fPluginName );
+	}
+	
+	DSFree( index->fPlugins );
+	DSFree( index->fPluginHash );
+	DSFree( index );
+}
+
+void CPlugInList::CompileRecordTypeRestrictions( void )
+{
+	sRecTypeRestrictionIndex	*newIndex	= NULL;
+	sRecTypeRestrictionIndex	*oldIndex	= NULL;
+	
+	if ( fCFRecordTypeRestrictions != NULL && CFGetTypeID(fCFRecordTypeRestrictions) == CFDictionaryGetTypeID() )
+	{
+		CFIndex		pluginCount	= CFDictionaryGetCount( fCFRecordTypeRestrictions );
+		CFTypeRef	*keys		= (CFTypeRef *) calloc( pluginCount + 1, sizeof(CFTypeRef) );
+		CFTypeRef	*values		= (CFTypeRef *) calloc( pluginCount + 1, sizeof(CFTypeRef) );
+		
+		newIndex = (sRecTypeRestrictionIndex *) calloc( 1, sizeof(sRecTypeRestrictionIndex) );
+		newIndex->fPlugins = (sRecTypePluginRestriction *) calloc( pluginCount + 1, sizeof(sRecTypePluginRestriction) );
+		
+		CFDictionaryGetKeysAndValues( fCFRecordTypeRestrictions, keys, values );
+		
+		for ( CFIndex i = 0; i < pluginCount; i++ )
+		{
+			// skips "Version" and anything else that isn't a plugin dictionary
+			if ( CFGetTypeID(keys[i]) != CFStringGetTypeID() || CFGetTypeID(values[i]) != CFDictionaryGetTypeID() )
+				continue;
+			
+			sRecTypePluginRestriction	*plugin					= &newIndex->fPlugins[newIndex->fPluginCount++];
+			CFDictionaryRef				cfPluginRestrictions	= (CFDictionaryRef) values[i];
+			CFIndex						nodeCount				= CFDictionaryGetCount( cfPluginRestrictions );
+			CFTypeRef					*nodeKeys				= (CFTypeRef *) calloc( nodeCount + 1, sizeof(CFTypeRef) );
+			CFTypeRef					*nodeValues				= (CFTypeRef *) calloc( nodeCount + 1, sizeof(CFTypeRef) );
+			
+			plugin->fPluginName = RecTypeCopyCString( (CFStringRef) keys[i] );
+			plugin->fNameHash = (plugin->fPluginName != NULL ? DSHashString(plugin->fPluginName) : 0);
+			plugin->fNodes = (sRecTypeNodeRestriction *) calloc( nodeCount + 1, sizeof(sRecTypeNodeRestriction) );
+			
+			CFDictionaryGetKeysAndValues( cfPluginRestrictions, nodeKeys, nodeValues );
+			
+			for ( CFIndex j = 0; j < nodeCount; j++ )
 			{
-				CFStringRef cfNodeName = NULL;
-				cfNodeName = CFStringCreateWithCString( kCFAllocatorDefault, inNodeName, kCFStringEncodingUTF8 );
-				bool useRestrictions = false;
-				if ( CFDictionaryContainsKey( cfPluginRestrictions, cfNodeName ) ) //nodename entry is in the dictionary
+				if ( CFGetTypeID(nodeKeys[j]) != CFStringGetTypeID() || CFGetTypeID(nodeValues[j]) != CFDictionaryGetTypeID() )
+					continue;
+				
+				sRecTypeNodeRestriction	*node			= &plugin->fNodes[plugin->fNodeCount++];
+				CFDictionaryRef			cfRestrictions	= (CFDictionaryRef) nodeValues[j];
+				CFArrayRef				cfRecordTypes	= NULL;
+				
+				if ( CFStringCompare((CFStringRef) nodeKeys[j], CFSTR("General"), 0) == kCFCompareEqualTo )
+					plugin->fGeneral = node;
+				else
+					node->fNodeName = RecTypeCopyCString( (CFStringRef) nodeKeys[j] );
+				
+				//check for Deny list ONLY if Allow list is NOT present
+				if ( CFDictionaryContainsKey(cfRestrictions, CFSTR(kRTRAllowKey)) )
 				{
-					useRestrictions = true;
+					node->fIsAllowList = true;
+					cfRecordTypes = (CFArrayRef) CFDictionaryGetValue( cfRestrictions, CFSTR(kRTRAllowKey) );
 				}
-				else if ( CFDictionaryContainsKey( cfPluginRestrictions, CFSTR("General") ) ) //General entry is in the dictionary
+				else
 				{
-					DSCFRelease(cfNodeName);
-					cfNodeName = CFStringCreateWithCString( kCFAllocatorDefault, "General", kCFStringEncodingUTF8 );
-					useRestrictions = true;
+					cfRecordTypes = (CFArrayRef) CFDictionaryGetValue( cfRestrictions, CFSTR(kRTRDenyKey) );
 				}
 				
-				if (useRestrictions)
+				if ( cfRecordTypes == NULL || CFGetTypeID(cfRecordTypes) != CFArrayGetTypeID() )
+					continue;
+				
+				CFIndex typeCount = CFArrayGetCount( cfRecordTypes );
+				
+				node->fTypes = (char **) calloc( typeCount + 1, sizeof(char *) );
+				for ( CFIndex k = 0; k < typeCount; k++ )
 				{
-					//the record type list requested
-					CFStringRef cfRecordTypeList = NULL;
-					cfRecordTypeList = CFStringCreateWithCString( kCFAllocatorDefault, inRecordTypeList, kCFStringEncodingUTF8 );
+					CFStringRef cfRecordType = (CFStringRef) CFArrayGetValueAtIndex( cfRecordTypes, k );
+					if ( cfRecordType != NULL && CFGetTypeID(cfRecordType) == CFStringGetTypeID() && CFStringGetLength(cfRecordType) > 0 )
+						node->fTypes[node->fTypeCount++] = RecTypeCopyCString( cfRecordType );
+				}
+			}
+			
+			DSFree( nodeKeys );
+			DSFree( nodeValues );
+		}
+		
+		DSFree( keys );
+		DSFree( values );
+		
+		// at most half full so a miss ends quickly
+		newIndex->fHashMask = 7;
+		while ( newIndex->fHashMask + 1 < 2 * newIndex->fPluginCount )
+			newIndex->fHashMask = (newIndex->fHashMask << 1) | 1;
+		
+		newIndex->fPluginHash = (UInt32 *) calloc( newIndex->fHashMask + 1, sizeof(UInt32) );
+		for ( UInt32 i = 0; i < newIndex->fPluginCount; i++ )
+		{
+			if ( newIndex->fPlugins[i].fPluginName == NULL )
+				continue;
+			
+			UInt32 slot = newIndex->fPlugins[i].fNameHash & newIndex->fHashMask;
+			while ( newIndex->fPluginHash[slot] != 0 )
+				slot = (slot + 1) & newIndex->fHashMask;
+			
+			newIndex->fPluginHash[slot] = i + 1;
+		}
+	}
+	
+	oldIndex = fRecTypeRestrictionIndex;
+	OSMemoryBarrier();
+	fRecTypeRestrictionIndex = newIndex;
+	
+	// same scheme as the membership hash tables, once every query that started in the old epoch is
+	// done nothing can still be looking at the old index
+	if ( oldIndex != NULL )
+	{
+		UInt32 oldEpoch = (OSAtomicXor32OrigBarrier( 1, (volatile uint32_t *) &fRecTypeEpoch ) & 1);
+		while ( fRecTypeReaders[oldEpoch] != 0 )
+			sched_yield();
+		
+		RecTypeFreeIndex( oldIndex );
+	}
 
-					//get the restrictions dictionary
-					CFDictionaryRef cfRestrictions = NULL;
-					cfRestrictions = (CFDictionaryRef)CFDictionaryGetValue( cfPluginRestrictions, cfNodeName );
+} // CompileRecordTypeRestrictions
 
-					if ( CFDictionaryContainsKey( cfRestrictions, CFSTR(kRTRAllowKey) ) ) //Allow record type entry is in the dictionary
-					{
-						isOK = false; //init to false since we look over allowed record types
-						
-						//get the allow record type array
-						CFArrayRef cfAllowRecordTypes = NULL;
-						cfAllowRecordTypes = (CFArrayRef)CFDictionaryGetValue( cfRestrictions, CFSTR(kRTRAllowKey) );
-						
-						CFIndex cfNumberRecordTypesInArray = CFArrayGetCount( cfAllowRecordTypes );
-						UInt32 countMatchesFound = 0;
-						for( CFIndex i = 0; i<cfNumberRecordTypesInArray; i++ )
-						{
-							CFStringRef cfRecordType = (CFStringRef)CFArrayGetValueAtIndex( cfAllowRecordTypes, i );
-							//if cfRecordType is contained within cfRecordTypeList
-							if (CFStringFindWithOptions(cfRecordTypeList, cfRecordType, CFRangeMake( 0, CFStringGetLength( cfRecordTypeList )), kCFCompareCaseInsensitive, NULL))
-							{
-								countMatchesFound++;
-								//confirm that inNumberRecordTypes is equal to countMatchesFound
-								if (inNumberRecordTypes == countMatchesFound)
-								{
-									isOK = true;
-									break;
-								}
-							}
-						}
-					}
-					//check for Deny list ONLY if Allow list is NOT present
-					else if ( CFDictionaryContainsKey( cfRestrictions, CFSTR(kRTRDenyKey) ) ) //Deny record type entry is in the dictionary
-					{
-						//get the deny record type array
-						CFArrayRef cfDenyRecordTypes = NULL;
-						cfDenyRecordTypes = (CFArrayRef)CFDictionaryGetValue( cfRestrictions, CFSTR(kRTRDenyKey) );
-						
-						CFIndex cfNumberRecordTypesInArray = CFArrayGetCount( cfDenyRecordTypes );
-						for( CFIndex i = 0; i<cfNumberRecordTypesInArray; i++ )
-						{
-							CFStringRef cfRecordType = (CFStringRef)CFArrayGetValueAtIndex( cfDenyRecordTypes, i );
-							//if cfRecordType is contained within cfRecordTypeList
-							if (CFStringFindWithOptions(cfRecordTypeList, cfRecordType, CFRangeMake( 0, CFStringGetLength( cfRecordTypeList )), kCFCompareCaseInsensitive, NULL))
-							{
-								isOK = false; //first match we break out
-								break;
-							}
-						}
-					}
-					
-					DSCFRelease(cfRecordTypeList);
+
+static bool RecTypeIsOKToServiceQuery( sRecTypeRestrictionIndex *index, const char *inPluginName, const char *inNodeName,
+									   const char *inRecordTypeList, UInt32 inNumberRecordTypes )
+{
+	bool						isOK	= true;
+	sRecTypePluginRestriction	*plugin	= NULL;
+	sRecTypeNodeRestriction		*node	= NULL;
+	
+	if ( index == NULL || index->fPluginHash == NULL )
+		return(isOK);
+	
+	UInt32 hashval = DSHashString( inPluginName );
+	for ( UInt32 slot = (hashval & index->fHashMask); index->fPluginHash[slot] != 0; slot = (slot + 1) & index->fHashMask )
+	{
+		sRecTypePluginRestriction *candidate = &index->fPlugins[index->fPluginHash[slot] - 1];
+		if ( candidate->fNameHash == hashval && strcmp(candidate->fPluginName, inPluginName) == 0 )
+		{
+			plugin = candidate;
+			break;
+		}
+	}
+	
+	if ( plugin == NULL ) //plugin entry is not in the dictionary
+		return(isOK);
+	
+	//nodename entry wins over the General entry
+	node = plugin->fGeneral;
+	for ( UInt32 i = 0; i < plugin->fNodeCount; i++ )
+	{
+		if ( plugin->fNodes[i].fNodeName != NULL && strcmp(plugin->fNodes[i].fNodeName, inNodeName) == 0 )
+		{
+			node = &plugin->fNodes[i];
+			break;
+		}
+	}
+	
+	if ( node == NULL )
+		return(isOK);
+	
+	if ( node->fIsAllowList )
+	{
+		isOK = false; //init to false since we look over allowed record types
+		
+		UInt32 countMatchesFound = 0;
+		for ( UInt32 i = 0; i < node->fTypeCount; i++ )
+		{
+			//if the record type is contained within inRecordTypeList
+			if ( strcasestr(inRecordTypeList, node->fTypes[i]) != NULL )
+			{
+				countMatchesFound++;
+				//confirm that inNumberRecordTypes is equal to countMatchesFound
+				if (inNumberRecordTypes == countMatchesFound)
+				{
+					isOK = true;
+					break;
 				}
-				DSCFRelease(cfNodeName);
 			}
 		}
-		DSCFRelease(cfPluginName);
 	}
+	else
+	{
+		for ( UInt32 i = 0; i < node->fTypeCount; i++ )
+		{
+			if ( strcasestr(inRecordTypeList, node->fTypes[i]) != NULL )
+			{
+				isOK = false; //first match we break out
+				break;
+			}
+		}
+	}
+
+	return(isOK);
 	
-	fMutex.SignalLock();
+} // RecTypeIsOKToServiceQuery
+
 
+// ---------------------------------------------------------------------------
+//	* IsOKToServiceQuery
+//
+//		Does not take fMutex, works off the compiled restriction index.
+// ---------------------------------------------------------------------------
+
+bool CPlugInList::IsOKToServiceQuery( const char *inPluginName, const char *inNodeName, const char *inRecordTypeList, UInt32 inNumberRecordTypes )
+{
+	bool						isOK	= true;
+	UInt32						epoch	= 0;
+	
+	if (inRecordTypeList == NULL) //can't see this ever happening as we check before calling this routine
+		return(isOK);
+	
+	if ( fRecTypeRestrictionIndex == NULL || inPluginName == NULL || inNodeName == NULL )
+		return(isOK);
+	
+	// register in the current epoch and re-check it, so the compile either waits for us or we see its new index
+	do
+	{
+		epoch = (fRecTypeEpoch & 1);
+		OSAtomicIncrement32Barrier( &fRecTypeReaders[epoch] );
+		if ( (fRecTypeEpoch & 1) == epoch )
+			break;
+		
+		OSAtomicDecrement32Barrier( &fRecTypeReaders[epoch] );
+	} while ( 1 );
+	
+	isOK = RecTypeIsOKToServiceQuery( fRecTypeRestrictionIndex, inPluginName, inNodeName, inRecordTypeList, inNumberRecordTypes );
+	
+	OSAtomicDecrement32Barrier( &fRecTypeReaders[epoch] );
+	
 	return(isOK);
 	
 } // IsOKToServiceQuery
 
 
+
+
 CPlugInList::sTableData* CPlugInList::MakeTableEntryCopy( sTableData *inEntry )
 {
 	//to be used only for lazy loading
@@ -1360,6 +1683,7 @@ CPlugInList::sTableData* CPlugInList::MakeTableEntryCopy( sTableData *inEntry )
 	outEntry->fKey = inEntry->fKey;
 	outEntry->fState = inEntry->fState;
 	outEntry->fValidDataStamp = inEntry->fValidDataStamp;
+	outEntry->fHandle = inEntry->fHandle;
 	outEntry->pNext = nil;
 
 	return(outEntry);
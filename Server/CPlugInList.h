@@ -75,6 +75,32 @@
 
 // Typedefs --------------------------------------------------------------------
 
+// compiled form of DSRecordTypeRestrictions.plist, rebuilt whenever the plist is read or set
+typedef struct sRecTypeNodeRestriction
+{
+	char				*fNodeName;			// NULL for the "General" entry
+	bool				fIsAllowList;		// allow list wins if both are present
+	UInt32				fTypeCount;
+	char				**fTypes;
+} sRecTypeNodeRestriction;
+
+typedef struct sRecTypePluginRestriction
+{
+	char					*fPluginName;
+	UInt32					fNameHash;
+	UInt32					fNodeCount;
+	sRecTypeNodeRestriction	*fNodes;
+	sRecTypeNodeRestriction	*fGeneral;		// points into fNodes or NULL
+} sRecTypePluginRestriction;
+
+typedef struct sRecTypeRestrictionIndex
+{
+	UInt32						fPluginCount;
+	sRecTypePluginRestriction	*fPlugins;
+	UInt32						fHashMask;
+	UInt32						*fPluginHash;		// open addressed by name hash, plugin index + 1, 0 is empty
+} sRecTypeRestrictionIndex;
+
 class CPlugInList {
 public:
 typedef struct sTableData
@@ -88,14 +114,17 @@ typedef struct sTableData
 	CFUUIDRef			fCFuuidFactory;
 	UInt32				fULVers;
 	FourCharCode		fKey;
-	UInt32				fState;
-	UInt32				fValidDataStamp; //perhaps better if uuid can seed this mod count?
+	volatile UInt32		fState;
+	volatile UInt32		fValidDataStamp; //perhaps better if uuid can seed this mod count?
 	eDSPluginLevel		fLevel;
+	SInt32				fHandle;
 	sTableData		   *pNext;
 } sTableData;
 
 enum {
-	kMaxPlugIns	= 128
+	kMaxPlugIns				= 128,
+	kPlugInNameHashSize		= 256,	// power of 2, at least twice kMaxPlugIns
+	kInvalidPlugInHandle	= -1
 };
 
 public:
@@ -125,6 +154,14 @@ public:
 	SInt32		UpdateValidDataStamp( const char *inName );
 	UInt32		GetValidDataStamp	( const char *inName );
 
+	// handles are stable for the life of the process, the ForHandle calls never take the mutex
+	SInt32		GetPlugInHandle		( const char *inName );
+	SInt32		GetStateForHandle	( SInt32 inHandle, UInt32 *outState );
+	SInt32		UpdateValidDataStampForHandle
+									( SInt32 inHandle );
+	UInt32		GetValidDataStampForHandle
+									( SInt32 inHandle );
+
 	UInt32		GetPlugInCount		( void );
 	UInt32		GetActiveCount		( void );
 
@@ -146,16 +183,23 @@ CServerPlugin* 	GetPlugInPtr		( const UInt32 inKey, bool loadIfNeeded = true );
 protected:
 	bool		CreatePrefDirectory	( void );
 	sTableData*	MakeTableEntryCopy	( sTableData* inEntry );
+	void		CompileRecordTypeRestrictions
+									( void );
 	void		SetPluginState		( CServerPlugin	*inPluginPtr, ePluginState inPluginState );
 
 
 	CFDictionaryRef		fCFRecordTypeRestrictions;
+	sRecTypeRestrictionIndex * volatile fRecTypeRestrictionIndex;	// swapped atomically, read without fMutex
+	volatile UInt32		fRecTypeEpoch;
+	volatile SInt32		fRecTypeReaders[2];		// queries in each epoch, the old index is freed once its epoch drains
 
 private:
 	UInt32				fPICount;
 	DSMutexSemaphore		fMutex;
 	sTableData			*fTable;
 	sTableData			*fTableTail;
+	sTableData			*fHandleTable[kMaxPlugIns];			// entries are never freed, indexed by handle
+	volatile SInt32		fNameHash[kPlugInNameHashSize];		// handle + 1, 0 is an empty slot
 	DSEventSemaphore   	fWaitToInit;
 };
 
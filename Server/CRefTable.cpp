@@ -61,6 +61,12 @@ sRefEntry::sRefEntry( void )
 {
 	fNodeName = NULL;
 	fPlugin	= NULL;
+	fClientPrev = NULL;
+	fClientNext = NULL;
+	fPluginPrev = NULL;
+	fPluginNext = NULL;
+	fOnClientList = false;
+	fOnPluginList = false;
 }
 
 sRefEntry::~sRefEntry( void )
@@ -107,6 +113,8 @@ sRefEntry::~sRefEntry( void )
 sClientEntry::sClientEntry( void )
 {
 	fFlags = 0;
+	fRefListHead = NULL;
+	fNumRefs = 0;
 }
 
 sClientEntry::~sClientEntry( void )
@@ -128,21 +136,65 @@ sClientEntry::~sClientEntry( void )
 void
 sClientEntry::ClearChildRefs( void )
 {
-	tRefToEntryI	refIter;
-	
-	for ( refIter = fSubRefs.begin(); refIter != fSubRefs.end(); ) {
-		sRefEntry	*tempEntry = refIter->second;
+	// each removal is queued separately so other clients get a turn on the queue in between
+	while ( fRefListHead != NULL ) {
+		sRefEntry	*tempEntry = fRefListHead;
 		
-		fSubRefs.erase( refIter++ );
+		UnlinkRef( tempEntry );
 		
 		fRefTable->RemoveReference( tempEntry->fRefNum );
 		tempEntry->Release(); // release from this list
 	}
 }
 
+void
+sClientEntry::LinkRef( sRefEntry *inEntry )
+{
+	inEntry->fClientPrev = NULL;
+	inEntry->fClientNext = fRefListHead;
+	if ( fRefListHead != NULL ) {
+		fRefListHead->fClientPrev = inEntry;
+	}
+	
+	fRefListHead = inEntry->Retain();
+	inEntry->fOnClientList = true;
+	fNumRefs++;
+}
+
+// caller is responsible for releasing the list's retain when this returns true
+bool
+sClientEntry::UnlinkRef( sRefEntry *inEntry )
+{
+	if ( inEntry->fOnClientList == false ) {
+		return false;
+	}
+	
+	if ( inEntry->fClientPrev != NULL ) {
+		inEntry->fClientPrev->fClientNext = inEntry->fClientNext;
+	}
+	else {
+		fRefListHead = inEntry->fClientNext;
+	}
+	
+	if ( inEntry->fClientNext != NULL ) {
+		inEntry->fClientNext->fClientPrev = inEntry->fClientPrev;
+	}
+	
+	inEntry->fClientPrev = NULL;
+	inEntry->fClientNext = NULL;
+	inEntry->fOnClientList = false;
+	fNumRefs--;
+	
+	return true;
+}
+
 CRefTable::CRefTable( RefDeallocateProc *deallocProc ) : fDeallocProc(deallocProc)
 {
-	fNextIndex = 0;
+	bzero( fRefSlabs, sizeof(fRefSlabs) );
+	fNumRefSlots = 0;
+	fNumRefs = 0;
+	fFreeHead = kNoFreeRefSlot;
+	fFreeTail = kNoFreeRefSlot;
 	fQueue = dispatch_queue_create( "CRefTable", NULL );
 	fCleanupQueue = dispatch_queue_create( "CRefTableCleanup", NULL );
 	dispatch_queue_set_width( fQueue, LONG_MAX );
@@ -153,19 +205,151 @@ CRefTable::~CRefTable( void )
 	dispatch_release( fCleanupQueue );
 	dispatch_release( fQueue );
 	fQueue = NULL;
+	
+	for ( UInt32 ii = 0; ii < kMaxRefSlabs && fRefSlabs[ii] != NULL; ii++ ) {
+		DSFree( fRefSlabs[ii] );
+	}
+}
+
+// must be called on fQueue
+sRefSlot *
+CRefTable::GetRefSlot( UInt32 inRef )
+{
+	UInt32		index	= (inRef & kIndexMask);
+	sRefSlot	*slot;
+	
+	if ( index >= fNumRefSlots ) {
+		return NULL;
+	}
+	
+	slot = &fRefSlabs[index / kRefSlabSize][index % kRefSlabSize];
+	
+	// the generation and type are part of the value, so a stale or mistyped reference won't match
+	if ( slot->fEntry == NULL || slot->fEntry->fRefNum != inRef ) {
+		return NULL;
+	}
+	
+	return slot;
+}
+
+// must be called as a barrier on fQueue
+UInt32
+CRefTable::AllocateRefSlot( void )
+{
+	UInt32		index	= kNoFreeRefSlot;
+	sRefSlot	*slot;
+	
+	if ( fFreeHead != kNoFreeRefSlot ) {
+		index = fFreeHead;
+		slot = &fRefSlabs[index / kRefSlabSize][index % kRefSlabSize];
+		
+		fFreeHead = slot->fNextFree;
+		if ( fFreeHead == kNoFreeRefSlot ) {
+			fFreeTail = kNoFreeRefSlot;
+		}
+	}
+	else if ( fNumRefSlots <= kIndexMask ) {
+		index = fNumRefSlots;
+		
+		if ( fRefSlabs[index / kRefSlabSize] == NULL ) {
+			fRefSlabs[index / kRefSlabSize] = (sRefSlot *) calloc( kRefSlabSize, sizeof(sRefSlot) );
+			if ( fRefSlabs[index / kRefSlabSize] == NULL ) {
+				return kNoFreeRefSlot;
+			}
+		}
+		
+		fNumRefSlots++;
+	}
+	
+	if ( index != kNoFreeRefSlot ) {
+		slot = &fRefSlabs[index / kRefSlabSize][index % kRefSlabSize];
+		slot->fNextFree = kNoFreeRefSlot;
+		fNumRefs++;
+	}
+	
+	return index;
+}
+
+// must be called as a barrier on fQueue
+void
+CRefTable::FreeRefSlot( UInt32 inIndex )
+{
+	sRefSlot	*slot = &fRefSlabs[inIndex / kRefSlabSize][inIndex % kRefSlabSize];
+	
+	slot->fEntry = NULL;
+	slot->fClient = NULL;
+	slot->fGeneration = ((slot->fGeneration + 1) & (kGenerationMask >> kGenerationShift));
+	slot->fNextFree = kNoFreeRefSlot;
+	
+	// append to the tail so the oldest freed slot is re-used first
+	if ( fFreeTail != kNoFreeRefSlot ) {
+		fRefSlabs[fFreeTail / kRefSlabSize][fFreeTail % kRefSlabSize].fNextFree = inIndex;
+	}
+	else {
+		fFreeHead = inIndex;
+	}
+	
+	fFreeTail = inIndex;
+	fNumRefs--;
+}
+
+// must be called as a barrier on fQueue
+void
+CRefTable::LinkPluginRef( sRefEntry *inEntry )
+{
+	if ( inEntry->fPlugin == NULL ) {
+		return;
+	}
+	
+	sRefEntry *&head = fPluginRefs[inEntry->fPlugin];
+	
+	inEntry->fPluginPrev = NULL;
+	inEntry->fPluginNext = head;
+	if ( head != NULL ) {
+		head->fPluginPrev = inEntry;
+	}
+	
+	head = inEntry;
+	inEntry->fOnPluginList = true;
+}
+
+// must be called as a barrier on fQueue
+void
+CRefTable::UnlinkPluginRef( sRefEntry *inEntry )
+{
+	if ( inEntry->fOnPluginList == false ) {
+		return;
+	}
+	
+	if ( inEntry->fPluginPrev != NULL ) {
+		inEntry->fPluginPrev->fPluginNext = inEntry->fPluginNext;
+	}
+	else if ( inEntry->fPluginNext != NULL ) {
+		fPluginRefs[inEntry->fPlugin] = inEntry->fPluginNext;
+	}
+	else {
+		fPluginRefs.erase( inEntry->fPlugin );
+	}
+	
+	if ( inEntry->fPluginNext != NULL ) {
+		inEntry->fPluginNext->fPluginPrev = inEntry->fPluginPrev;
+	}
+	
+	inEntry->fPluginPrev = NULL;
+	inEntry->fPluginNext = NULL;
+	inEntry->fOnPluginList = false;
 }
 
 sRefEntry *
 CRefTable::GetRefEntry( UInt32 inRef )
 {
 	__block sRefEntry		*entry = NULL;
-	__block tRefToEntryI	iter;
 	
 	dispatch_sync( fQueue,
 				   ^(void) {
-					   iter = fRefToEntry.find( inRef );
-					   if ( iter != fRefToEntry.end() ) {
-						   entry = iter->second->Retain();
+					   sRefSlot *slot = GetRefSlot( inRef );
+					   if ( slot != NULL ) {
+						   entry = slot->fEntry->Retain();
 					   }
 				   } );
 	
@@ -176,14 +360,12 @@ tDirStatus
 CRefTable::CreateReference( UInt32 *outRef, eRefType inType, CServerPlugin *inPlugin, UInt32 inParentID, pid_t inPID, mach_port_t inMachPort, 
 							sockaddr *inAddress, int inSocket, const char *inNodeName )
 {
-	UInt32							type	= (((UInt32) inType) << 24);
+	UInt32							type	= (((UInt32) inType) << kRefTypeShift);
 	__block tDirStatus				status	= eDSRefSpaceFull;
 	__block UInt32					newRef	= 0;
 	__block sClientEntry			*client = NULL;
 	__block sRefEntry				*entry	= NULL;
 	__block sRefEntry				*parent = NULL;
-	__block tRefToClientEntryI		clientIter;
-	__block tRefToEntryI			refIter;
 	__block tPortToClientEntryI		portIter;
 	__block tMachPortToClientEntryI	machIter;
 	__block size_t					size;
@@ -194,31 +376,26 @@ CRefTable::CreateReference( UInt32 *outRef, eRefType inType, CServerPlugin *inPl
 		inPID = gDaemonPID;
 	}
 	
-	if ( inParentID != 0 ) {
-		
-		if ( VerifyReference(inParentID, GetRefType(inParentID), NULL, inMachPort, inSocket) == eDSNoErr ) {
-			dispatch_sync( fQueue, 
-						   ^(void) {
-							   refIter = fRefToEntry.find( inParentID );
-							   if ( refIter != fRefToEntry.end() ) {
-								   parent = refIter->second->Retain();
-								   
-								   // now get the client pointer
-								   clientIter = fRefToClientEntry.find( inParentID );
-								   if ( clientIter != fRefToClientEntry.end() ) {
-									   client = clientIter->second->Retain();
-								   }
-							   }
-						   } );
-		}
-		
-		if ( parent == NULL ) {
-			return eDSInvalidReference;
-		}
-	}
-	else {
-		dispatch_barrier_sync( fQueue,
-					   ^(void) {
+	// the client (or the parent and its client) is resolved in the same barrier the reference is created in
+	dispatch_barrier_sync( fQueue,
+				   ^(void) {
+					   if ( inParentID != 0 ) {
+						   sRefSlot *parentSlot = GetRefSlot( inParentID );
+						   if ( parentSlot == NULL || parentSlot->fClient == NULL ) {
+							   DbgLog( kLogNotice, "CRefTable::CreateReference - parent reference value of <%u> was not found", inParentID );
+							   status = eDSInvalidReference;
+							   return;
+						   }
+						   
+						   if ( VerifyRefOwner(inParentID, parentSlot->fClient, inMachPort, inSocket) != eDSNoErr ) {
+							   status = eDSInvalidReference;
+							   return;
+						   }
+						   
+						   parent = parentSlot->fEntry->Retain();
+						   client = parentSlot->fClient->Retain();
+					   }
+					   else {
 						   if ( inSocket != 0 ) {
 							   portIter = fPortToClientEntry.find( inSocket );
 							   if ( portIter != fPortToClientEntry.end() ) {
@@ -250,68 +427,64 @@ CRefTable::CreateReference( UInt32 *outRef, eRefType inType, CServerPlugin *inPl
 								   fMachPortToClientEntry[inMachPort] = client->Retain();
 							   }
 						   }
-					   } );
-	}
-	
-	// we shouldn't reach max limit, so don't expect it
-	if ( DSexpect_true(fRefToEntry.size() < 0xfffe) ) {
-		dispatch_barrier_sync( fQueue,
-					   ^(void) {
-						   while ( 1 ) {
-							   // we should have mostly empty spots in normal case
-							   newRef = type | (fNextIndex++ & kIndexMask);
-							   refIter = fRefToEntry.find( newRef );
-							   if ( refIter == fRefToEntry.end() ) {
-								   break;
-							   }
-						   }
+					   }
+					   
+					   // we only run out of slots with over a million references open, so don't expect it
+					   UInt32 index = AllocateRefSlot();
+					   if ( DSexpect_false(index == kNoFreeRefSlot) ) {
+						   return;
+					   }
+					   
+					   sRefSlot *slot = &fRefSlabs[index / kRefSlabSize][index % kRefSlabSize];
+					   
+					   newRef = type | (slot->fGeneration << kGenerationShift) | index;
+					   
+					   entry = new sRefEntry;
+					   entry->fParentID = inParentID;
+					   entry->fRefNum = newRef;
+					   entry->fNodeName = (inNodeName ? strdup(inNodeName) : NULL);
+					   entry->fPlugin = inPlugin;
+					   entry->fRefTable = this;
+					   
+					   slot->fEntry = entry->Retain();
+					   LinkPluginRef( entry );
+					   if ( client != NULL ) {
+						   client->LinkRef( entry );					// add to the client's refs
+						   slot->fClient = client->Retain();			// link to client
 						   
-						   entry = new sRefEntry;
-						   entry->fParentID = inParentID;
-						   entry->fRefNum = newRef;
-						   entry->fNodeName = (inNodeName ? strdup(inNodeName) : NULL);
-						   entry->fPlugin = inPlugin;
-						   entry->fRefTable = this;
+						   size = client->fNumRefs;
+						   warnLimit = (inPID == gDaemonPID ? 2000 : gRefCountWarningLimit);
 						   
-						   fRefToEntry[newRef] = entry->Retain();
-						   if ( client != NULL ) {
-							   client->fSubRefs[newRef] = entry->Retain();	// add to the subrefs
-							   fRefToClientEntry[newRef] = client->Retain();	// link to client
-							   
-							   size = client->fSubRefs.size();
-							   warnLimit = (inPID == gDaemonPID ? 2000 : gRefCountWarningLimit);
-							   
-							   if ( size > 0 && (size % warnLimit) == 0 ) {
-								   if ( DSexpect_true(inPID != gDaemonPID) ) {
-									   clientName = dsGetNameForProcessID( inPID );
-									   
-									   syslog( LOG_ALERT, "Client: %s - PID: %d, has %d open references, the warning limit is %d.",
-											  clientName, inPID, size, warnLimit );
-									   DbgLog( kLogError, "Client: %s - PID: %d, has %d open references, the warning limit is %d.",
-											  clientName, inPID, size, warnLimit );
-									   DSFree( clientName );
-								   }
-								   else {
-									   syslog( LOG_ALERT, "DirectoryService has %d internal references open (due to clients), warning limit is %d.",
-											   size, warnLimit );
-									   DbgLog( kLogError, "DirectoryService has %d internal references open (due to clients), warning limit is %d.",
-											   size, warnLimit );
-								   }
+						   if ( size > 0 && (size % warnLimit) == 0 ) {
+							   if ( DSexpect_true(inPID != gDaemonPID) ) {
+								   clientName = dsGetNameForProcessID( inPID );
+								   
+								   syslog( LOG_ALERT, "Client: %s - PID: %d, has %d open references, the warning limit is %d.",
+										  clientName, inPID, size, warnLimit );
+								   DbgLog( kLogError, "Client: %s - PID: %d, has %d open references, the warning limit is %d.",
+										  clientName, inPID, size, warnLimit );
+								   DSFree( clientName );
 							   }
-							   else if (gLogAPICalls) {
-								   syslog( LOG_ALERT,"Client PID: %d, has %d open references.", inPID, size );
+							   else {
+								   syslog( LOG_ALERT, "DirectoryService has %d internal references open (due to clients), warning limit is %d.",
+										   size, warnLimit );
+								   DbgLog( kLogError, "DirectoryService has %d internal references open (due to clients), warning limit is %d.",
+										   size, warnLimit );
 							   }
 						   }
-						   
-						   if ( parent != NULL ) {
-							   parent->fSubRefs[newRef] = entry->Retain();
+						   else if (gLogAPICalls) {
+							   syslog( LOG_ALERT,"Client PID: %d, has %d open references.", inPID, size );
 						   }
-						   
-						   // now set the returns
-						   *outRef = newRef;
-						   status = eDSNoErr;
-					   } );
-	}
+					   }
+					   
+					   if ( parent != NULL ) {
+						   parent->fSubRefs[newRef] = entry->Retain();
+					   }
+					   
+					   // now set the returns
+					   *outRef = newRef;
+					   status = eDSNoErr;
+				   } );
 	
 	if ( client != NULL ) {
 		client->Release();
@@ -328,157 +501,137 @@ CRefTable::CreateReference( UInt32 *outRef, eRefType inType, CServerPlugin *inPl
 	return status;
 }
 
+// must be called on fQueue
+tDirStatus
+CRefTable::VerifyRefOwner( UInt32 inRef, sClientEntry *inClient, mach_port_t inMachPort, int inSocket )
+{
+	if ( inSocket != 0 ) {
+		if ( (inClient->fFlags & kClientTypeTCP) != 0 && inClient->portInfo.fSocket == inSocket ) {
+			return eDSNoErr;
+		}
+		
+		DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> was found but client TCP port mismatch %d != %d",
+			    inRef, inSocket, inClient->portInfo.fSocket );
+	}
+	else {
+		if ( (inClient->fFlags & kClientTypeMach) != 0 && inClient->portInfo.fMachPort == inMachPort ) {
+			return eDSNoErr;
+		}
+		
+		DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> was found but client MACH port mismatch %d != %d",
+			    inRef, inMachPort, inClient->portInfo.fMachPort );
+	}
+	
+	return eDSInvalidReference;
+}
+
 tDirStatus
-CRefTable::VerifyReference( UInt32 inRef, eRefType inType, CServerPlugin **outPlugin, mach_port_t inMachPort, int inSocket )
+CRefTable::VerifyReference( UInt32 inRef, eRefType inType, CServerPlugin **outPlugin, mach_port_t inMachPort, int inSocket, 
+						    char **outNodeName )
 {
-	__block tDirStatus			status	= eDSInvalidReference;
-	__block sClientEntry		*client	= NULL;
-	__block tRefToClientEntryI	clientIter;
-	__block tRefToEntryI		entryIter;
+	__block tDirStatus	status	= eDSInvalidReference;
 	
 	if ( GetRefType(inRef) != inType ) {
 		DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> is not reference is wrong type.", inRef, inType );
 		return eDSInvalidRefType;
 	}
 
+	// entry, owning client and plugin all come from the same slot, so resolve them in one pass
 	dispatch_sync( fQueue, 
 				   ^(void) {
-					   clientIter = fRefToClientEntry.find( inRef );
-					   if ( clientIter != fRefToClientEntry.end() ) {
-						   client = clientIter->second->Retain();
+					   sRefSlot *slot = GetRefSlot( inRef );
+					   if ( slot == NULL || slot->fClient == NULL ) {
+						   DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> was not found", inRef );
+						   return;
+					   }
+					   
+					   status = VerifyRefOwner( inRef, slot->fClient, inMachPort, inSocket );
+					   if ( status == eDSNoErr ) {
+						   if ( outPlugin != NULL ) {
+							   (*outPlugin) = slot->fEntry->fPlugin;
+						   }
+						   
+						   if ( outNodeName != NULL && slot->fEntry->fNodeName != NULL ) {
+							   (*outNodeName) = strdup( slot->fEntry->fNodeName );
+						   }
 					   }
 				   } );
 	
-	if ( client != NULL ) {
-		if ( inSocket != 0 ) {
-			if ( (client->fFlags & kClientTypeTCP) != 0 ) {
-				if ( client->portInfo.fSocket == inSocket ) {
-					if ( outPlugin != NULL ) {
-						dispatch_sync( fQueue, 
-									   ^(void) {
-										   entryIter = client->fSubRefs.find( inRef );
-										   if ( entryIter != client->fSubRefs.end() ) {
-											   (*outPlugin) = entryIter->second->fPlugin;
-											   status = eDSNoErr;
-										   }
-									   } );
-					}
-					else {
-						status = eDSNoErr;
-					}
-				}
-			}
-			
-			if ( status != eDSNoErr ) {
-				DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> was found but client TCP port mismatch %d != %d",
-					    inRef, inSocket, client->portInfo.fSocket );
-			}
-		}
-		else {
-			if ( (client->fFlags & kClientTypeMach) != 0 ) {
-				if ( client->portInfo.fMachPort == inMachPort ) {
-					if ( outPlugin != NULL ) {
-						dispatch_sync( fQueue, 
-									   ^(void) {
-										   entryIter = client->fSubRefs.find( inRef );
-										   if ( entryIter != client->fSubRefs.end() ) {
-											   (*outPlugin) = entryIter->second->fPlugin;
-											   status = eDSNoErr;
-										   }
-									   } );
-					}
-					else {
-						status = eDSNoErr;
-					}
-				}
-			}
-			
-			if ( status != eDSNoErr ) {
-				DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> was found but client MACH port mismatch %d != %d",
-					    inRef, inMachPort, client->portInfo.fMachPort );
-			}
-		}
-		
-		client->Release();
-	}
-	else {
-		DbgLog( kLogNotice, "CRefTable::VerifyReference - reference value of <%u> was not found", inRef );
-	}
-	
 	return status;
 }
 
 struct sRemoveContext
 {
 	UInt32				refNum;
-	tRefToClientEntry	*refToClientEntry;
-	tRefToEntry			*refToEntry;
+	CRefTable			*refTable;
 };
 
 void
 CRefTable::RemoveReference( void *inContext )
+{
+	sRemoveContext	*context = (sRemoveContext *) inContext;
+	
+	context->refTable->ReleaseReference( context->refNum );
+	
+	delete context;
+}
+
+// must be called as a barrier on fQueue
+void
+CRefTable::ReleaseReference( UInt32 inRef )
 {
 	// need to delete from all tables
-	//   fRefToEntry
-	//   fRefToClientEntry
-	//		-- fSubRefs
+	//   fRefSlabs
+	//   slot client
+	//		-- client ref list
+	//   plugin ref list
 	//   fParent->fSubRefs
 	
-	sRemoveContext	*context = (sRemoveContext *) inContext;
+	sRefSlot *slot = GetRefSlot( inRef );
+	if ( slot == NULL ) {
+		return;
+	}
 	
-	tRefToClientEntryI clientIter = context->refToClientEntry->find( context->refNum );
-	if ( clientIter != context->refToClientEntry->end() ) {
-		sClientEntry	*client = clientIter->second;
-		
-		context->refToClientEntry->erase( clientIter );
-		
-		tRefToEntryI refIter = client->fSubRefs.find( context->refNum );
-		if ( refIter != client->fSubRefs.end() ) {
-			sRefEntry *entry = refIter->second;
-			
-			client->fSubRefs.erase( refIter );
-			
-			DbgLog( kLogDebug, "CRefTable::RemoveReference - Removed reference %d from client subrefs", context->refNum );
+	sRefEntry		*entry		= slot->fEntry;
+	sClientEntry	*client		= slot->fClient;
+	UInt32			parentID	= entry->fParentID;
+	
+	FreeRefSlot( inRef & kIndexMask );
+	UnlinkPluginRef( entry );
+	
+	if ( client != NULL ) {
+		if ( client->UnlinkRef(entry) ) {
+			DbgLog( kLogDebug, "CRefTable::RemoveReference - Removed reference %d from client subrefs", inRef );
 			entry->Release();
 		}
 		
 		client->Release();
 	}
 	
-	tRefToEntryI refIter = context->refToEntry->find( context->refNum );
-	if ( refIter != context->refToEntry->end() ) {
-		sRefEntry *	entry = refIter->second;
-		UInt32		parentID = entry->fParentID;
-		
-		context->refToEntry->erase( refIter );
-		
-		if ( parentID != 0 ) {
-			refIter = context->refToEntry->find( parentID );
-			if ( refIter != context->refToEntry->end() ) {
-				sRefEntry *	parent = refIter->second;
+	if ( parentID != 0 ) {
+		sRefSlot *parentSlot = GetRefSlot( parentID );
+		if ( parentSlot != NULL ) {
+			sRefEntry *	parent = parentSlot->fEntry;
+			
+			tRefToEntryI refIter = parent->fSubRefs.find( inRef );
+			if ( refIter != parent->fSubRefs.end() ) {
+				parent->fSubRefs.erase( refIter );
+				DbgLog( kLogDebug, "CRefTable::RemoveReference - Removed reference %d from parent %d subrefs", inRef, parentID );
 				
-				refIter = parent->fSubRefs.find( context->refNum );
-				if ( refIter != parent->fSubRefs.end() ) {
-					parent->fSubRefs.erase( refIter );
-					DbgLog( kLogDebug, "CRefTable::RemoveReference - Removed reference %d from parent %d subrefs", context->refNum, parentID );
-					
-					entry->Release();
-				}
+				entry->Release();
 			}
 		}
-		
-		// if we are in localonly mode, we need to decrement our session count here
-		if ( gDSLocalOnlyMode == true && GetRefType(context->refNum) == eRefTypeDir ) {
-			if (__sync_sub_and_fetch( &gLocalSessionCount, 1) == 0) {
-				od_passthru_localonly_exit();
-			}
+	}
+	
+	// if we are in localonly mode, we need to decrement our session count here
+	if ( gDSLocalOnlyMode == true && GetRefType(inRef) == eRefTypeDir ) {
+		if (__sync_sub_and_fetch( &gLocalSessionCount, 1) == 0) {
+			od_passthru_localonly_exit();
 		}
-		
-		DbgLog( kLogInfo, "CRefTable::RemoveReference - Removed reference %d", context->refNum );
-		entry->Release();
 	}
-
-	delete context;
+	
+	DbgLog( kLogInfo, "CRefTable::RemoveReference - Removed reference %d", inRef );
+	entry->Release();
 }
 
 void
@@ -486,8 +639,7 @@ CRefTable::RemoveReference( UInt32 inRef )
 {
 	sRemoveContext *context = new sRemoveContext;
 	context->refNum = inRef;
-	context->refToClientEntry = &fRefToClientEntry;
-	context->refToEntry = &fRefToEntry;
+	context->refTable = this;
 
 	// workaround dispatch + block related limitations
 	dispatch_barrier_async_f( fQueue, context, RemoveReference );
@@ -539,14 +691,19 @@ CRefTable::CopyNodeRefName( tDirNodeReference inDirNodeRef )
 tDirStatus
 CRefTable::SetNodePluginPtr( tDirNodeReference inNodeRef, CServerPlugin *inPlugin )
 {
-	tDirStatus status = eDSInvalidReference;
+	__block tDirStatus status = eDSInvalidReference;
 	
-	sRefEntry *entry = GetRefEntry( inNodeRef );
-	if ( entry != NULL ) {
-		entry->fPlugin = inPlugin;
-		entry->Release();
-		status = eDSNoErr;
-	}
+	// the plugin lists are keyed by plugin so this has to be a write
+	dispatch_barrier_sync( fQueue,
+						   ^(void) {
+							   sRefSlot *slot = GetRefSlot( inNodeRef );
+							   if ( slot != NULL ) {
+								   UnlinkPluginRef( slot->fEntry );
+								   slot->fEntry->fPlugin = inPlugin;
+								   LinkPluginRef( slot->fEntry );
+								   status = eDSNoErr;
+							   }
+						   } );
 	
 	return status;
 }
@@ -572,12 +729,12 @@ CRefTable::CleanRefsForSocket( int inSocket )
 									GetClientIPString( (sockaddr *) &client->clientID.fAddress, clientIP, INET6_ADDRSTRLEN );
 
 									DbgLog( kLogNotice, "Remote Address: %s, Socket: %u, had %d open references before cleanup.", 
-										    clientIP, client->portInfo.fSocket, client->fSubRefs.size() );
+										    clientIP, client->portInfo.fSocket, client->fNumRefs );
 									free(clientIP);
 									
 									if (gLogAPICalls) {
 										syslog( LOG_ALERT, "Remote Address: %d, Socket: %u, had %d open references before cleanup.", 
-											    client->clientID.fPID, client->portInfo.fSocket, client->fSubRefs.size() );
+											    client->clientID.fPID, client->portInfo.fSocket, client->fNumRefs );
 									}
 								}
 								
@@ -602,10 +759,10 @@ CRefTable::CleanRefsForMachRefs( mach_port_t inMachPort )
 						   fMachPortToClientEntry.erase( machIter );
 						   
 						   DbgLog( kLogNotice, "Client PID: %d, had %d open references before cleanup.", client->clientID.fPID,
-								   client->fSubRefs.size() );
+								   client->fNumRefs );
 						   if (gLogAPICalls) {
 							   syslog( LOG_ALERT, "Client PID: %d, had %d open references before cleanup.", client->clientID.fPID, 
-									   client->fSubRefs.size() );
+									   client->fNumRefs );
 						   }
 						   
 						   // we clear child refs first so other tables get cleaned up accordingly
@@ -618,36 +775,18 @@ CRefTable::CleanRefsForMachRefs( mach_port_t inMachPort )
 void
 CRefTable::CleanRefsForPlugin(CServerPlugin *inPlugin, dispatch_block_t completeBlock)
 {
-	__block tMachPortToClientEntryI	machIter;
-	__block tPortToClientEntryI		portIter;
-	__block sClientEntry *			client;
-	__block tRefToEntryI			refIter;
-	__block sRefEntry *				refEntry;
+	__block tPluginToRefListI	pluginIter;
+	__block sRefEntry *			refEntry;
 	
 	if (inPlugin != NULL) {
 		dispatch_barrier_sync(fQueue,
 							  ^(void) {
-								  for (machIter = fMachPortToClientEntry.begin(); machIter != fMachPortToClientEntry.end(); machIter++) {
-									  client = machIter->second;
-									  
-									  for (refIter = client->fSubRefs.begin(); refIter != client->fSubRefs.end(); refIter++) {
-										  refEntry = refIter->second;
-										  if (refEntry->fPlugin == inPlugin) {
-											  DbgLog(kLogInfo, "Force removed reference %d due to plugin disable", refEntry->fRefNum);
-											  RemoveReference(refEntry->fRefNum);
-										  }
-									  }
-								  }
-								  
-								  for (portIter = fPortToClientEntry.begin(); portIter != fPortToClientEntry.end(); portIter++) {
-									  client = portIter->second;
-									  
-									  for (refIter = client->fSubRefs.begin(); refIter != client->fSubRefs.end(); refIter++) {
-										  refEntry = refIter->second;
-										  if (refEntry->fPlugin == inPlugin) {
-											  DbgLog(kLogInfo, "Force removed reference %d due to plugin disable", refEntry->fRefNum);
-											  RemoveReference(refEntry->fRefNum);
-										  }
+								  // removals are queued, so the list is intact while we walk it
+								  pluginIter = fPluginRefs.find(inPlugin);
+								  if (pluginIter != fPluginRefs.end()) {
+									  for (refEntry = pluginIter->second; refEntry != NULL; refEntry = refEntry->fPluginNext) {
+										  DbgLog(kLogInfo, "Force removed reference %d due to plugin disable", refEntry->fRefNum);
+										  RemoveReference(refEntry->fRefNum);
 									  }
 								  }
 							  });
@@ -704,7 +843,7 @@ CRefTable::GetClientPIDListStrings( void )
 		// most clients will have a ref
 		if ( DSexpect_true(size > 0) ) {
 			size_t		outLen	= strlen( outString );
-			size_t		refLen	= size * (8 + 1);
+			size_t		refLen	= size * (10 + 1);
 			size_t		tempLen = outLen + refLen + 1;
 			
 			outString = (char *) reallocf( outString, tempLen );
@@ -713,14 +852,14 @@ CRefTable::GetClientPIDListStrings( void )
 
 			vector<UInt32>::iterator refIter = details->refs.begin();
 
-			snprintf( tempString, tempLen, "%8u", (unsigned int) (*refIter) );
-			tempString += 8;
-			tempLen -= 8;
+			snprintf( tempString, tempLen, "%10u", (unsigned int) (*refIter) );
+			tempString += 10;
+			tempLen -= 10;
 			
 			for ( ++refIter; refIter != details->refs.end(); refIter++ ) {
-				snprintf( tempString, tempLen, ",%8u", (unsigned int) (*refIter) );
-				tempString += 9;
-				tempLen -= 9;
+				snprintf( tempString, tempLen, ",%10u", (unsigned int) (*refIter) );
+				tempString += 11;
+				tempLen -= 11;
 			}
 		}
 		
@@ -739,7 +878,6 @@ CRefTable::GetClientDetails( mach_port_t inMachPort, int inSocket )
 	__block vector<tClientDetails>	*returnList = new vector<tClientDetails>;
 	__block tMachPortToClientEntryI	machIter;
 	__block tPortToClientEntryI		portIter;
-	__block tRefToEntryI			entryIter;
 	__block sClientEntry *			clientEntry = NULL;
 	__block tClientDetails			details;
 
@@ -749,8 +887,8 @@ CRefTable::GetClientDetails( mach_port_t inMachPort, int inSocket )
 		inDetails->portInfo = inEntry->portInfo;
 		inDetails->refs.clear();
 		
-		for ( entryIter = inEntry->fSubRefs.begin(); entryIter != inEntry->fSubRefs.end(); entryIter++ ) {
-			inDetails->refs.push_back( entryIter->second->fRefNum );
+		for ( sRefEntry *entry = inEntry->fRefListHead; entry != NULL; entry = entry->fClientNext ) {
+			inDetails->refs.push_back( entry->fRefNum );
 		}
 	};
 
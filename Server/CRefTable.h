@@ -48,13 +48,17 @@ class CServerPlugin;
  *                                                                  -> tAttributeValueListRef[]
  *
  * References here always use 0x00000000 bits
- *                              XX			= Reference type (eRefType)
- *                                XX        = Reference subtype (eSubType)
- *                                  XXXX	= Reference index (circular)
+ *                              X			= Slot generation
+ *                               X			= Reference type (eRefType)
+ *                                F			= Reserved, the framework tags its own references with 0x00300000
+ *											  and remote references with 0x00C00000
+ *                                 XXXXX	= Reference index (slot in the table)
  *
- * Indexes are not recycled until we loop back around.  Simplifies debugging so refs aren't
- * re-used immediately after they are freed.  Most references are freed anyway, so there should
- * always be free slots.
+ * Slots are carved out of fixed size slabs that are never moved or freed while the table is alive,
+ * so a reference resolves to its slot with a mask instead of a map lookup.  Freed slots are put at
+ * the tail of the free list and their generation is bumped, so a slot is not re-used immediately
+ * after it is freed (simplifies debugging) and a stale reference to a re-used slot will not match.
+ * The generation stops short of the sign bit so references stay positive when logged.
  */
 
 enum eRefType {
@@ -73,9 +77,15 @@ enum eSubType {
 	eSubTypeCSBP				= 0x30, // used by older clients, only for reference
 };
 
-#define kRefTypeMask		0xff000000
-#define kSubTypeMask		0x00ff0000
-#define kIndexMask			0x0000ffff
+#define kGenerationMask		0x70000000
+#define kGenerationShift	28
+#define kRefTypeMask		0x0f000000
+#define kRefTypeShift		24
+#define kIndexMask			0x000fffff
+
+#define kRefSlabSize		4096
+#define kMaxRefSlabs		((kIndexMask + 1) / kRefSlabSize)
+#define kNoFreeRefSlot		0xffffffff
 
 struct sRefEntry;
 struct sClientEntry;
@@ -85,15 +95,15 @@ class CRefTable;
 typedef map<UInt32, sRefEntry *>					tRefToEntry;
 typedef map<UInt32, sRefEntry *>::iterator			tRefToEntryI;
 
-typedef map<UInt32, sClientEntry *>					tRefToClientEntry;
-typedef map<UInt32, sClientEntry *>::iterator		tRefToClientEntryI;
-
 typedef map<mach_port_t, sClientEntry *>			tMachPortToClientEntry;
 typedef map<mach_port_t, sClientEntry *>::iterator	tMachPortToClientEntryI;
 
 typedef map<int, sClientEntry *>					tPortToClientEntry;
 typedef map<int, sClientEntry *>::iterator			tPortToClientEntryI;
 
+typedef map<CServerPlugin *, sRefEntry *>			tPluginToRefList;
+typedef map<CServerPlugin *, sRefEntry *>::iterator	tPluginToRefListI;
+
 struct sRefEntry : public CObject<sRefEntry>
 {
 	UInt32				fRefNum;
@@ -102,6 +112,14 @@ struct sRefEntry : public CObject<sRefEntry>
 	char				*fNodeName;	// only retained for an OpenDirNode call inside the daemon for record type restrictions support
 	tRefToEntry			fSubRefs;
 	CRefTable			*fRefTable;
+	
+	// intrusive links so clients and plugins can walk only the references they own
+	sRefEntry			*fClientPrev;
+	sRefEntry			*fClientNext;
+	sRefEntry			*fPluginPrev;
+	sRefEntry			*fPluginNext;
+	bool				fOnClientList;
+	bool				fOnPluginList;
 
 public:
 			sRefEntry( void );
@@ -129,7 +147,8 @@ union uPortInfo
 struct sClientEntry : public CObject<sClientEntry>
 {
 	int32_t				fFlags;
-	tRefToEntry			fSubRefs;
+	sRefEntry			*fRefListHead;	// references owned by this client, each retained by the list
+	size_t				fNumRefs;
 	uClientID			clientID;
 	uPortInfo			portInfo;
 	CRefTable			*fRefTable;
@@ -137,11 +156,21 @@ struct sClientEntry : public CObject<sClientEntry>
 public:
 			sClientEntry( void );
 	void	ClearChildRefs( void );
+	void	LinkRef( sRefEntry *inEntry );
+	bool	UnlinkRef( sRefEntry *inEntry );
 	
 protected:
 	virtual	~sClientEntry( void );
 };
 
+struct sRefSlot
+{
+	sRefEntry			*fEntry;		// NULL when the slot is free
+	sClientEntry		*fClient;		// client that owns the reference
+	UInt32				fGeneration;
+	UInt32				fNextFree;
+};
+
 #define kClientTypeMach	0x00000001
 #define kClientTypeTCP	0x00000002
 
@@ -153,7 +182,7 @@ struct tClientDetails
 	vector<UInt32>		refs;
 };
 
-inline eRefType	GetRefType( UInt32 inRefNum ) { return (eRefType) ((inRefNum & kRefTypeMask) >> 24); }
+inline eRefType	GetRefType( UInt32 inRefNum ) { return (eRefType) ((inRefNum & kRefTypeMask) >> kRefTypeShift); }
 int GetClientIPString( sockaddr *address, char *clientIP, size_t client_size );
 
 //------------------------------------------------------------------------------------
@@ -174,7 +203,8 @@ public:
 	tDirStatus		RemoveReference		( UInt32 inRef, eRefType inRefType, mach_port_t inMachPort, int inSocket );
 	void			RemoveReference		( UInt32 inRef );
 	
-	tDirStatus		VerifyReference		( UInt32 inRef, eRefType inRefType, CServerPlugin **outPlugin, mach_port_t inMachPort, int inSocket );
+	tDirStatus		VerifyReference		( UInt32 inRef, eRefType inRefType, CServerPlugin **outPlugin, mach_port_t inMachPort, int inSocket, 
+										  char **outNodeName = NULL );
 
 	char *			CopyNodeRefName		( tDirNodeReference inDirNodeRef );
 	tDirStatus		SetNodePluginPtr	( tDirNodeReference inNodeRef, CServerPlugin *inPlugin );
@@ -194,17 +224,28 @@ public:
 private:
 	sRefEntry		*GetRefEntry		( UInt32 inRef );
 	static void		RemoveReference		( void *inContext );
+	void			ReleaseReference	( UInt32 inRef );
+	
+	sRefSlot		*GetRefSlot			( UInt32 inRef );
+	tDirStatus		VerifyRefOwner		( UInt32 inRef, sClientEntry *inClient, mach_port_t inMachPort, int inSocket );
+	UInt32			AllocateRefSlot		( void );
+	void			FreeRefSlot			( UInt32 inIndex );
+	
+	void			LinkPluginRef		( sRefEntry *inEntry );
+	void			UnlinkPluginRef		( sRefEntry *inEntry );
 
 private:
 	RefDeallocateProc		*fDeallocProc;
 	
 	tMachPortToClientEntry	fMachPortToClientEntry;
 	tPortToClientEntry		fPortToClientEntry;
+	tPluginToRefList		fPluginRefs;	// references by plugin, not retained by the list
 	
-	tRefToEntry				fRefToEntry;
-	tRefToClientEntry		fRefToClientEntry;
-	
-	uint16_t				fNextIndex;	// this is the circular ref value
+	sRefSlot				*fRefSlabs[kMaxRefSlabs];
+	UInt32					fNumRefSlots;	// slots handed out from the slabs so far
+	UInt32					fNumRefs;		// slots currently in use
+	UInt32					fFreeHead;
+	UInt32					fFreeTail;
 	
 	dispatch_queue_t		fQueue;
 };
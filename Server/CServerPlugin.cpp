@@ -383,6 +383,7 @@ CServerPlugin::CServerPlugin ( void ) : mInstance( NULL )
 	SvrLibFtbl stTemp	= _Callbacks;
 	fPlugInSignature	= 0;
 	fPlugInName			= nil;
+	fPlugInHandle		= kInvalidPlugInHandle;
 }
 
 // ----------------------------------------------------------------------------
@@ -396,6 +397,7 @@ CServerPlugin::CServerPlugin ( FourCharCode inSig, const char *inName ) : mInsta
     
 	fPlugInSignature	= inSig;
 	fPlugInName			= nil;
+	fPlugInHandle		= kInvalidPlugInHandle;
 	if ( inName != nil )
 	{
 		fPlugInName = strdup(inName);
@@ -421,6 +423,7 @@ CServerPlugin::CServerPlugin ( CFPlugInRef		inThis,
 	fPlugInRef	= inThis;
 	fPlugInVers	= inVers; //never used anywhere
 	fPlugInName	= nil;
+	fPlugInHandle = kInvalidPlugInHandle;
 	
 	spUnknown = (IUnknownVTbl *)::CFPlugInInstanceCreate( kCFAllocatorDefault,
 														  inFactoryID,
@@ -965,6 +968,25 @@ char* CServerPlugin::GetPluginName ( void )
 }  // GetPluginName
 
 
+// ----------------------------------------------------------------------------
+//	* GetPlugInHandle()
+//
+//		Resolved from the plug-in list on first use and kept, a handle never
+//		changes once it is assigned.  Stays kInvalidPlugInHandle for plug-ins
+//		that have no handle, callers then have to go by name.
+// ----------------------------------------------------------------------------
+
+SInt32 CServerPlugin::GetPlugInHandle ( void )
+{
+	if ( fPlugInHandle == kInvalidPlugInHandle && gPlugins != nil )
+	{
+		fPlugInHandle = gPlugins->GetPlugInHandle( fPlugInName );
+	}
+	
+	return( fPlugInHandle );
+}  // GetPlugInHandle
+
+
 // ----------------------------------------------------------------------------
 //	* GetSignature()
 //
@@ -74,6 +74,7 @@ public:
 	virtual SInt32	Shutdown		( void );
 
 	char*			GetPluginName	( void );
+	SInt32			GetPlugInHandle	( void );
 	FourCharCode	GetSignature	( void );
 	static SInt32	_RegisterNode	( const UInt32, tDataList *, eDirNodeType );
 	static SInt32	InternalRegisterNode ( const UInt32 inToken, tDataList *inNodeList, eDirNodeType inNodeType, bool isProxyRegistration = false );
@@ -82,6 +83,7 @@ public:
 protected:
 	FourCharCode	fPlugInSignature;
 	char		   *fPlugInName;
+	SInt32			fPlugInHandle;
 
 private:
 	// Instance data
@@ -35,6 +35,16 @@
 #include <stdlib.h>
 #include <stddef.h>		// for offsetof()
 #include <unistd.h>		// for sleep()
+#include <libkern/OSAtomic.h>
+
+// message blocks are pooled by data size, powers of two from kMsgBlockSize up to 1MB
+#define kMsgPoolClasses			9
+#define kMsgPoolMaxPerClass		8
+
+static OSQueueHead	gMsgPool[kMsgPoolClasses]		= { OS_ATOMIC_QUEUE_INIT, OS_ATOMIC_QUEUE_INIT, OS_ATOMIC_QUEUE_INIT,
+														OS_ATOMIC_QUEUE_INIT, OS_ATOMIC_QUEUE_INIT, OS_ATOMIC_QUEUE_INIT,
+														OS_ATOMIC_QUEUE_INIT, OS_ATOMIC_QUEUE_INIT, OS_ATOMIC_QUEUE_INIT };
+static int32_t		gMsgPoolCount[kMsgPoolClasses]	= { 0 };
 
 
 //------------------------------------------------------------------------------------
@@ -427,6 +437,7 @@ SInt32 CSrvrMessaging::Get_tDataList_FromMsg ( sComData *inMsg, tDataList **outL
 						
 						pOutList->fDataNodeCount++;
 					}
+					::dsSetListTailPriv( pOutList, (tDataNodePtr) pCurNodeData );
 					*outList = pOutList;
 				}
 				else
@@ -586,40 +597,7 @@ SInt32 CSrvrMessaging::Get_tRecordEntry_FromMsg ( sComData *inMsg, tRecordEntry
 
 SInt32 CSrvrMessaging::GetEmptyObj ( sComData *inMsg, eValueType inType, sObject **outObj )
 {
-	SInt32		siResult	= eDSIndexNotFound;
-	UInt32		i;
-
-	for ( i = 0; i < 10; i++ )
-	{
-		if ( inMsg->obj[ i ].type == 0 )
-		{
-			*outObj = &inMsg->obj[ i ];
-			if ( i == 0 )
-			{
-				//offset was incorrect ie. missing 2 more UInt32 fixed below ie. now 3*
-				// but should really use offsetof here since it is a fixed size object
-				(*outObj)->offset = offsetof(struct sComData, data);
-				//(*outObj)->offset = sizeof( mach_msg_header_t ) +
-				//					sizeof( mach_msg_type_t ) +
-				//					3*sizeof( UInt32 ) +
-				//				   (sizeof( sObject ) * 10);
-			}
-			else
-			{
-				(*outObj)->offset = inMsg->obj[ i - 1 ].offset + inMsg->obj[ i - 1 ].length;
-			}
-			siResult = eDSNoErr;
-			break;
-		}
-		else if ( inMsg->obj[ i ].type == (UInt32)inType )
-		{
-			//siResult = kDupInList;
-			break;
-		}
-	}
-
-	return( siResult );
-
+	return( dsGetEmptyMsgObjPriv(inMsg, inType, outObj) );
 } // GetEmptyObj
 
 
@@ -629,21 +607,7 @@ SInt32 CSrvrMessaging::GetEmptyObj ( sComData *inMsg, eValueType inType, sObject
 
 SInt32 CSrvrMessaging::GetThisObj ( sComData *inMsg, eValueType inType, sObject **outObj )
 {
-	SInt32		siResult	= eDSIndexNotFound;
-	UInt32		i;
-
-	for ( i = 0; i < 10; i++ )
-	{
-		if ( inMsg->obj[ i ].type == (UInt32)inType )
-		{
-			*outObj = &inMsg->obj[ i ];
-			siResult = eDSNoErr;
-			break;
-		}
-	}
-
-	return( siResult );
-
+	return( dsGetMsgObjPriv(inMsg, inType, outObj) );
 } // GetThisObj
 
 
@@ -656,7 +620,9 @@ void CSrvrMessaging::ClearDataBlock ( sComData *inMsg )
 	if ( inMsg != nil )
 	{
 		::memset( inMsg->obj, 0, (sizeof( sObject ) * 10 ) );
-		::memset( inMsg->data, 0, inMsg->fDataSize );
+		
+		// only the used part of the block can hold anything, no need to touch the rest
+		::memset( inMsg->data, 0, (inMsg->fDataLength < inMsg->fDataSize ? inMsg->fDataLength : inMsg->fDataSize) );
 		inMsg->fDataLength	= 0;
 	}
 } // ClearDataBlock
@@ -692,25 +658,26 @@ void CSrvrMessaging::Grow ( sComData **inMsg, UInt32 inOffset, UInt32 inSize )
 	// Do we need a bigger object
 	if ( ((*inMsg)->fDataLength + inSize) > (*inMsg)->fDataSize )
 	{
-		newSize = (*inMsg)->fDataSize;
-		//idea is to make the newSize a multiple of kMsgBlockSize
+		// double the size so building a large reply doesn't copy the block over and over
+		newSize = ((*inMsg)->fDataSize > kMsgBlockSize ? (*inMsg)->fDataSize : kMsgBlockSize);
 		while( newSize < ((*inMsg)->fDataLength + inSize) )
 		{
-			newSize += kMsgBlockSize;
+			newSize *= 2;
 		}
 
 		// Create the new pointer
-		pNewPtr = (sComData *)::calloc( 1, sizeof( sComData ) + newSize );
+		pNewPtr = AllocMessageBlock( newSize );
 		if ( pNewPtr == nil )
 		{
 			throw( (SInt32)eMemoryAllocError );
 		}
+		newSize = pNewPtr->fDataSize;
 
 		// Copy the old data to the new destination
 		::memcpy( pNewPtr, (*inMsg), sizeof( sComData ) + (*inMsg)->fDataLength );
 
 		// Dump the old data block
-		::free( (*inMsg) );
+		FreeMessageBlock( (*inMsg) );
 		(*inMsg) = nil;
 
 		// Assign the new data block
@@ -723,4 +690,98 @@ void CSrvrMessaging::Grow ( sComData **inMsg, UInt32 inOffset, UInt32 inSize )
 } // Grow
 
 
+//------------------------------------------------------------------------------------
+//	* GetPoolClass
+//------------------------------------------------------------------------------------
+
+static int GetPoolClass ( UInt32 inDataSize, bool inExact )
+{
+	UInt32	classSize	= kMsgBlockSize;
+	
+	for ( int ii = 0; ii < kMsgPoolClasses; ii++, classSize <<= 1 )
+	{
+		if ( inExact ? (inDataSize == classSize) : (inDataSize <= classSize) )
+		{
+			return ii;
+		}
+	}
+	
+	return -1;
+} // GetPoolClass
+
+
+//------------------------------------------------------------------------------------
+//	* AllocMessageBlock
+//
+//	Returns a block with at least inDataSize bytes of data, the header is cleared and
+//	fDataSize is set to the real size.  Only the header of a pooled block is cleared,
+//	the data area is only meaningful up to fDataLength.
+//------------------------------------------------------------------------------------
+
+sComData* CSrvrMessaging::AllocMessageBlock ( UInt32 inDataSize )
+{
+	sComData	   *pMsg		= nil;
+	int				poolClass	= GetPoolClass( inDataSize, false );
+	
+	if ( poolClass != -1 )
+	{
+		inDataSize = (kMsgBlockSize << poolClass);
+		
+		pMsg = (sComData *) OSAtomicDequeue( &gMsgPool[poolClass], 0 );
+		if ( pMsg != nil )
+		{
+			OSAtomicDecrement32( &gMsgPoolCount[poolClass] );
+			::memset( pMsg, 0, sizeof( sComData ) );
+		}
+	}
+	
+	if ( pMsg == nil )
+	{
+		pMsg = (sComData *)::calloc( 1, sizeof( sComData ) + inDataSize );
+		if ( pMsg == nil )
+		{
+			return( nil );
+		}
+	}
+	
+	pMsg->fDataSize		= inDataSize;
+	pMsg->fDataLength	= 0;
+	
+	return( pMsg );
+} // AllocMessageBlock
+
+
+//------------------------------------------------------------------------------------
+//	* FreeMessageBlock
+//------------------------------------------------------------------------------------
+
+void CSrvrMessaging::FreeMessageBlock ( sComData *inMsg )
+{
+	int		poolClass	= -1;
+	
+	if ( inMsg == nil )
+	{
+		return;
+	}
+	
+	poolClass = GetPoolClass( inMsg->fDataSize, true );
+	if ( poolClass != -1 && OSAtomicIncrement32(&gMsgPoolCount[poolClass]) <= kMsgPoolMaxPerClass )
+	{
+		// don't let request data linger in the pool, clear what was used
+		::memset( inMsg->data, 0, (inMsg->fDataLength < inMsg->fDataSize ? inMsg->fDataLength : inMsg->fDataSize) );
+		
+		// the link overwrites the start of the header, it is cleared again when handed out
+		OSAtomicEnqueue( &gMsgPool[poolClass], inMsg, 0 );
+		return;
+	}
+	
+	if ( poolClass != -1 )
+	{
+		OSAtomicDecrement32( &gMsgPoolCount[poolClass] );
+	}
+	
+	::free( inMsg );
+} // FreeMessageBlock
+
+
 
@@ -57,6 +57,9 @@ virtual		   ~CSrvrMessaging				( void );
 		void	ClearMessageBlock			( sComData *inMsg );
 		void	Grow						( sComData **inMsg, UInt32 inOffset, UInt32 inSize );
 		
+static	sComData*	AllocMessageBlock		( UInt32 inDataSize );
+static	void	FreeMessageBlock			( sComData *inMsg );
+		
 private:
 		SInt32	GetEmptyObj					( sComData *inMsg, eValueType inType, sObject **outObj );
 		SInt32	GetThisObj					( sComData *inMsg, eValueType inType, sObject **outObj );
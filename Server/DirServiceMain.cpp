@@ -118,6 +118,7 @@ extern "C" void _si_disable_opendirectory(void);
 
 #ifndef DISABLE_LOCAL_PLUGIN
 	extern CDSLocalPlugin	*gLocalNode;
+	extern void				ShadowHashCacheFlush( void );
 #endif
 
 const char *gStrDaemonBuildVersion = PROJECT_SOURCE_VERSION;
@@ -444,6 +445,9 @@ int main ( int argc, char * const *argv )
 		
 		// Open the log files
 		CLog::Initialize(kLogNone, kLogNone, debugOpts, profileOpts, gDebugLogging, bProfiling, gDSLocalOnlyMode, od_passthru_log_message);
+		
+		// keep logging off the request threads, the ring drains into opendirectoryd
+		CLog::SetAsyncPassthru(od_passthru_log_capture, od_passthru_log_send);
 
 		SrvrLog( kLogApplication, "\n\n" );
 		SrvrLog(kLogApplication, "dspluginhelperd (build %s) starting up...", gStrDaemonBuildVersion);
@@ -582,6 +586,7 @@ int main ( int argc, char * const *argv )
 		
 #ifndef DISABLE_LOCAL_PLUGIN
 		gLocalNode->CloseDatabases();
+		ShadowHashCacheFlush();
 #endif
 		
 		if ( gSrvrCntl != NULL )
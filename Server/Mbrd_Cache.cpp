@@ -30,10 +30,25 @@
 #include <fcntl.h>
 #include <uuid/uuid.h>
 #include <DirectoryServiceCore/CLog.h>
+#include <DirectoryServiceCore/DSMutexSemaphore.h>
 #include <membership.h>
 
 extern CPlugInList		   *gPlugins;
 
+#define kNodeHashBuckets	64
+
+// node names are interned so availability changes only walk the entries of that node
+typedef struct MbrdCacheNode
+{
+	struct MbrdCacheNode	*fHashLink;
+	char					*fNodeName;		// full node name, as stored in fNode
+	char					*fPluginName;	// first component of the node name, used for data stamps
+	SInt32					fPluginHandle;	// resolved once, kInvalidPlugInHandle if the plugin wasn't known yet
+	uint32_t				fHashValue;
+	int32_t					fNumEntries;
+	UserGroup				*fEntries;		// linked through fNodeLink
+} MbrdCacheNode;
+
 struct _MbrdCache
 {
 	int32_t					fRefCount;
@@ -46,10 +61,13 @@ struct _MbrdCache
 	int32_t					fKerberosFallback;
 	
 	pthread_mutex_t			fCacheLock;	// used to update cache
+	DSLockStats				*fCacheLockStats;
 	
 	UserGroup				*fListHead;
 	UserGroup				*fListTail;
 	
+	MbrdCacheNode			*fNodeHash[kNodeHashBuckets];
+	
 	struct HashTable		fGUIDHash;
 	struct HashTable		fSIDHash;
 	struct HashTable		fUIDHash;
@@ -90,18 +108,15 @@ static bool ItemOutdated( UserGroup* item, int flags )
 	if ( item->fNodeAvailable == false )
 		return false;
 	
-	if ( item->fNode != NULL )
+	// if we have a token and we can validate the stamp use it
+	if ( item->fCacheNode != NULL )
 	{
 		uint32_t	iToken	= 0;
-		char		tempNode[512];	// should never exceed
-		
-		strlcpy( tempNode, item->fNode, sizeof(tempNode) );
-		
-		// if we have a token and we can validate the stamp use it
-		char *nodeName = strtok( tempNode, "/" );
 		
-		if ( nodeName != NULL )
-			iToken = gPlugins->GetValidDataStamp( nodeName );
+		if ( item->fCacheNode->fPluginHandle != CPlugInList::kInvalidPlugInHandle )
+			iToken = gPlugins->GetValidDataStampForHandle( item->fCacheNode->fPluginHandle );
+		else if ( item->fCacheNode->fPluginName != NULL )
+			iToken = gPlugins->GetValidDataStamp( item->fCacheNode->fPluginName );
 		
 		if ( iToken != item->fToken )
 			return true;
@@ -113,8 +128,82 @@ static bool ItemOutdated( UserGroup* item, int flags )
 	return (item->fExpiration <= GetElapsedSeconds());
 }
 
+static MbrdCacheNode *MbrdCache_FindNode( MbrdCache *cache, const char *nodeName, bool bCreate )
+{
+	uint32_t		hashval	= DSHashString( nodeName );
+	MbrdCacheNode	**bucket	= &cache->fNodeHash[hashval % kNodeHashBuckets];
+	MbrdCacheNode	*node;
+	
+	for ( node = (*bucket); node != NULL; node = node->fHashLink ) {
+		if ( node->fHashValue == hashval && strcmp(node->fNodeName, nodeName) == 0 )
+			return node;
+	}
+	
+	if ( bCreate == false )
+		return NULL;
+	
+	// nodes are kept until the cache goes away, there are only ever a handful of them
+	node = (MbrdCacheNode *) calloc( 1, sizeof(MbrdCacheNode) );
+	assert( node != NULL );
+	
+	node->fNodeName = strdup( nodeName );
+	node->fHashValue = hashval;
+	
+	char *tempNode = strdup( nodeName );
+	char *pluginName = strtok( tempNode, "/" );
+	if ( pluginName != NULL )
+		node->fPluginName = strdup( pluginName );
+	DSFree( tempNode );
+	
+	node->fPluginHandle = gPlugins->GetPlugInHandle( node->fPluginName );
+	
+	node->fHashLink = (*bucket);
+	(*bucket) = node;
+	
+	return node;
+}
+
+static void MbrdCache_AddToNode( MbrdCache *cache, UserGroup *ug )
+{
+	if ( ug->fNode == NULL )
+		return;
+	
+	MbrdCacheNode *node = MbrdCache_FindNode( cache, ug->fNode, true );
+	
+	ug->fCacheNode = node;
+	ug->fNodeBackLink = NULL;
+	ug->fNodeLink = node->fEntries;
+	if ( node->fEntries != NULL )
+		node->fEntries->fNodeBackLink = ug;
+	node->fEntries = ug;
+	node->fNumEntries++;
+}
+
+static void MbrdCache_RemoveFromNode( MbrdCache *cache, UserGroup *ug )
+{
+	MbrdCacheNode *node = ug->fCacheNode;
+	
+	if ( node == NULL )
+		return;
+	
+	if ( ug->fNodeLink != NULL )
+		ug->fNodeLink->fNodeBackLink = ug->fNodeBackLink;
+	
+	if ( ug->fNodeBackLink == NULL )
+		node->fEntries = ug->fNodeLink;
+	else
+		ug->fNodeBackLink->fNodeLink = ug->fNodeLink;
+	
+	node->fNumEntries--;
+	ug->fCacheNode = NULL;
+	ug->fNodeLink = NULL;
+	ug->fNodeBackLink = NULL;
+}
+
 static void MbrdCache_RemoveFromList( MbrdCache *cache, UserGroup* ug )
 {
+	MbrdCache_RemoveFromNode( cache, ug );
+	
 	if ( ug->fLink == NULL )
 		cache->fListTail = ug->fBackLink;
 	else
@@ -145,6 +234,8 @@ static void MbrdCache_AddToHeadOfList( MbrdCache *cache, UserGroup* ug )
 		cache->fListHead->fBackLink = ug;
 		cache->fListHead = ug;
 	}
+	
+	MbrdCache_AddToNode( cache, ug );
 
 	__sync_add_and_fetch( &cache->fNumItems, 1 );
 }
@@ -291,7 +382,9 @@ static UserGroup *MbrdCache_UpdateExistingRecord( MbrdCache *cache, UserGroup *e
 		char	buffer[128]	= { 0, };
 
 		MbrdCache_RemoveFromHashes( cache, existing ); // remove from hashes
+		MbrdCache_RemoveFromNode( cache, existing );
 		UserGroup_Merge( existing, source, false );
+		MbrdCache_AddToNode( cache, existing );
 		MbrdCache_AddToHashes( cache, existing ); // add back to hashes after update
 
 		if ( source->fFoundBy & kUGFoundByNestedGroup ) {
@@ -337,6 +430,7 @@ MbrdCache *MbrdCache_Create( int32_t defaultExpiration, int32_t defaultNegativeE
 	assert( pthread_mutexattr_init(&attr) == 0);
 	assert( pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK) == 0);
 	assert( pthread_mutex_init(&cache->fCacheLock, &attr) == 0);
+	cache->fCacheLockStats = new DSLockStats( "MbrdCache::fCacheLock" );
 	
 	pthread_mutexattr_destroy( &attr );
 	
@@ -359,6 +453,7 @@ void MbrdCache_Release( MbrdCache *cache )
 {
 	if ( dsReleaseObject(cache, &cache->fRefCount, false) == true ) {
 		pthread_mutex_destroy( &cache->fCacheLock );
+		delete cache->fCacheLockStats;
 		
 		HashTable_FreeContents( &cache->fGUIDHash );
 		HashTable_FreeContents( &cache->fSIDHash );
@@ -372,6 +467,19 @@ void MbrdCache_Release( MbrdCache *cache )
 		HashTable_FreeContents( &cache->fKerberosHash );
 		HashTable_FreeContents( &cache->fX509Hash );
 		
+		for ( int ii = 0; ii < kNodeHashBuckets; ii++ ) {
+			MbrdCacheNode *node = cache->fNodeHash[ii];
+			
+			while ( node != NULL ) {
+				MbrdCacheNode *delNode = node;
+				
+				node = node->fHashLink;
+				DSFree( delNode->fNodeName );
+				DSFree( delNode->fPluginName );
+				DSFree( delNode );
+			}
+		}
+		
 		free( cache );
 		cache = NULL;
 	}
@@ -521,7 +629,7 @@ UserGroup *MbrdCache_AddOrUpdate( MbrdCache *cache, UserGroup *entry, uint32_t f
 	UserGroup *result = NULL;
 
 	// need to hold the lock until we add, otherwise we run into race condition
-	int rc = pthread_mutex_lock( &cache->fCacheLock );
+	int rc = cache->fCacheLockStats->Lock( &cache->fCacheLock );
 	assert( rc == 0 );
 	
 	// all entries should always have a GUID, so always use that hash
@@ -598,7 +706,7 @@ UserGroup *MbrdCache_AddOrUpdate( MbrdCache *cache, UserGroup *entry, uint32_t f
 		result = entry;
 	}
 	
-	rc = pthread_mutex_unlock( &cache->fCacheLock );
+	rc = cache->fCacheLockStats->Unlock( &cache->fCacheLock );
 	assert( rc == 0 );
 	
 	return result;
@@ -607,13 +715,13 @@ UserGroup *MbrdCache_AddOrUpdate( MbrdCache *cache, UserGroup *entry, uint32_t f
 void MbrdCache_RefreshHashes( MbrdCache *cache, UserGroup *existing )
 {
 	// need to hold the lock until we add, otherwise we run into race condition
-	int rc = pthread_mutex_lock( &cache->fCacheLock );
+	int rc = cache->fCacheLockStats->Lock( &cache->fCacheLock );
 	assert( rc == 0 );
 	
 	MbrdCache_RemoveFromHashes( cache, existing ); // remove from hashes
 	MbrdCache_AddToHashes( cache, existing ); // add back to hashes
 	
-	rc = pthread_mutex_unlock( &cache->fCacheLock );
+	rc = cache->fCacheLockStats->Unlock( &cache->fCacheLock );
 	assert( rc == 0 );
 }
 
@@ -623,20 +731,20 @@ int MbrdCache_SetNodeAvailability( MbrdCache *cache, const char *nodeName, bool
 	
 	if ( cache == NULL ) return 0;
 	
-	assert( pthread_mutex_lock(&cache->fCacheLock) == 0);
+	assert( cache->fCacheLockStats->Lock(&cache->fCacheLock) == 0);
 	
-	UserGroup* temp = cache->fListHead;
+	MbrdCacheNode *node = MbrdCache_FindNode( cache, nodeName, false );
+	UserGroup* temp = (node != NULL ? node->fEntries : NULL);
 	while ( temp != NULL )
 	{
-		// TODO: some hash code for the name and store the hash would speed this dramatically
-		if ( temp->fNodeAvailable != nodeAvailable && temp->fNode != NULL && strcmp(nodeName, temp->fNode) == 0 ) {
+		if ( temp->fNodeAvailable != nodeAvailable ) {
 			__sync_bool_compare_and_swap( &temp->fNodeAvailable, temp->fNodeAvailable, nodeAvailable );
 			iCount++;
 		}
-		temp = temp->fLink;
+		temp = temp->fNodeLink;
 	}
 	
-	assert( pthread_mutex_unlock(&cache->fCacheLock) == 0);
+	assert( cache->fCacheLockStats->Unlock(&cache->fCacheLock) == 0);
 	
 	return iCount;
 }
@@ -645,7 +753,7 @@ void MbrdCache_Sweep( MbrdCache *cache )
 {
 	if ( cache == NULL ) return;
 
-	assert( pthread_mutex_lock(&cache->fCacheLock) == 0 );
+	assert( cache->fCacheLockStats->Lock(&cache->fCacheLock) == 0 );
 	
 	UserGroup* temp = cache->fListHead;
 	while ( temp != NULL )
@@ -658,7 +766,7 @@ void MbrdCache_Sweep( MbrdCache *cache )
 		}
 	}
 	
-	assert( pthread_mutex_unlock(&cache->fCacheLock) == 0 );
+	assert( cache->fCacheLockStats->Unlock(&cache->fCacheLock) == 0 );
 }
 
 void MbrdCache_NodeChangeOccurred( MbrdCache *cache )
@@ -667,7 +775,7 @@ void MbrdCache_NodeChangeOccurred( MbrdCache *cache )
 	
 	uint32_t currentTime = GetElapsedSeconds();
 	
-	assert( pthread_mutex_lock(&cache->fCacheLock) == 0);
+	assert( cache->fCacheLockStats->Lock(&cache->fCacheLock) == 0);
 	
 	UserGroup* temp = cache->fListHead;
 	while ( temp != NULL ) {
@@ -683,14 +791,14 @@ void MbrdCache_NodeChangeOccurred( MbrdCache *cache )
 		}
 	}
 	
-	assert( pthread_mutex_unlock(&cache->fCacheLock) == 0 );
+	assert( cache->fCacheLockStats->Unlock(&cache->fCacheLock) == 0 );
 }
 
 void MbrdCache_ResetCache( MbrdCache *cache )
 {
 	if ( cache == NULL ) return;
 
-	assert( pthread_mutex_lock(&cache->fCacheLock) == 0);
+	assert( cache->fCacheLockStats->Lock(&cache->fCacheLock) == 0);
 		
 	HashTable_Reset( &cache->fGUIDHash );
 	HashTable_Reset( &cache->fSIDHash );
@@ -705,7 +813,11 @@ void MbrdCache_ResetCache( MbrdCache *cache )
 	UserGroup* temp = cache->fListHead;
 	cache->fListHead = NULL;
 	cache->fListTail = NULL;
-	assert( pthread_mutex_unlock(&cache->fCacheLock) == 0 );
+	
+	for ( UserGroup *ug = temp; ug != NULL; ug = ug->fLink ) {
+		MbrdCache_RemoveFromNode( cache, ug );
+	}
+	assert( cache->fCacheLockStats->Unlock(&cache->fCacheLock) == 0 );
 	
 	while (temp != NULL)
 	{
@@ -765,7 +877,7 @@ void MbrdCache_DumpState( MbrdCache *cache )
 		return;
 	}
 	
-	assert( pthread_mutex_lock(&cache->fCacheLock) == 0 );
+	assert( cache->fCacheLockStats->Lock(&cache->fCacheLock) == 0 );
 	
 	fprintf( dumpFile, "Global UID count: %ld\n", cache->fUIDHash.fNumEntries );
 	fprintf( dumpFile, "Global GID count: %ld\n", cache->fGIDHash.fNumEntries );
@@ -778,6 +890,13 @@ void MbrdCache_DumpState( MbrdCache *cache )
 	fprintf( dumpFile, "Global Kerberos count: %ld\n", cache->fKerberosHash.fNumEntries );
 	fprintf( dumpFile, "Global X509DN count: %ld\n\n", cache->fX509Hash.fNumEntries );
 	
+	for ( ii = 0; ii < kNodeHashBuckets; ii++ ) {
+		for ( MbrdCacheNode *node = cache->fNodeHash[ii]; node != NULL; node = node->fHashLink ) {
+			fprintf( dumpFile, "Node '%s' count: %d\n", node->fNodeName, node->fNumEntries );
+		}
+	}
+	fprintf( dumpFile, "\n" );
+	
 	UserGroup* temp = cache->fListHead;
 	while (temp != NULL)
 	{
@@ -855,7 +974,7 @@ void MbrdCache_DumpState( MbrdCache *cache )
 		temp = temp->fLink;
 	}
 	
-	assert( pthread_mutex_unlock(&cache->fCacheLock) == 0 );
+	assert( cache->fCacheLockStats->Unlock(&cache->fCacheLock) == 0 );
 	
 	fclose( dumpFile );
 }
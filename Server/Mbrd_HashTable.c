@@ -26,122 +26,315 @@
 #include "Mbrd_UserGroup.h"
 #include <strings.h>
 #include <DirectoryServiceCore/CLog.h>
+#include <DirectoryServiceCore/PrivateTypes.h>
 #include <uuid/uuid.h>
 #include <syslog.h>
 #include <membershipPriv.h>
+#include <sched.h>
+
+#define kHashInitialBuckets		16
+#define kHashRetireBatch		64
+
+// we have to use external struct because UserGroup records can be part of multiple hashes
+// the key is copied into the node so readers never touch UserGroup fields that a merge may free
+struct ug_hash_node {
+	struct ug_hash_node * volatile	next;
+	struct ug_hash_node		*retireLink;
+	struct UserGroup		*ug;
+	long					index;	// index from keyoffset
+	uint32_t				hashval;
+	bool					moved;	// copied into a larger table, the copy owns the key and the retain
+	union {
+		id_t				id;
+		uuid_t				guid;
+		ntsid_t				sid;
+		char				*string;
+	} key;
+};
 
-// we have to use external struct because UserGroup records can be part of multiple rbtrees
-struct ug_rb_node {
-	struct rb_node		rbn;
-	long				index;	// index from keyoffset
-	struct UserGroup	*ug;
+struct ug_hash_buckets {
+	struct ug_hash_buckets			*retireLink;
+	uint32_t						fMask;
+	struct ug_hash_node * volatile	fBucket[];
 };
 
 extern void ConvertSIDToString( char* string, ntsid_t* sid );
 
-#define RBNODE_TO_USERGROUP(n)			(((struct ug_rb_node *) n)->ug)
 #define USERGROUP_TO_KEY(ug,keyoff)		((void *) (((uintptr_t) ug) + keyoff))
 
-static int rbt_compare_id_nodes( const struct rb_node *n1, const struct rb_node *n2 )
+static const void *__HashTable_ItemKey( HashTable *hash, UserGroup *item, long index )
 {
-	const id_t id1 = RBNODE_TO_USERGROUP(n1)->fID;
-	const id_t id2 = RBNODE_TO_USERGROUP(n2)->fID;
+	void *key = USERGROUP_TO_KEY( item, hash->fKeyOffset );
+	
+	switch ( hash->fHashType )
+	{
+		case eNameHash:
+			return ((void **) key)[0];
+			
+		case eKerberosHash:
+		case eX509DNHash:
+			// if this is a kerberos hash or X509 hash, then it is really an array
+			return ((void **) key)[index];
+	}
 	
-    if ( id1 < id2 ) {
-        return -1;
-    }
+	return key;
+}
+
+static uint32_t __HashTable_HashKey( HashTable *hash, const void *key )
+{
+	switch ( hash->fHashType )
+	{
+		case eIDHash:
+			return DSHashBytes( key, sizeof(id_t) );
+			
+		case eGUIDHash:
+			return DSHashBytes( key, sizeof(uuid_t) );
+			
+		case eSIDHash:
+			return DSHashBytes( key, sizeof(ntsid_t) );
+	}
 	
-    if ( id1 > id2 ) {
-        return 1;
-    }
-    return 0;
+	return DSHashString( (const char *) key );
 }
 
-static int rbt_compare_id_key( const struct rb_node *n, const void *v )
+static bool __HashTable_NodeMatches( HashTable *hash, struct ug_hash_node *node, uint32_t hashval, const void *key )
 {
-	const id_t id1 = RBNODE_TO_USERGROUP(n)->fID;
-	const id_t id2 = *((id_t *) v);
+	if ( node->hashval != hashval ) {
+		return false;
+	}
 	
-    if ( id1 < id2 ) {
-        return -1;
-    }
+	switch ( hash->fHashType )
+	{
+		case eIDHash:
+			return (node->key.id == *((id_t *) key));
+			
+		case eGUIDHash:
+			return (uuid_compare(node->key.guid, key) == 0);
+			
+		case eSIDHash:
+			return (bcmp(&node->key.sid, key, sizeof(ntsid_t)) == 0);
+	}
 	
-    if ( id1 > id2 ) {
-        return 1;
-    }
-    return 0;
+	return (strcmp(node->key.string, (const char *) key) == 0);
 }
 
-static int rbt_compare_name_nodes( const struct rb_node *n1, const struct rb_node *n2 )
+static struct ug_hash_node *__HashTable_FindNode( HashTable *hash, struct ug_hash_buckets *buckets, const void *key )
 {
-	const char *name1 = RBNODE_TO_USERGROUP(n1)->fName;
-	const char *name2 = RBNODE_TO_USERGROUP(n2)->fName;
+	if ( buckets == NULL || key == NULL ) {
+		return NULL;
+	}
+	
+	uint32_t hashval = __HashTable_HashKey( hash, key );
+	struct ug_hash_node *node;
 	
-	assert(name1);
-	assert(name2);
-	return strcmp( name1, name2 );
+	for ( node = buckets->fBucket[hashval & buckets->fMask]; node != NULL; node = node->next ) {
+		if ( __HashTable_NodeMatches(hash, node, hashval, key) == true ) {
+			return node;
+		}
+	}
+	
+	return NULL;
 }
 
-static int rbt_compare_name_key( const struct rb_node *n, const void *v )
+static struct ug_hash_node *__HashTable_CreateNode( HashTable *hash, UserGroup *item, long index, const void *key )
 {
-	const char *name1 = RBNODE_TO_USERGROUP(n)->fName;
-	const char *name2 = (const char *) v;
+	struct ug_hash_node *node = (struct ug_hash_node *) calloc( 1, sizeof(struct ug_hash_node) );
+	assert( node != NULL );
+	
+	node->ug = item;
+	node->index = index;
+	node->hashval = __HashTable_HashKey( hash, key );
 	
-	assert(name1);
-	assert(name2);
-	return strcmp( name1, name2 );
+	switch ( hash->fHashType )
+	{
+		case eIDHash:
+			node->key.id = *((id_t *) key);
+			break;
+			
+		case eGUIDHash:
+			uuid_copy( node->key.guid, key );
+			break;
+			
+		case eSIDHash:
+			bcopy( key, &node->key.sid, sizeof(ntsid_t) );
+			break;
+			
+		default:
+			node->key.string = strdup( (const char *) key );
+			assert( node->key.string != NULL );
+			break;
+	}
+	
+	return node;
 }
 
-static int rbt_compare_guid_nodes( const struct rb_node *n1, const struct rb_node *n2 )
+#pragma mark -
+#pragma mark Epoch based reclamation
+
+// readers register in the current epoch and re-check it so a writer flipping the epoch either sees
+// the reader in its count or the reader sees the new epoch and moves over to it
+static uint32_t __HashTable_ReadBegin( HashTable *hash )
 {
-	return uuid_compare( RBNODE_TO_USERGROUP(n1)->fGUID, RBNODE_TO_USERGROUP(n2)->fGUID );
+	uint32_t epoch;
+	
+	do
+	{
+		epoch = (hash->fEpoch & 1);
+		__sync_add_and_fetch( &hash->fReaders[epoch], 1 );
+		if ( (hash->fEpoch & 1) == epoch ) {
+			break;
+		}
+		
+		__sync_sub_and_fetch( &hash->fReaders[epoch], 1 );
+	} while ( 1 );
+	
+	return epoch;
 }
 
-static int rbt_compare_guid_key( const struct rb_node *n, const void *v )
+static void __HashTable_ReadEnd( HashTable *hash, uint32_t epoch )
 {
-	return uuid_compare( RBNODE_TO_USERGROUP(n)->fGUID, v );
+	__sync_sub_and_fetch( &hash->fReaders[epoch], 1 );
 }
 
-static int rbt_compare_sid_nodes( const struct rb_node *n1, const struct rb_node *n2 )
+static void __HashTable_RetireNode( HashTable *hash, struct ug_hash_node *node )
 {
-	return bcmp( &RBNODE_TO_USERGROUP(n1)->fSID, &RBNODE_TO_USERGROUP(n2)->fSID, sizeof(ntsid_t) );
+	node->retireLink = hash->fRetiredNodes;
+	hash->fRetiredNodes = node;
+	hash->fNumRetired++;
 }
 
-static int rbt_compare_sid_key( const struct rb_node *n, const void *v )
+static void __HashTable_RetireBuckets( HashTable *hash, struct ug_hash_buckets *buckets )
 {
-	return bcmp( &RBNODE_TO_USERGROUP(n)->fSID, v, sizeof(ntsid_t) );
+	buckets->retireLink = hash->fRetiredBuckets;
+	hash->fRetiredBuckets = buckets;
 }
 
-static int rbt_compare_kerberos_nodes( const struct rb_node *n1, const struct rb_node *n2 )
+// must be called on the hash queue
+static void __HashTable_Reclaim( HashTable *hash, bool bWait )
 {
-	const char *kerberos1 = RBNODE_TO_USERGROUP(n1)->fKerberos[((struct ug_rb_node *)n1)->index];
-	const char *kerberos2 = RBNODE_TO_USERGROUP(n2)->fKerberos[((struct ug_rb_node *)n2)->index];
+	if ( hash->fRetiredNodes == NULL && hash->fRetiredBuckets == NULL ) {
+		return;
+	}
+	
+	// don't make the writer wait on readers until we have a batch worth freeing
+	if ( bWait == false && hash->fNumRetired < kHashRetireBatch && (hash->fReaders[0] != 0 || hash->fReaders[1] != 0) ) {
+		return;
+	}
+	
+	uint32_t oldEpoch = (__sync_fetch_and_xor(&hash->fEpoch, 1) & 1);
+	while ( hash->fReaders[oldEpoch] != 0 ) {
+		sched_yield();
+	}
+	
+	struct ug_hash_node *node = hash->fRetiredNodes;
+	struct ug_hash_buckets *buckets = hash->fRetiredBuckets;
+	
+	hash->fRetiredNodes = NULL;
+	hash->fRetiredBuckets = NULL;
+	hash->fNumRetired = 0;
+	
+	while ( node != NULL ) {
+		struct ug_hash_node *delNode = node;
+		
+		node = node->retireLink;
+		if ( delNode->moved == false ) {
+			if ( hash->fHashType == eNameHash || hash->fHashType == eKerberosHash || hash->fHashType == eX509DNHash ) {
+				DSFree( delNode->key.string );
+			}
+			
+			// release it if owner and entry are not the same (don't self release)
+			if ( delNode->ug != hash->fOwner ) {
+				UserGroup_Release( delNode->ug );
+			}
+		}
+		
+		DSFree( delNode );
+	}
 	
-	return strcmp( kerberos1, kerberos2 );
+	while ( buckets != NULL ) {
+		struct ug_hash_buckets *delBuckets = buckets;
+		
+		buckets = buckets->retireLink;
+		DSFree( delBuckets );
+	}
 }
 
-static int rbt_compare_kerberos_key( const struct rb_node *n, const void *v )
+#pragma mark -
+#pragma mark Writer routines (hash queue only)
+
+static struct ug_hash_buckets *__HashTable_Grow( HashTable *hash )
 {
-	const char *kerberos1 = RBNODE_TO_USERGROUP(n)->fKerberos[((struct ug_rb_node *)n)->index];
-	const char *kerberos2 = (const char *) v;
+	struct ug_hash_buckets	*oldBuckets	= hash->fBuckets;
+	uint32_t				numBuckets	= (oldBuckets != NULL ? 2 * (oldBuckets->fMask + 1) : kHashInitialBuckets);
+	
+	struct ug_hash_buckets *newBuckets = (struct ug_hash_buckets *) calloc( 1, sizeof(struct ug_hash_buckets) + 
+																			numBuckets * sizeof(struct ug_hash_node *) );
+	assert( newBuckets != NULL );
+	
+	newBuckets->fMask = numBuckets - 1;
+	
+	// readers may still be walking the old chains, so we build new ones out of copies
+	if ( oldBuckets != NULL ) {
+		for ( uint32_t ii = 0; ii <= oldBuckets->fMask; ii++ ) {
+			struct ug_hash_node *node;
+			
+			for ( node = oldBuckets->fBucket[ii]; node != NULL; node = node->next ) {
+				struct ug_hash_node *copy = (struct ug_hash_node *) malloc( sizeof(struct ug_hash_node) );
+				assert( copy != NULL );
+				
+				bcopy( node, copy, sizeof(struct ug_hash_node) );
+				copy->retireLink = NULL;
+				copy->next = newBuckets->fBucket[copy->hashval & newBuckets->fMask];
+				newBuckets->fBucket[copy->hashval & newBuckets->fMask] = copy;
+				
+				node->moved = true;
+				__HashTable_RetireNode( hash, node );
+			}
+		}
+		
+		__HashTable_RetireBuckets( hash, oldBuckets );
+	}
+	
+	__sync_synchronize();
+	hash->fBuckets = newBuckets;
 	
-	return strcmp( kerberos1, kerberos2 );
+	return newBuckets;
 }
 
-static int rbt_compare_x509dn_nodes( const struct rb_node *n1, const struct rb_node *n2 )
+static void __HashTable_InsertNode( HashTable *hash, struct ug_hash_node *node )
 {
-	const char *x509dn1 = RBNODE_TO_USERGROUP(n1)->fX509DN[((struct ug_rb_node *)n1)->index];
-	const char *x509dn2 = RBNODE_TO_USERGROUP(n2)->fX509DN[((struct ug_rb_node *)n2)->index];
+	struct ug_hash_buckets *buckets = hash->fBuckets;
+	
+	if ( buckets == NULL || hash->fNumEntries >= 2 * (long) (buckets->fMask + 1) ) {
+		buckets = __HashTable_Grow( hash );
+	}
+	
+	struct ug_hash_node * volatile *slot = &buckets->fBucket[node->hashval & buckets->fMask];
+	
+	node->next = (*slot);
 	
-	return strcmp( x509dn1, x509dn2 );
+	// node must be complete before a reader can reach it
+	__sync_synchronize();
+	(*slot) = node;
+	
+	hash->fNumEntries++;
 }
 
-static int rbt_compare_x509dn_key( const struct rb_node *n, const void *v )
+static void __HashTable_UnlinkNode( HashTable *hash, struct ug_hash_node *node )
 {
-	const char *x509dn1 = RBNODE_TO_USERGROUP(n)->fX509DN[((struct ug_rb_node *)n)->index];
-	const char *x509dn2 = (const char *) v;
+	struct ug_hash_buckets *buckets = hash->fBuckets;
+	struct ug_hash_node * volatile *link = &buckets->fBucket[node->hashval & buckets->fMask];
+	
+	while ( (*link) != node ) {
+		assert( (*link) != NULL );
+		link = &(*link)->next;
+	}
 	
-	return strcmp( x509dn1, x509dn2 );
+	// a reader sitting on this node still sees a valid next pointer until it is reclaimed
+	(*link) = node->next;
+	hash->fNumEntries--;
+	
+	__HashTable_RetireNode( hash, node );
 }
 
 static bool __IsReservedGroup( UserGroup *item )
@@ -255,23 +448,16 @@ static bool __HashTable_Add( HashTable* hash, UserGroup* item, bool replaceExist
 
 	do
 	{
-		void *key = USERGROUP_TO_KEY( item, hash->fKeyOffset );
-		if ( hash->fHashType == eKerberosHash || hash->fHashType == eX509DNHash ) {
-			// if this is a kerberos hash or X509 hash, then it is really an array
-			key = ((void **) key)[iIndex];
-			if ( key == NULL ) {
-				goto bail;
-			}
-		} else if (hash->fHashType == eNameHash) {
-			key = ((void **)key)[0];
+		const void *key = __HashTable_ItemKey( hash, item, iIndex );
+		if ( key == NULL ) {
+			goto bail;
 		}
-
 		
 		bool bBuiltin = __IsBuiltinGroup( item );
-		struct rb_node *node = rb_tree_find_node( &hash->fRBtree, key );
+		struct ug_hash_node *node = __HashTable_FindNode( hash, hash->fBuckets, key );
 		if ( node != NULL )
 		{
-			UserGroup *entry = RBNODE_TO_USERGROUP( node );
+			UserGroup *entry = node->ug;
 			
 			// if entry is in hash, nothing to do
 			if ( entry == item ) goto bail;
@@ -312,11 +498,11 @@ static bool __HashTable_Add( HashTable* hash, UserGroup* item, bool replaceExist
 				}
 				
 				if ( forceReplace == true ) {
-					DbgLog( kLogInfo, "mbr_mig - Membership - RBtree add - builtin group ID (forcing replace because it is local)" );
+					DbgLog( kLogInfo, "mbr_mig - Membership - Hash add - builtin group ID (forcing replace because it is local)" );
 					replaceExisting = true;
 				}
 				else {
-					DbgLog( kLogInfo, "mbr_mig - Membership - RBtree add - builtin group ID (not allowing replacement of existing entry)" );
+					DbgLog( kLogInfo, "mbr_mig - Membership - Hash add - builtin group ID (not allowing replacement of existing entry)" );
 					goto bail;
 				}
 			}
@@ -328,18 +514,12 @@ static bool __HashTable_Add( HashTable* hash, UserGroup* item, bool replaceExist
 			
 			if ( replaceExisting == true )
 			{
-				DbgLog( kLogDebug, "mbr_mig - Membership - RBtree add - %s - replacing existing entry %s (%X) - node %X", 
+				DbgLog( kLogDebug, "mbr_mig - Membership - Hash add - %s - replacing existing entry %s (%X) - node %X", 
 						hash->fName ?: "", entry->fName ?: "", entry, node );
 				
-				rb_tree_remove_node( &hash->fRBtree, node );
-				DSFree( node );
-				hash->fNumEntries--;
-				
-				// release it if owner and entry are not the same (don't self release)
-				if ( entry != hash->fOwner ) {
-					UserGroup_Release( entry );
-					entry = NULL;
-				}
+				// entry is released once readers are done with the node
+				__HashTable_UnlinkNode( hash, node );
+				node = NULL;
 			}
 			// if not a reserved ID, we log a message, workaround for LDAP and AD conflicts
 			else if ( (item->fFlags & (kUGFlagReservedID | kUGFlagReservedSID | kUGFlagReservedName)) == 0 )
@@ -364,26 +544,20 @@ static bool __HashTable_Add( HashTable* hash, UserGroup* item, bool replaceExist
 			}
 		}
 		
-		struct ug_rb_node *ugnode = (struct ug_rb_node *) calloc( 1, sizeof(struct ug_rb_node) );
-		assert( ugnode != NULL );
-		
-		ugnode->ug = item;
-		ugnode->index = iIndex;
-		if ( rb_tree_insert_node(&hash->fRBtree, (struct rb_node *) ugnode) == true ) {
+		// keys are unique, so we only add if there is no existing entry left
+		if ( node == NULL ) {
+			struct ug_hash_node *ugnode = __HashTable_CreateNode( hash, item, iIndex, key );
 			
 			// retain it if owner and item are not the same (don't self retain)
 			if ( item != hash->fOwner ) {
 				(void) UserGroup_Retain( item );
 			}
-			hash->fNumEntries++;
-			DbgLog( kLogDebug, "mbr_mig - Membership - RBtree add - %s - adding entry %s (%X) - node %X", 
+			
+			__HashTable_InsertNode( hash, ugnode );
+			DbgLog( kLogDebug, "mbr_mig - Membership - Hash add - %s - adding entry %s (%X) - node %X", 
 					hash->fName, item->fName ? : "", item, ugnode );
 			bSuccess = true;
 		}
-		else {
-			// free the node if we didn't add it, should never happen since we searched beforehand, but safety
-			DSFree( ugnode );
-		}
 		
 		if ( bSuccess == true && 
 			 (hash->fHashType == eKerberosHash || hash->fHashType == eX509DNHash) && 
@@ -401,7 +575,10 @@ bail:
 	
 	return bSuccess;
 }
-		
+
+#pragma mark -
+#pragma mark Public routines
+
 HashTable* HashTable_Create( const char *name, void *owner, eHashType hashType )
 {
 	// we don't use calloc due to static objects need clearing
@@ -416,31 +593,6 @@ HashTable* HashTable_Create( const char *name, void *owner, eHashType hashType )
 
 void HashTable_Initialize( HashTable *hash, const char *name, void *owner, eHashType hashType )
 {
-	static const struct rb_tree_ops id_rbt_ops = {
-		.rbto_compare_nodes = rbt_compare_id_nodes,
-		.rbto_compare_key   = rbt_compare_id_key
-	};
-	static const struct rb_tree_ops guid_rbt_ops = {
-		.rbto_compare_nodes = rbt_compare_guid_nodes,
-		.rbto_compare_key   = rbt_compare_guid_key
-	};
-	static const struct rb_tree_ops sid_rbt_ops = {
-		.rbto_compare_nodes = rbt_compare_sid_nodes,
-		.rbto_compare_key   = rbt_compare_sid_key
-	};
-	static const struct rb_tree_ops name_rbt_ops = {
-		.rbto_compare_nodes = rbt_compare_name_nodes,
-		.rbto_compare_key   = rbt_compare_name_key
-	};
-	static const struct rb_tree_ops kerberos_rbt_ops = {
-		.rbto_compare_nodes = rbt_compare_kerberos_nodes,
-		.rbto_compare_key   = rbt_compare_kerberos_key
-	};
-	static const struct rb_tree_ops x509dn_rbt_ops = {
-		.rbto_compare_nodes = rbt_compare_x509dn_nodes,
-		.rbto_compare_key   = rbt_compare_x509dn_key
-	};
-	
 	bzero( hash, sizeof(HashTable) );
 	
 	hash->fRefCount = INT32_MAX;
@@ -452,32 +604,26 @@ void HashTable_Initialize( HashTable *hash, const char *name, void *owner, eHash
 	switch( hashType )
 	{
 		case eIDHash:
-			rb_tree_init( &hash->fRBtree, &id_rbt_ops );
 			hash->fKeyOffset = __offsetof(struct UserGroup, fID);
 			break;
 			
 		case eGUIDHash:
-			rb_tree_init( &hash->fRBtree, &guid_rbt_ops );
 			hash->fKeyOffset = __offsetof(struct UserGroup, fGUID);
 			break;
 			
 		case eSIDHash:
-			rb_tree_init( &hash->fRBtree, &sid_rbt_ops );
 			hash->fKeyOffset = __offsetof(struct UserGroup, fSID);
 			break;
 			
 		case eNameHash:
-			rb_tree_init( &hash->fRBtree, &name_rbt_ops );
 			hash->fKeyOffset = __offsetof(struct UserGroup, fName);
 			break;
 			
 		case eKerberosHash:
-			rb_tree_init( &hash->fRBtree, &kerberos_rbt_ops );
 			hash->fKeyOffset = __offsetof(struct UserGroup, fKerberos);
 			break;
 			
 		case eX509DNHash:
-			rb_tree_init( &hash->fRBtree, &x509dn_rbt_ops );
 			hash->fKeyOffset = __offsetof(struct UserGroup, fX509DN);
 			break;
 	}
@@ -503,28 +649,28 @@ void HashTable_Reset( HashTable* hash )
 {
 	dispatch_sync( hash->fQueue, 
 				   ^(void) {
-					   struct rb_tree *tree = &hash->fRBtree;
-					   struct rb_node *node = RB_TREE_MIN( tree );
-						
-					   // we have to delete after we iterate forward
-					   while ( node != NULL ) {
-						   struct rb_node	*delNode	= node;
-						   struct UserGroup *entry		= RBNODE_TO_USERGROUP( delNode );
-							
-						   node = rb_tree_iterate( tree, node, RB_DIR_RIGHT );
-
-						   // now let's remove the node
-						   rb_tree_remove_node( tree, delNode );
-						   DSFree( delNode );
+					   struct ug_hash_buckets *buckets = hash->fBuckets;
+					   
+					   if ( buckets != NULL ) {
+						   // unpublish the table first, then everything in it can be retired
+						   hash->fBuckets = NULL;
 						   
-						   // release it if owner and entry are not the same (don't self release)
-						   if ( entry != hash->fOwner ) {
-							   UserGroup_Release( entry );
-							   entry = NULL;
+						   for ( uint32_t ii = 0; ii <= buckets->fMask; ii++ ) {
+							   struct ug_hash_node *node = buckets->fBucket[ii];
+							   
+							   while ( node != NULL ) {
+								   struct ug_hash_node *delNode = node;
+								   
+								   node = node->next;
+								   __HashTable_RetireNode( hash, delNode );
+							   }
 						   }
-					   };
-						
+						   
+						   __HashTable_RetireBuckets( hash, buckets );
+					   }
+					   
 					   hash->fNumEntries = 0;
+					   __HashTable_Reclaim( hash, true );
 				   } );
 }
 
@@ -534,39 +680,36 @@ int HashTable_ResetMemberships( HashTable *hash )
 	
 	dispatch_sync( hash->fQueue, 
 				   ^(void) {
-					   if ( hash->fNumEntries > 0 )
+					   struct ug_hash_buckets *buckets = hash->fBuckets;
+					   
+					   if ( hash->fNumEntries > 0 && buckets != NULL )
 					   {
-						   struct rb_tree *tree = &hash->fRBtree;
-						   struct rb_node *node = RB_TREE_MIN( tree );
-						   
-						   while ( node != NULL ) {
-							   struct rb_node	*delNode	= node;
-							   struct UserGroup *entry		= RBNODE_TO_USERGROUP( delNode );
+						   for ( uint32_t ii = 0; ii <= buckets->fMask; ii++ ) {
+							   struct ug_hash_node *node = buckets->fBucket[ii];
 							   
-							   // we have to delete after we iterate forward
-							   node = rb_tree_iterate( tree, node, RB_DIR_RIGHT );
-
-							   // check the node to be deleted
-							   if ( entry->fNode == NULL || entry->fNodeAvailable == true ) {
+							   while ( node != NULL ) {
+								   struct ug_hash_node	*delNode	= node;
+								   struct UserGroup		*entry		= delNode->ug;
 								   
-								   // safe to remove
-								   rb_tree_remove_node( tree, delNode );
-								   DSFree( delNode );
-								   hash->fNumEntries--;
+								   // we have to delete after we iterate forward
+								   node = node->next;
 								   
-								   // release it if owner and entry are not the same (don't self release)
-								   if ( entry != hash->fOwner ) {
-									   UserGroup_Release( entry );
-									   entry = NULL;
+								   // check the node to be deleted
+								   if ( entry->fNode == NULL || entry->fNodeAvailable == true ) {
+									   
+									   // safe to remove
+									   __HashTable_UnlinkNode( hash, delNode );
+								   }
+								   else {
+									   offlineCount++;
+									   DbgLog( kLogInfo, "mbr_mig - Membership - Hash membership reset - %s - %s (%d) - node %s - offline", 
+											   hash->fName, entry->fName ? :"", entry->fID, entry->fNode ? : "no node" );
 								   }
 							   }
-							   else {
-								   offlineCount++;
-								   DbgLog( kLogInfo, "mbr_mig - Membership - RBtree membership reset - %s - %s (%d) - node %s - offline", 
-										   hash->fName, entry->fName ? :"", entry->fID, entry->fNode ? : "no node" );
-							   }
-						   };
+						   }
 					   }
+					   
+					   __HashTable_Reclaim( hash, false );
 				    } );
 	
 	return offlineCount;
@@ -581,6 +724,7 @@ bool HashTable_Add( HashTable* hash, UserGroup* item, bool replaceExisting )
 	dispatch_sync( hash->fQueue, 
 				   ^(void) {
 					   bSuccess = __HashTable_Add( hash, item, replaceExisting );
+					   __HashTable_Reclaim( hash, false );
 				   } );
 	
 	return bSuccess;
@@ -588,17 +732,19 @@ bool HashTable_Add( HashTable* hash, UserGroup* item, bool replaceExisting )
 
 UserGroup* HashTable_GetAndRetain( HashTable* hash, const void* data )
 {
-	__block UserGroup	*entry	= NULL;
+	UserGroup	*entry	= NULL;
 	
 	if ( hash == NULL ) return NULL;
 	
-	dispatch_sync( hash->fQueue,
-				   ^(void) {
-					   struct rb_node *node = rb_tree_find_node( &hash->fRBtree, data );
-					   if ( node != NULL ) {
-						   entry = UserGroup_Retain( RBNODE_TO_USERGROUP(node) );
-					   }
-				   } );
+	// lock-free, writers only make us wait while they flip the epoch
+	uint32_t epoch = __HashTable_ReadBegin( hash );
+	
+	struct ug_hash_node *node = __HashTable_FindNode( hash, hash->fBuckets, data );
+	if ( node != NULL ) {
+		entry = UserGroup_Retain( node->ug );
+	}
+	
+	__HashTable_ReadEnd( hash, epoch );
 
 	return entry;
 }
@@ -609,33 +755,17 @@ void HashTable_Remove( HashTable* hash, UserGroup* item )
 	
 	dispatch_sync( hash->fQueue,
 				   ^(void) {
-					   void *key = USERGROUP_TO_KEY(item, hash->fKeyOffset);
-					   if (hash->fHashType == eNameHash) {
-						   key = ((void **)key)[0];
-					   } else {
-						   assert(hash->fHashType != eKerberosHash);
-						   assert(hash->fHashType != eX509DNHash);
-					   }
-
-					   struct rb_node *node = rb_tree_find_node( &hash->fRBtree, key );
-					   if ( node != NULL ) {
-						   UserGroup *tempItem = RBNODE_TO_USERGROUP( node );
+					   assert( hash->fHashType != eKerberosHash );
+					   assert( hash->fHashType != eX509DNHash );
+					   
+					   struct ug_hash_node *node = __HashTable_FindNode( hash, hash->fBuckets, __HashTable_ItemKey(hash, item, 0) );
 						
-						   // we only remove the exact entry because there could be conflicted authoritative entries
-						   if ( tempItem == item ) {
-							   
-							   // safe to remove
-							   rb_tree_remove_node( &hash->fRBtree, node );
-							   DSFree( node );
-							   
-							   // release it if owner and entry are not the same (don't self release)
-							   if ( tempItem != hash->fOwner ) {
-								   UserGroup_Release( tempItem );
-								   tempItem = NULL;
-							   }
-							   hash->fNumEntries--;
-						   }
+					   // we only remove the exact entry because there could be conflicted authoritative entries
+					   if ( node != NULL && node->ug == item ) {
+						   __HashTable_UnlinkNode( hash, node );
 					   }
+					   
+					   __HashTable_Reclaim( hash, false );
 				   } );
 }
 
@@ -646,7 +776,7 @@ void HashTable_Merge( HashTable* destination, HashTable* source )
 	int count = HashTable_CreateItemArray( source, &tempArray );
 	if ( count > 0 )
 	{
-		DbgLog( kLogInfo, "mbr_mig - Membership - RBtree merge - %s - merging %X into %s (%X)", 
+		DbgLog( kLogInfo, "mbr_mig - Membership - Hash merge - %s - merging %X into %s (%X)", 
 			    destination->fName, source, destination->fName, destination );
 		
 		dispatch_sync( destination->fQueue,
@@ -660,6 +790,7 @@ void HashTable_Merge( HashTable* destination, HashTable* source )
 						   }
 							
 						   free( tempArray );
+						   __HashTable_Reclaim( destination, false );
 					   } );
 	}
 }
@@ -674,21 +805,22 @@ int HashTable_CreateItemArray( HashTable *hash, UserGroup*** itemArray )
 	dispatch_sync( hash->fQueue,
 				   ^(void) {
 					   long numEntries = hash->fNumEntries;
+					   struct ug_hash_buckets *buckets = hash->fBuckets;
 					   
-					   if ( numEntries > 0 )
+					   if ( numEntries > 0 && buckets != NULL )
 					   {
 						   (*itemArray) = tempArray = (UserGroup **) calloc( numEntries, sizeof(UserGroup *) );
 						   assert( tempArray != NULL );
 						   
-						   struct rb_node *node;
-						   struct rb_tree *rbtree = &hash->fRBtree;
-						   
-						   RB_TREE_FOREACH( node, rbtree ) {
-							   struct UserGroup *ug = RBNODE_TO_USERGROUP( node );
-							   tempArray[numResults++] = UserGroup_Retain( ug );
+						   for ( uint32_t ii = 0; ii <= buckets->fMask; ii++ ) {
+							   struct ug_hash_node *node;
 							   
-							   // this should never happen, but a safety
-							   assert( numResults <= numEntries );
+							   for ( node = buckets->fBucket[ii]; node != NULL; node = node->next ) {
+								   tempArray[numResults++] = UserGroup_Retain( node->ug );
+								   
+								   // this should never happen, but a safety
+								   assert( numResults <= numEntries );
+							   }
 						   }
 					   }
 				   } );
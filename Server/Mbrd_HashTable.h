@@ -28,7 +28,6 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <dispatch/dispatch.h>
-#include "rb.h"
 
 typedef enum eHashType
 {
@@ -40,12 +39,23 @@ typedef enum eHashType
 	eX509DNHash		= 6
 } eHashType;
 
+struct ug_hash_node;
+struct ug_hash_buckets;
+
+// Readers never take fQueue, they walk fBuckets inside an epoch (see HashTable_GetAndRetain)
+// writers are serialized on fQueue and defer freeing anything they unlink until no reader from
+// the previous epoch can still be looking at it
 typedef struct HashTable
 {
 	volatile int32_t	fRefCount;
 	
 	dispatch_queue_t	fQueue;
-	struct rb_tree		fRBtree;
+	struct ug_hash_buckets * volatile fBuckets;
+	volatile uint32_t	fEpoch;
+	volatile int32_t	fReaders[2];
+	struct ug_hash_node	*fRetiredNodes;
+	struct ug_hash_buckets *fRetiredBuckets;
+	long				fNumRetired;
 	uint32_t			fHashType;
 	long				fKeyOffset;
 	long				fNumEntries;
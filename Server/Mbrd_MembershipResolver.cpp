@@ -60,6 +60,9 @@
 #define kSmallSIDBlock	2
 #define kLargeSIDBlock	3
 
+#define kTempIDStart		0x82000000
+#define kTempIDBlockSize	1024
+
 #define WELL_KNOWN_RID_BASE 1000
 
 #define COMPATIBLITY_SID_PREFIX	"S-1-5-21-987654321-987654321-987654321"
@@ -79,7 +82,7 @@ typedef struct TempUIDCacheBlockSmall
 	int fKind;
 	int fNumIDs;
 	uid_t fStartID;
-	uuid_t fGUIDs[1024];
+	uuid_t fGUIDs[kTempIDBlockSize];
 } TempUIDCacheBlockSmall;
 
 typedef struct TempUIDCacheBlockLarge
@@ -88,7 +91,7 @@ typedef struct TempUIDCacheBlockLarge
 	int fKind;
 	int fNumIDs;
 	uid_t fStartID;
-	ntsid_t fSIDs[1024];
+	ntsid_t fSIDs[kTempIDBlockSize];
 } TempUIDCacheBlockLarge;
 
 
@@ -119,12 +122,38 @@ static uuid_t				gRootUserUUID;
 
 static DSMutexSemaphore			gMbrdGlobalMutex( "::gMbrdGlobalMutex" );
 static StatBlock				gStatBlock;
-static TempUIDCacheBlockBase	*gUIDCache = NULL;
+
+// temporary IDs live in blocks indexed by (tempID - kTempIDStart) / kTempIDBlockSize, the hash maps
+// the GUID/SID back to the temporary ID and only stores the ID itself (0 is an empty slot)
+static pthread_rwlock_t			gTempIDLock				= PTHREAD_RWLOCK_INITIALIZER;
+static TempUIDCacheBlockBase	**gTempIDBlocks			= NULL;
+static uint32_t					gNumTempIDBlocks		= 0;
+static uint32_t					gMaxTempIDBlocks		= 0;
+static TempUIDCacheBlockBase	*gTempIDCurrentBlock[kLargeSIDBlock + 1];
+static uid_t					*gTempIDHash			= NULL;
+static uint32_t					gTempIDHashMask			= 0;
+static uint32_t					gNumTempIDs				= 0;
 
 static map<string, string>		sidMap;
 static pthread_mutex_t			sidMapLock = PTHREAD_MUTEX_INITIALIZER;	// waiting for dispatch version
 
 static dispatch_queue_t			gLookupQueue = NULL;
+
+// concurrent searches for the same record type, ID type and value share the answer of the first caller.
+// A thread that owns a search never waits on another one (it is flagged as a membership thread until its
+// search is done) and plugin work for a search runs on the owner's thread, so waits can't form a cycle.
+typedef struct MbrdInflightSearch
+{
+	int32_t				fRefCount;	// protected by gInflightLock
+	pthread_t			fOwner;
+	dispatch_group_t	fGroup;
+	UserGroup			**fResults;
+	UInt32				fCount;
+} MbrdInflightSearch;
+
+static map<string, MbrdInflightSearch *>	gInflightSearches;
+static pthread_mutex_t			gInflightLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t					gNumCoalescedSearches = 0;
 static pthread_key_t			gMembershipThreadKey = NULL;
 
 #ifndef DISABLE_CACHE_PLUGIN
@@ -173,7 +202,7 @@ static void* UIDCacheIndexToPointer(TempUIDCacheBlockBase* block, int inIndex)
 {
 	void* result;
 	
-	if (block->fKind == kUUIDBlock || block->fKind == kSmallSIDBlock)
+	if (block->fKind == kUUIDBlock)
 	{
 		TempUIDCacheBlockSmall* temp = (TempUIDCacheBlockSmall*)block;
 		result = &temp->fGUIDs[inIndex];
@@ -187,96 +216,186 @@ static void* UIDCacheIndexToPointer(TempUIDCacheBlockBase* block, int inIndex)
 	return result;
 }
 
-static TempUIDCacheBlockBase *Mbrd_EntryForID( void *id, int blockKind, int idSize, TempUIDCacheBlockBase **lastblock, uid_t *tempID )
+static int Mbrd_TempIDKeySize( int blockKind )
 {
-	gMbrdGlobalMutex.WaitLock();
+	return (blockKind == kUUIDBlock ? sizeof(uuid_t) : sizeof(ntsid_t));
+}
+
+// must hold gTempIDLock (read or write)
+static TempUIDCacheBlockBase *Mbrd_BlockForTempID( uid_t tempID )
+{
+	if ( tempID < kTempIDStart ) {
+		return NULL;
+	}
+	
+	uint32_t index = (tempID - kTempIDStart) / kTempIDBlockSize;
+	if ( index >= gNumTempIDBlocks ) {
+		return NULL;
+	}
+	
+	TempUIDCacheBlockBase *block = gTempIDBlocks[index];
+	if ( (int) (tempID - block->fStartID) >= block->fNumIDs ) {
+		return NULL;
+	}
+	
+	return block;
+}
+
+// must hold gTempIDLock (read or write)
+static uid_t Mbrd_EntryForID( const void *id, int blockKind, int idSize )
+{
+	if ( gTempIDHash == NULL ) {
+		return 0;
+	}
 	
-	TempUIDCacheBlockBase*	block			= gUIDCache;
-	TempUIDCacheBlockBase*	returnValue		= NULL;
+	uint32_t	slot	= DSHashBytes( id, idSize ) & gTempIDHashMask;
+	uid_t		tempID;
 	
-	while ( returnValue == NULL && block != NULL )
+	while ( (tempID = gTempIDHash[slot]) != 0 )
 	{
-		int i;
+		TempUIDCacheBlockBase *block = gTempIDBlocks[(tempID - kTempIDStart) / kTempIDBlockSize];
 		
-		if ( block->fKind == blockKind )
-		{
-			for ( i = 0; i < block->fNumIDs; i++ )
-			{
-				if ( memcmp(id, UIDCacheIndexToPointer(block, i), idSize) == 0 ) {
-					(*tempID) = block->fStartID + i;
-					returnValue = block;
-					break;
-				}
+		if ( block->fKind == blockKind && memcmp(id, UIDCacheIndexToPointer(block, tempID - block->fStartID), idSize) == 0 ) {
+			return tempID;
+		}
+		
+		slot = (slot + 1) & gTempIDHashMask;
+	}
+	
+	return 0;
+}
+
+// must hold gTempIDLock for write
+static void Mbrd_AddTempIDToHash( uid_t tempID )
+{
+	// keep the table at most half full so probes stay short
+	if ( gTempIDHash == NULL || (gNumTempIDs + 1) * 2 > gTempIDHashMask + 1 )
+	{
+		uint32_t	newSize		= (gTempIDHash != NULL ? 2 * (gTempIDHashMask + 1) : kTempIDBlockSize);
+		uid_t		*oldHash	= gTempIDHash;
+		uint32_t	oldSize		= (oldHash != NULL ? gTempIDHashMask + 1 : 0);
+		
+		gTempIDHash = (uid_t *) calloc( newSize, sizeof(uid_t) );
+		assert( gTempIDHash != NULL );
+		
+		gTempIDHashMask = newSize - 1;
+		gNumTempIDs = 0;
+		
+		for ( uint32_t ii = 0; ii < oldSize; ii++ ) {
+			if ( oldHash[ii] != 0 ) {
+				Mbrd_AddTempIDToHash( oldHash[ii] );
 			}
 		}
 		
-		(*lastblock) = block;
-		block = block->fNext;
+		DSFree( oldHash );
 	}
 	
-	gMbrdGlobalMutex.SignalLock();
+	TempUIDCacheBlockBase	*block		= gTempIDBlocks[(tempID - kTempIDStart) / kTempIDBlockSize];
+	int						idSize		= Mbrd_TempIDKeySize( block->fKind );
+	uint32_t				slot		= DSHashBytes( UIDCacheIndexToPointer(block, tempID - block->fStartID), idSize ) & gTempIDHashMask;
+	
+	while ( gTempIDHash[slot] != 0 ) {
+		slot = (slot + 1) & gTempIDHashMask;
+	}
 	
-	return returnValue;
+	gTempIDHash[slot] = tempID;
+	gNumTempIDs++;
 }
 
-static uid_t Mbrd_CreateTempID( void *id, int blockKind, int idSize )
+static uid_t Mbrd_CreateTempID( const void *id, int blockKind )
 {
-	TempUIDCacheBlockBase	*lastblock		= NULL;
-	uid_t					tempID			= 0;
-	TempUIDCacheBlockBase	*lasttypeblock	= Mbrd_EntryForID( id, blockKind, idSize, &lastblock, &tempID );
-
-	if ( lasttypeblock != NULL ) {
+	int		idSize	= Mbrd_TempIDKeySize( blockKind );
+	uid_t	tempID;
+	
+	// lookups of already issued IDs only need the read lock
+	pthread_rwlock_rdlock( &gTempIDLock );
+	tempID = Mbrd_EntryForID( id, blockKind, idSize );
+	pthread_rwlock_unlock( &gTempIDLock );
+	
+	if ( tempID != 0 ) {
 		return tempID;
 	}
 	
-	gMbrdGlobalMutex.WaitLock();
-
-	if ((lasttypeblock == NULL) || (lasttypeblock->fNumIDs == 1024))
+	pthread_rwlock_wrlock( &gTempIDLock );
+	
+	// someone may have issued it while we didn't hold the lock
+	tempID = Mbrd_EntryForID( id, blockKind, idSize );
+	if ( tempID == 0 )
 	{
-		if (idSize == sizeof(uuid_t))
-		{
-			lasttypeblock = (TempUIDCacheBlockBase*)malloc(sizeof(TempUIDCacheBlockSmall));
-			memset(lasttypeblock, 0, sizeof(TempUIDCacheBlockSmall));
-		}
-		else
-		{
-			lasttypeblock = (TempUIDCacheBlockBase*)malloc(sizeof(TempUIDCacheBlockLarge));
-			memset(lasttypeblock, 0, sizeof(TempUIDCacheBlockLarge));
-		}
-		lasttypeblock->fKind = blockKind;
-		if (lastblock != NULL)
-		{
-			lastblock->fNext = lasttypeblock;
-			lasttypeblock->fStartID = lastblock->fStartID + 1024;
-		}
-		else
+		TempUIDCacheBlockBase *block = gTempIDCurrentBlock[blockKind];
+		
+		if ( block == NULL || block->fNumIDs == kTempIDBlockSize )
 		{
-			gUIDCache = lasttypeblock;
-			lasttypeblock->fStartID = 0x82000000;
+			if ( blockKind == kUUIDBlock )
+			{
+				block = (TempUIDCacheBlockBase*)malloc(sizeof(TempUIDCacheBlockSmall));
+				memset(block, 0, sizeof(TempUIDCacheBlockSmall));
+			}
+			else
+			{
+				block = (TempUIDCacheBlockBase*)malloc(sizeof(TempUIDCacheBlockLarge));
+				memset(block, 0, sizeof(TempUIDCacheBlockLarge));
+			}
+			
+			block->fKind = blockKind;
+			block->fStartID = kTempIDStart + gNumTempIDBlocks * kTempIDBlockSize;
+			
+			if ( gNumTempIDBlocks == gMaxTempIDBlocks ) {
+				gMaxTempIDBlocks = (gMaxTempIDBlocks != 0 ? 2 * gMaxTempIDBlocks : 16);
+				gTempIDBlocks = (TempUIDCacheBlockBase **) reallocf( gTempIDBlocks, gMaxTempIDBlocks * sizeof(TempUIDCacheBlockBase *) );
+				assert( gTempIDBlocks != NULL );
+			}
+			
+			gTempIDBlocks[gNumTempIDBlocks++] = block;
+			gTempIDCurrentBlock[blockKind] = block;
 		}
+		
+		memcpy( UIDCacheIndexToPointer(block, block->fNumIDs), id, idSize );
+		tempID = block->fStartID + block->fNumIDs;
+		block->fNumIDs++;
+		
+		Mbrd_AddTempIDToHash( tempID );
 	}
 	
-	memcpy(UIDCacheIndexToPointer(lasttypeblock, lasttypeblock->fNumIDs), id, idSize);
-	lasttypeblock->fNumIDs++;
-	
-	tempID = lasttypeblock->fStartID + lasttypeblock->fNumIDs - 1;
-	
-	gMbrdGlobalMutex.SignalLock();
+	pthread_rwlock_unlock( &gTempIDLock );
 	
 	return tempID;
 }
 
 static uid_t Mbrd_CreateTempIDForGUID( uuid_t guid )
 {
-	return Mbrd_CreateTempID( guid, kUUIDBlock, sizeof(guid) );
+	return Mbrd_CreateTempID( guid, kUUIDBlock );
 }
 
 static uid_t Mbrd_CreateTempIDForSID( ntsid_t* sid)
 {
 	if (sid->sid_authcount <= 2)
-		return Mbrd_CreateTempID( sid, kSmallSIDBlock, sizeof(*sid) );
+		return Mbrd_CreateTempID( sid, kSmallSIDBlock );
+	
+	return Mbrd_CreateTempID( sid, kLargeSIDBlock );
+}
+
+// returns the block kind the ID was issued for (0 if it is not a temporary ID we issued)
+static int Mbrd_GetIdentifierForTempID( uid_t tempID, uuid_t guid, ntsid_t *sid )
+{
+	int blockKind = 0;
+	
+	pthread_rwlock_rdlock( &gTempIDLock );
+	
+	TempUIDCacheBlockBase *block = Mbrd_BlockForTempID( tempID );
+	if ( block != NULL ) {
+		blockKind = block->fKind;
+		if ( blockKind == kUUIDBlock ) {
+			uuid_copy( guid, (unsigned char *) UIDCacheIndexToPointer(block, tempID - block->fStartID) );
+		}
+		else {
+			bcopy( UIDCacheIndexToPointer(block, tempID - block->fStartID), sid, sizeof(ntsid_t) );
+		}
+	}
+	
+	pthread_rwlock_unlock( &gTempIDLock );
 	
-	return Mbrd_CreateTempID( sid, kLargeSIDBlock, sizeof(*sid) );
+	return blockKind;
 }
 
 static bool Mbrd_ConvertSIDFromString(const char* sidString, ntsid_t* sid)
@@ -640,7 +759,8 @@ static const char *Mbrd_GetNodenameOrSIDFromCache( const char *inNodeName, const
 	return result;
 }
 
-UserGroup **Mbrd_FindItemsAndRetain( tDirNodeReference dirNode, tDataListPtr recType, int idType, const char *value, uint32_t flags, UInt32 *recCount )
+static UserGroup **__Mbrd_FindItemsAndRetain( tDirNodeReference dirNode, tDataListPtr recType, int idType, const char *value, uint32_t flags, 
+											  UInt32 *recCount )
 {
 	UInt32 count;
 	tContextData localContext = 0;
@@ -1167,6 +1287,109 @@ UserGroup **Mbrd_FindItemsAndRetain( tDirNodeReference dirNode, tDataListPtr rec
 	return results;
 }
 
+static void Mbrd_ReleaseInflightSearch( MbrdInflightSearch *search )
+{
+	pthread_mutex_lock( &gInflightLock );
+	int32_t refCount = --search->fRefCount;
+	pthread_mutex_unlock( &gInflightLock );
+	
+	if ( refCount == 0 ) {
+		for ( UInt32 ii = 0; ii < search->fCount; ii++ ) {
+			UserGroup_Release( search->fResults[ii] );
+		}
+		
+		DSFree( search->fResults );
+		dispatch_release( search->fGroup );
+		free( search );
+	}
+}
+
+UserGroup **Mbrd_FindItemsAndRetain( tDirNodeReference dirNode, tDataListPtr recType, int idType, const char *value, uint32_t flags, UInt32 *recCount )
+{
+	// a search issued while this thread owns a search (plugin calling back into us) must not wait on anything
+	if ( value == NULL || Mbrd_IsMembershipThread() == true ) {
+		return __Mbrd_FindItemsAndRetain( dirNode, recType, idType, value, flags, recCount );
+	}
+	
+	char keyPrefix[64];
+	
+	snprintf( keyPrefix, sizeof(keyPrefix), "%u:%p:%d:%u:%u:", (unsigned int) dirNode, recType, idType, flags, (unsigned int) (*recCount) );
+	string key = string( keyPrefix ) + value;
+	
+	pthread_mutex_lock( &gInflightLock );
+	
+	map<string, MbrdInflightSearch *>::iterator iter = gInflightSearches.find( key );
+	if ( iter != gInflightSearches.end() )
+	{
+		MbrdInflightSearch	*search		= iter->second;
+		UserGroup			**results	= NULL;
+		
+		// our own search, waiting would never finish
+		if ( pthread_equal(search->fOwner, pthread_self()) != 0 ) {
+			pthread_mutex_unlock( &gInflightLock );
+			return __Mbrd_FindItemsAndRetain( dirNode, recType, idType, value, flags, recCount );
+		}
+		
+		search->fRefCount++;
+		pthread_mutex_unlock( &gInflightLock );
+		
+		__sync_add_and_fetch( &gNumCoalescedSearches, 1 );
+		DbgLog( kLogDebug, "mbr_mig - Membership - waiting for an inflight search for '%s' (ID type %d)", value, idType );
+		
+		dispatch_group_wait( search->fGroup, DISPATCH_TIME_FOREVER );
+		
+		if ( search->fCount > 0 ) {
+			results = (UserGroup **) calloc( search->fCount, sizeof(UserGroup *) );
+			assert( results != NULL );
+			
+			for ( UInt32 ii = 0; ii < search->fCount; ii++ ) {
+				results[ii] = UserGroup_Retain( search->fResults[ii] );
+			}
+		}
+		
+		(*recCount) = search->fCount;
+		Mbrd_ReleaseInflightSearch( search );
+		
+		return results;
+	}
+	
+	MbrdInflightSearch *search = (MbrdInflightSearch *) calloc( 1, sizeof(MbrdInflightSearch) );
+	assert( search != NULL );
+	
+	search->fRefCount = 1;
+	search->fOwner = pthread_self();
+	search->fGroup = dispatch_group_create();
+	dispatch_group_enter( search->fGroup );
+	gInflightSearches[key] = search;
+	
+	pthread_mutex_unlock( &gInflightLock );
+	
+	Mbrd_SetMembershipThread( true );
+	UserGroup **results = __Mbrd_FindItemsAndRetain( dirNode, recType, idType, value, flags, recCount );
+	Mbrd_SetMembershipThread( false );
+	
+	// keep our own reference to the results for anyone that was waiting
+	if ( results != NULL && (*recCount) > 0 ) {
+		search->fResults = (UserGroup **) calloc( (*recCount), sizeof(UserGroup *) );
+		assert( search->fResults != NULL );
+		
+		for ( UInt32 ii = 0; ii < (*recCount); ii++ ) {
+			search->fResults[ii] = UserGroup_Retain( results[ii] );
+		}
+		
+		search->fCount = (*recCount);
+	}
+	
+	pthread_mutex_lock( &gInflightLock );
+	gInflightSearches.erase( key );
+	pthread_mutex_unlock( &gInflightLock );
+	
+	dispatch_group_leave( search->fGroup );
+	Mbrd_ReleaseInflightSearch( search );
+	
+	return results;
+}
+
 static UserGroup *Mbrd_FindItemAndRetain( tDirNodeReference dirNode, tDataListPtr recType, int idType, const char *value, uint32_t flags )
 {
 	UInt32		count	= 1;
@@ -1316,6 +1539,8 @@ static UserGroup* __Mbrd_GetItemWithIdentifierAndRetain( MbrdCache *cache, int i
 	guid_t *guid = (guid_t *) identifier;
 	const char *stringVal = (char *) identifier;
 	tDataListPtr recType = NULL;
+	uuid_t tempGUID;
+	ntsid_t tempSID;
 	char *(^copyIdentifierAsString)(int, const void *) = ^(int theType, const void *theIdentifier) {
 		char *returnValue = NULL;
 		
@@ -1402,6 +1627,30 @@ static UserGroup* __Mbrd_GetItemWithIdentifierAndRetain( MbrdCache *cache, int i
 			break;
 	}
 	
+	// if we issued a temporary ID, look for what we issued it for instead
+	if ( item == NULL && (idType == ID_TYPE_UID || idType == ID_TYPE_GID) )
+	{
+		switch ( Mbrd_GetIdentifierForTempID(*((id_t *) identifier), tempGUID, &tempSID) )
+		{
+			case kUUIDBlock:
+				idType = ID_TYPE_GUID;
+				identifier = tempGUID;
+				break;
+				
+			case kSmallSIDBlock:
+			case kLargeSIDBlock:
+				idType = ID_TYPE_SID;
+				identifier = &tempSID;
+				break;
+		}
+		
+		if ( idType == ID_TYPE_GUID || idType == ID_TYPE_SID ) {
+			DbgLog( kLogInfo, "%s - Membership - Temporary ID detected, switched to %s", reqOrigin, (idType == ID_TYPE_GUID ? "GUID" : "SID") );
+			item = MbrdCache_GetAndRetain( cache, kUGRecordTypeUnknown, idType, identifier, flags );
+			recType = gUnknownType;
+		}
+	}
+	
 	// now check if it was found by the key we expected, if not we need to search again (asynchronously)
 	if ( item != NULL )
 	{
@@ -2750,13 +2999,16 @@ void Mbrd_ProcessGetStats(StatBlock *stats)
 	memcpy( stats, &gStatBlock, sizeof(StatBlock) );
 	gMbrdGlobalMutex.SignalLock();
 	stats->fTotalUpTime = GetElapsedSeconds() - stats->fTotalUpTime;
-	DbgLog( kLogDebug, "mbr_mig - Membership - Get stats" );
+	
+	// StatBlock is shared with the MIG clients, so coalesced searches are only reported here
+	DbgLog( kLogDebug, "mbr_mig - Membership - Get stats - %llu searches coalesced with an inflight search", gNumCoalescedSearches );
 }
 
 void Mbrd_ProcessResetStats(void)
 {
 	gMbrdGlobalMutex.WaitLock();
 	memset( &gStatBlock, 0, sizeof(StatBlock) );
+	gNumCoalescedSearches = 0;
 	gMbrdGlobalMutex.SignalLock();
 	DbgLog( kLogDebug, "mbr_mig - Membership - Reset stats" );
 }
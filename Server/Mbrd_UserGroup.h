@@ -106,6 +106,9 @@ typedef struct UserGroup
 	
 	// used for validation purposes so we don't flush entries
 	char*				fNode;
+	struct MbrdCacheNode* fCacheNode;	// interned fNode, owned by the Mbrd_Cache
+	struct UserGroup*   fNodeLink;		// entries of the same node, owned by the Mbrd_Cache
+	struct UserGroup*   fNodeBackLink;
 	uint32_t            fToken;
 	bool                fNodeAvailable;
 	dispatch_queue_t	fQueue;
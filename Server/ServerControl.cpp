@@ -35,6 +35,7 @@
 #include "DirServicesConst.h"
 #include "DirServicesPriv.h"
 #include "CHandlers.h"
+#include "CSrvrMessaging.h"
 #include "CRefTable.h"
 #include "DSMutexSemaphore.h"
 #include "DSCThread.h"
@@ -69,6 +70,8 @@
 #include <assert.h>
 #include <SystemConfiguration/SCDynamicStore.h>
 #include <dispatch/dispatch.h>
+#include <math.h>
+#include <libkern/OSAtomic.h>
 #include <sys/sysctl.h>	// for struct kinfo_proc and sysctl()
 #include <fcntl.h>
 #include <DirectoryServiceCore/DSSemaphore.h>
@@ -582,10 +585,12 @@ kern_return_t dsmig_do_api_call( mach_port_t server,
 		{
 			// we need to copy because we will allocate/deallocate it in the handler
 			//   but based on the size it thinks it is
-			sComData *pRequest = (sComData *) calloc( sizeof(sComData) + dataSize, 1 );
+			sComData *pRequest = CSrvrMessaging::AllocMessageBlock( dataSize );
 			if ( pRequest == NULL )
 				return KERN_MEMORY_ERROR;
 			
+			UInt32 blockSize = pRequest->fDataSize;
+			
 			CRequestHandler handler;
 			double reqStartTime = 0;
 			double reqEndTime = 0;
@@ -597,6 +602,9 @@ kern_return_t dsmig_do_api_call( mach_port_t server,
 				SwapMachMessage( pRequest, kDSSwapNetworkToHostOrder );
 			}
 
+			// the block may be larger than the client's, keep the real size
+			pRequest->fDataSize = blockSize;
+			
 			// need to populate the port
 			pRequest->fMachPort = server;
 			
@@ -629,6 +637,9 @@ kern_return_t dsmig_do_api_call( mach_port_t server,
 			
 			UInt32 dataLen = pRequest->fDataLength;
 			
+			// the handler may have grown the block
+			blockSize = pRequest->fDataSize;
+			
 			// need to swap if it wasn't sent in little endian
 			if ( pRequest->type.msgt_translate != 0 ) {
 				SwapMachMessage( pRequest, kDSSwapHostToNetworkOrder );
@@ -647,8 +658,10 @@ kern_return_t dsmig_do_api_call( mach_port_t server,
 				vm_read( mach_task_self(), (vm_address_t)pRequest, (sizeof(sComData) + dataLen - 1), reply_msg_ool, reply_msg_oolCnt );
 			}
 
-			// free our allocated request data...
-			free( pRequest );
+			// free our allocated request data, sizes back in host order so the block can be pooled
+			pRequest->fDataSize = blockSize;
+			pRequest->fDataLength = dataLen;
+			CSrvrMessaging::FreeMessageBlock( pRequest );
 			pRequest = NULL;
 			
 			gAPICallCount++;
@@ -1387,10 +1400,6 @@ ServerControl::ServerControl ( void )
 	fMemberDaemonFlushCacheRequestCount	= 0;
 	
 #ifdef BUILD_IN_PERFORMANCE
-	fLastPluginCalled			= 0;
-	fPerfTableNumPlugins		= 0;
-	fPerfTable					= nil;
-	
 #if PERFORMANCE_STATS_ALWAYS_ON
 	fPerformanceStatGatheringActive	= true;
 #else
@@ -2139,118 +2148,294 @@ ServerControl::ToggleAPILogging( bool fromSignal )
 }
 
 #ifdef BUILD_IN_PERFORMANCE
-void ServerControl::DeletePerfStatTable( void )
+
+// Every thread records into its own PerformanceThreadStats so the request path never takes
+// gPerformanceLoggingLock; the lock is only taken the first time a thread records, when a new
+// plugin shows up and when the tables are read.  Tables are never freed, a thread that goes
+// away leaves its table for the next new thread to pick up.  Resetting bumps the generation,
+// each thread clears its own table the next time it records.
+
+static pthread_key_t			gPerfThreadKey;
+static pthread_once_t			gPerfThreadKeyOnce		= PTHREAD_ONCE_INIT;
+static PerformanceThreadStats	*gPerfThreadList		= NULL;
+static volatile uint32_t		gPerfGeneration			= 1;
+static FourCharCode				gPerfSlotSignature[kPerfMaxPlugins];
+static const char				*gPerfSlotName[kPerfMaxPlugins];
+static volatile UInt32			gPerfSlotCount			= 0;
+static bool						gPerfSlotsFullLogged	= false;
+
+static void PerfThreadStatsRelease( void *inValue )
+{
+	PerformanceThreadStats *threadStats = (PerformanceThreadStats *) inValue;
+	
+	gPerformanceLoggingLock->WaitLock();
+	threadStats->inUse = false;
+	gPerformanceLoggingLock->SignalLock();
+}
+
+static void PerfThreadKeyInit( void )
 {
-	PluginPerformanceStats**	table = fPerfTable;
-	UInt32						pluginCount = fPerfTableNumPlugins;
+	pthread_key_create( &gPerfThreadKey, PerfThreadStatsRelease );
+}
 
-	fPerfTable = NULL;
-	fPerfTableNumPlugins = 0;
+static PerformanceThreadStats *PerfThreadStatsGet( void )
+{
+	PerformanceThreadStats *threadStats = NULL;
 	
-	if ( table )
+	pthread_once( &gPerfThreadKeyOnce, PerfThreadKeyInit );
+	
+	threadStats = (PerformanceThreadStats *) pthread_getspecific( gPerfThreadKey );
+	if ( threadStats == NULL )
 	{
-		for ( UInt32 i=0; i<pluginCount+1; i++ )
+		gPerformanceLoggingLock->WaitLock();
+		
+		for ( threadStats = gPerfThreadList; threadStats != NULL; threadStats = threadStats->next )
 		{
-			if ( table[i] )
+			if ( threadStats->inUse == false )
+				break;
+		}
+		
+		if ( threadStats == NULL )
+		{
+			threadStats = (PerformanceThreadStats *) calloc( 1, sizeof(PerformanceThreadStats) );
+			threadStats->generation = gPerfGeneration;
+			threadStats->next = gPerfThreadList;
+			gPerfThreadList = threadStats;
+		}
+		
+		threadStats->inUse = true;
+		gPerformanceLoggingLock->SignalLock();
+		
+		pthread_setspecific( gPerfThreadKey, threadStats );
+	}
+	
+	// stats were reset since this thread last recorded
+	if ( threadStats->generation != gPerfGeneration )
+	{
+		for ( UInt32 i = 0; i < kPerfMaxPlugins; i++ )
+		{
+			if ( threadStats->plugins[i] == NULL )
+				continue;
+			
+			for ( UInt32 j = 0; j < kDSPlugInCallsEnd; j++ )
 			{
-				free( table[i] );
-				table[i] = NULL;
+				if ( threadStats->plugins[i]->apiStats[j] != NULL )
+					bzero( threadStats->plugins[i]->apiStats[j], sizeof(PluginPerformanceAPIStat) );
 			}
 		}
 		
-		free( table );
+		threadStats->generation = gPerfGeneration;
 	}
+	
+	return threadStats;
 }
 
-PluginPerformanceStats** ServerControl::CreatePerfStatTable( void )
+static UInt32 PerfSlotForSignature( FourCharCode inSignature, UInt32 inHint )
 {
-DbgLog( kLogPerformanceStats, "ServerControl::CreatePerfStatTable called\n" );
-
-	PluginPerformanceStats**	table = NULL;
-	UInt32						pluginCount = gPlugins->GetPlugInCount();
+	UInt32	slotCount	= gPerfSlotCount;
+	UInt32	slot		= 0;
+	
+	if ( inHint < slotCount && gPerfSlotSignature[inHint] == inSignature )
+		return inHint;
+	
+	for ( slot = 0; slot < slotCount; slot++ )
+	{
+		if ( gPerfSlotSignature[slot] == inSignature )
+			return slot;
+	}
+	
+	// first time we see this plugin, slots are append only so readers don't need the lock
+	gPerformanceLoggingLock->WaitLock();
 	
-	if ( fPerfTable )
-		DeletePerfStatTable();
+	for ( slot = 0; slot < gPerfSlotCount; slot++ )
+	{
+		if ( gPerfSlotSignature[slot] == inSignature )
+			break;
+	}
+	
+	if ( slot == gPerfSlotCount && slot < kPerfMaxPlugins )
+	{
+		const char *name = (inSignature == 0 ? "Server" : NULL);
 		
-	// how many plugins?
-	table = (PluginPerformanceStats**)calloc( sizeof(PluginPerformanceStats*), pluginCount+1 );	// create table for #plugins + 1 for server
-
-	for ( UInt32 i=0; i<pluginCount; i++ )
+		for ( UInt32 i = 0; name == NULL && i < gPlugins->GetPlugInCount(); i++ )
+		{
+			sTableData *pluginInfo = gPlugins->GetPlugInInfo( i );
+			if ( pluginInfo != NULL && pluginInfo->fKey == inSignature )
+				name = pluginInfo->fName;
+		}
+		
+		gPerfSlotSignature[slot] = inSignature;
+		gPerfSlotName[slot] = (name != NULL ? name : "Unknown");
+		OSMemoryBarrier();
+		gPerfSlotCount = slot + 1;
+	}
+	else if ( slot == gPerfSlotCount && gPerfSlotsFullLogged == false )
 	{
-		table[i] = (PluginPerformanceStats*)calloc( sizeof(PluginPerformanceStats), 1 );
-		table[i]->pluginSignature = gPlugins->GetPlugInInfo(i)->fKey;
-		table[i]->pluginName = gPlugins->GetPlugInInfo(i)->fName;
+		gPerfSlotsFullLogged = true;
+		ErrLog( kLogApplication, "Performance stats are limited to %d plugins, calls to additional plugins are not recorded", kPerfMaxPlugins );
 	}
 	
-	table[pluginCount] = (PluginPerformanceStats*)calloc( sizeof(PluginPerformanceStats), 1 );
-	table[pluginCount]->pluginSignature = 0;
-	table[pluginCount]->pluginName = "Server";
+	gPerformanceLoggingLock->SignalLock();
 	
-	fPerfTableNumPlugins = pluginCount;
-	fPerfTable = table;
+	return slot;
+}
+
+static UInt32 PerfHistogramBucket( double inDuration )
+{
+	uint64_t	value	= (inDuration > 0 ? (uint64_t) inDuration : 0);
+	UInt32		bucket;
 	
-	return table;
+	if ( value < (1 << kPerfSubBucketBits) )
+		return (UInt32) value;
+	
+	int exponent = 63 - __builtin_clzll( value );
+	
+	bucket = ((exponent - kPerfSubBucketBits + 1) << kPerfSubBucketBits) + ((value >> (exponent - kPerfSubBucketBits)) & ((1 << kPerfSubBucketBits) - 1));
+	
+	return (bucket < kPerfHistogramBuckets ? bucket : kPerfHistogramBuckets - 1);
 }
 
-double gLastDump =0;
-#define	kNumSecsBetweenDumps	60*2
-void ServerControl::HandlePerformanceStats( UInt32 msgType, FourCharCode pluginSig, SInt32 siResult, SInt32 clientPID, double inTime, double outTime )
+// highest value (usecs) that lands in the bucket
+static double PerfHistogramBucketValue( UInt32 inBucket )
 {
-	// Since the number of plugins is so small, just doing an O(n)/2 search is probably fine...
-	gPerformanceLoggingLock->WaitLock();
-	PluginPerformanceStats*		curPluginStats = NULL;
-	UInt32						pluginCount = gPlugins->GetPlugInCount();
+	if ( inBucket < (1 << kPerfSubBucketBits) )
+		return inBucket;
+	
+	int			shift	= (inBucket >> kPerfSubBucketBits) - 1;
+	uint64_t	base	= ((uint64_t) ((1u << kPerfSubBucketBits) | (inBucket & ((1u << kPerfSubBucketBits) - 1)))) << shift;
+	
+	return (double) (base + (1ull << shift) - 1);
+}
 
-	if ( !fPerfTable || fPerfTableNumPlugins != pluginCount )
-	{
-		// first api call, or number of plugins changed, (re)create the table
-		fPerfTable = CreatePerfStatTable();
-	}
+static double PerfHistogramPercentile( PluginPerformanceAPIStat *inStat, double inPercentile )
+{
+	uint64_t	target	= (uint64_t) ceil( inStat->msgCnt * inPercentile );
+	uint64_t	count	= 0;
 	
-	if ( !pluginSig )
-		curPluginStats = fPerfTable[pluginCount];	// last entry in the table is reserved for the server
-		
-	if ( fPerfTable[fLastPluginCalled]->pluginSignature == pluginSig )
-		curPluginStats = fPerfTable[fLastPluginCalled];
-		
-	for ( UInt32 i=0; !curPluginStats && i<pluginCount; i++ )
+	if ( target == 0 )
+		target = 1;
+	
+	for ( UInt32 i = 0; i < kPerfHistogramBuckets; i++ )
 	{
-		if ( pluginSig == fPerfTable[i]->pluginSignature )
+		count += inStat->histogram[i];
+		if ( count >= target )
 		{
-			curPluginStats = fPerfTable[i];
-			fLastPluginCalled = i;
+			double value = PerfHistogramBucketValue( i );
+			return (value < inStat->maxTime ? value : inStat->maxTime);
 		}
 	}
 	
-	if ( curPluginStats )
+	return inStat->maxTime;
+}
+
+// merges every thread's entry for a plugin/API, caller holds gPerformanceLoggingLock
+static bool PerfMergeAPIStat( UInt32 inSlot, UInt32 inMsgType, PluginPerformanceAPIStat *outStat )
+{
+	uint32_t	generation	= gPerfGeneration;
+	
+	bzero( outStat, sizeof(PluginPerformanceAPIStat) );
+	
+	for ( PerformanceThreadStats *threadStats = gPerfThreadList; threadStats != NULL; threadStats = threadStats->next )
 	{
-		PluginPerformanceAPIStat*	curAPI = &(curPluginStats->apiStats[msgType]);
-		double						duration = outTime-inTime;
-		curAPI->msgCnt++;
+		if ( threadStats->generation != generation || threadStats->plugins[inSlot] == NULL )
+			continue;
+		
+		PluginPerformanceAPIStat *curAPI = threadStats->plugins[inSlot]->apiStats[inMsgType];
+		if ( curAPI == NULL || curAPI->msgCnt == 0 )
+			continue;
+		
+		if ( outStat->msgCnt == 0 || curAPI->minTime < outStat->minTime )
+			outStat->minTime = curAPI->minTime;
+		
+		if ( curAPI->maxTime > outStat->maxTime )
+			outStat->maxTime = curAPI->maxTime;
 		
-		if ( siResult )
+		outStat->msgCnt += curAPI->msgCnt;
+		outStat->errCnt += curAPI->errCnt;
+		outStat->totTime += curAPI->totTime;
+		
+		for ( UInt32 i = 0; i < kPerfHistogramBuckets; i++ )
+			outStat->histogram[i] += curAPI->histogram[i];
+		
+		// keep the most recent errors across all threads
+		for ( UInt32 i = 0; i < kNumErrorsToTrack && curAPI->lastNErrors[i].when != 0; i++ )
 		{
-			for( int i=kNumErrorsToTrack-1; i>0; i-- )
-			{
-				curAPI->lastNErrors[i].error = curAPI->lastNErrors[i-1].error;
-				curAPI->lastNErrors[i].clientPID = curAPI->lastNErrors[i-1].clientPID;
-			}
+			ErrorByPID	error	= curAPI->lastNErrors[i];
+			UInt32		insert	= 0;
 			
-			curAPI->lastNErrors[0].error = siResult;
-			curAPI->lastNErrors[0].clientPID = clientPID;
-			curAPI->errCnt++;
-		}
-		
-		if ( curAPI->minTime == 0 || curAPI->minTime > duration )
-			curAPI->minTime = duration;
+			while ( insert < kNumErrorsToTrack && outStat->lastNErrors[insert].when >= error.when )
+				insert++;
 			
-		if ( curAPI->maxTime == 0 || curAPI->maxTime < duration )
-			curAPI->maxTime = duration;
+			if ( insert == kNumErrorsToTrack )
+				break;
+			
+			memmove( &outStat->lastNErrors[insert + 1], &outStat->lastNErrors[insert], (kNumErrorsToTrack - insert - 1) * sizeof(ErrorByPID) );
+			outStat->lastNErrors[insert] = error;
+		}
+	}
+	
+	return (outStat->msgCnt != 0);
+}
+
+void ServerControl::DeletePerfStatTable( void )
+{
+	// threads clear their own tables the next time they record
+	OSAtomicIncrement32Barrier( (volatile int32_t *) &gPerfGeneration );
+}
+
+double gLastDump =0;
+#define	kNumSecsBetweenDumps	60*2
+void ServerControl::HandlePerformanceStats( UInt32 msgType, FourCharCode pluginSig, SInt32 siResult, SInt32 clientPID, double inTime, double outTime )
+{
+	if ( msgType >= kDSPlugInCallsEnd )
+		return;
+	
+	PerformanceThreadStats	*threadStats	= PerfThreadStatsGet();
+	UInt32					slot			= PerfSlotForSignature( pluginSig, threadStats->lastPluginSlot );
+	
+	if ( slot >= kPerfMaxPlugins )
+		return;
+	
+	threadStats->lastPluginSlot = slot;
+	
+	PluginPerformanceStats *curPluginStats = threadStats->plugins[slot];
+	if ( curPluginStats == NULL )
+	{
+		curPluginStats = (PluginPerformanceStats *) calloc( 1, sizeof(PluginPerformanceStats) );
+		OSMemoryBarrier();
+		threadStats->plugins[slot] = curPluginStats;
+	}
+	
+	PluginPerformanceAPIStat *curAPI = curPluginStats->apiStats[msgType];
+	if ( curAPI == NULL )
+	{
+		curAPI = (PluginPerformanceAPIStat *) calloc( 1, sizeof(PluginPerformanceAPIStat) );
+		OSMemoryBarrier();
+		curPluginStats->apiStats[msgType] = curAPI;
+	}
+	
+	double duration = outTime-inTime;
+	
+	curAPI->msgCnt++;
+	
+	if ( siResult )
+	{
+		memmove( &curAPI->lastNErrors[1], &curAPI->lastNErrors[0], (kNumErrorsToTrack - 1) * sizeof(ErrorByPID) );
 		
-		curAPI->totTime += duration;
+		curAPI->lastNErrors[0].error = siResult;
+		curAPI->lastNErrors[0].clientPID = clientPID;
+		curAPI->lastNErrors[0].when = outTime;
+		curAPI->errCnt++;
 	}
 	
-	gPerformanceLoggingLock->SignalLock();
+	if ( curAPI->minTime == 0 || curAPI->minTime > duration )
+		curAPI->minTime = duration;
+		
+	if ( curAPI->maxTime == 0 || curAPI->maxTime < duration )
+		curAPI->maxTime = duration;
+	
+	curAPI->totTime += duration;
+	curAPI->histogram[PerfHistogramBucket(duration)]++;
 }
 
 #define USEC_PER_HOUR	(double)60*60*USEC_PER_SEC	/* microseconds per hour */
@@ -2258,71 +2443,89 @@ void ServerControl::HandlePerformanceStats( UInt32 msgType, FourCharCode pluginS
 
 void ServerControl::LogStats( void )
 {
-	PluginPerformanceStats*		curPluginStats = NULL;
-	UInt32						pluginCount = fPerfTableNumPlugins;
+	PluginPerformanceAPIStat	curAPI;
 	char						logBuf[1024];
 	char						totTimeStr[256];
+	FILE						*dumpFile = NULL;
 	
 	gPerformanceLoggingLock->WaitLock();
 
+	// machine readable copy, one line per plugin/API, times in usecs
+	dumpFile = fopen( kDSPerformanceStatsFilePath, "w" );
+	if ( dumpFile != NULL )
+		fprintf( dumpFile, "plugin\tapi\tmsgCnt\terrCnt\tminTime\tmaxTime\tavgTime\ttotTime\tp50\tp90\tp99\tp99.9\n" );
+
 	syslog( LOG_CRIT, "**Usage Stats**\n");
-	syslog( LOG_CRIT, "\tPlugin\tAPI\tMsgCnt\tErrCnt\tminTime (usec)\tmaxTime (usec)\taverageTime (usec)\ttotTime (usec|secs|hours|days)\tLast PID\tLast Error\tPrev PIDs/Errors\n" );
+	syslog( LOG_CRIT, "\tPlugin\tAPI\tMsgCnt\tErrCnt\tminTime (usec)\tmaxTime (usec)\taverageTime (usec)\ttotTime (usec|secs|hours|days)\tp50/p90/p99/p99.9 (usec)\tLast PID\tLast Error\tPrev PIDs/Errors\n" );
 	
-	for ( UInt32 i=0; i<pluginCount+1; i++ )	// server is at the end
+	for ( UInt32 i=0; i<gPerfSlotCount; i++ )
 	{
-		if ( !fPerfTable[i] )
-			continue;
-			
-		curPluginStats = fPerfTable[i];
-				
 		for ( UInt32 j=0; j<kDSPlugInCallsEnd; j++ )
 		{
-			if ( curPluginStats->apiStats[j].msgCnt > 0 )
+			if ( PerfMergeAPIStat(i, j, &curAPI) == false )
+				continue;
+			
+			double p50 = PerfHistogramPercentile( &curAPI, 0.50 );
+			double p90 = PerfHistogramPercentile( &curAPI, 0.90 );
+			double p99 = PerfHistogramPercentile( &curAPI, 0.99 );
+			double p999 = PerfHistogramPercentile( &curAPI, 0.999 );
+			
+			if ( curAPI.totTime < USEC_PER_SEC )
+				sprintf( totTimeStr, "%0.f usecs", curAPI.totTime );
+			else if ( curAPI.totTime < USEC_PER_HOUR )
 			{
-				if ( curPluginStats->apiStats[j].totTime < USEC_PER_SEC )
-					sprintf( totTimeStr, "%0.f usecs", curPluginStats->apiStats[j].totTime );
-				else if ( curPluginStats->apiStats[j].totTime < USEC_PER_HOUR )
-				{
-					double		time = curPluginStats->apiStats[j].totTime / USEC_PER_SEC;
-					sprintf( totTimeStr, "%0.4f secs", time );
-				}
-				else if ( curPluginStats->apiStats[j].totTime < USEC_PER_DAY )
-				{
-					double		time = curPluginStats->apiStats[j].totTime / USEC_PER_HOUR;
-					sprintf( totTimeStr, "%0.4f hours", time );
-				}
-				else
-				{
-					double		time = curPluginStats->apiStats[j].totTime / USEC_PER_DAY;
-					sprintf( totTimeStr, "%0.4f days", time );
-				}
-				
-				sprintf( logBuf, "\t%s\t%s\t%d\t%d\t%.0f\t%0.f\t%0.f\t%s\t%d/%d\t%d/%d\t%d/%d\t%d/%d\t%d/%d\n",
-								curPluginStats->pluginName,
-								CRequestHandler::GetCallName(j),
-								curPluginStats->apiStats[j].msgCnt,
-								curPluginStats->apiStats[j].errCnt,
-								curPluginStats->apiStats[j].minTime,
-								curPluginStats->apiStats[j].maxTime,
-								(curPluginStats->apiStats[j].totTime/curPluginStats->apiStats[j].msgCnt),
-								totTimeStr,
-								curPluginStats->apiStats[j].lastNErrors[0].clientPID,
-								curPluginStats->apiStats[j].lastNErrors[0].error,
-								curPluginStats->apiStats[j].lastNErrors[1].clientPID,
-								curPluginStats->apiStats[j].lastNErrors[1].error,
-								curPluginStats->apiStats[j].lastNErrors[2].clientPID,
-								curPluginStats->apiStats[j].lastNErrors[2].error,
-								curPluginStats->apiStats[j].lastNErrors[3].clientPID,
-								curPluginStats->apiStats[j].lastNErrors[3].error,
-								curPluginStats->apiStats[j].lastNErrors[4].clientPID,
-								curPluginStats->apiStats[j].lastNErrors[4].error );
-				
-				syslog( LOG_CRIT, logBuf );
+				double		time = curAPI.totTime / USEC_PER_SEC;
+				sprintf( totTimeStr, "%0.4f secs", time );
+			}
+			else if ( curAPI.totTime < USEC_PER_DAY )
+			{
+				double		time = curAPI.totTime / USEC_PER_HOUR;
+				sprintf( totTimeStr, "%0.4f hours", time );
+			}
+			else
+			{
+				double		time = curAPI.totTime / USEC_PER_DAY;
+				sprintf( totTimeStr, "%0.4f days", time );
+			}
+			
+			sprintf( logBuf, "\t%s\t%s\t%u\t%u\t%.0f\t%0.f\t%0.f\t%s\t%.0f/%.0f/%.0f/%.0f\t%d/%d\t%d/%d\t%d/%d\t%d/%d\t%d/%d\n",
+							gPerfSlotName[i],
+							CRequestHandler::GetCallName(j),
+							curAPI.msgCnt,
+							curAPI.errCnt,
+							curAPI.minTime,
+							curAPI.maxTime,
+							(curAPI.totTime/curAPI.msgCnt),
+							totTimeStr,
+							p50, p90, p99, p999,
+							curAPI.lastNErrors[0].clientPID,
+							curAPI.lastNErrors[0].error,
+							curAPI.lastNErrors[1].clientPID,
+							curAPI.lastNErrors[1].error,
+							curAPI.lastNErrors[2].clientPID,
+							curAPI.lastNErrors[2].error,
+							curAPI.lastNErrors[3].clientPID,
+							curAPI.lastNErrors[3].error,
+							curAPI.lastNErrors[4].clientPID,
+							curAPI.lastNErrors[4].error );
+			
+			syslog( LOG_CRIT, "%s", logBuf );
+			
+			if ( dumpFile != NULL )
+			{
+				fprintf( dumpFile, "%s\t%s\t%u\t%u\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\n", gPerfSlotName[i], CRequestHandler::GetCallName(j),
+						 curAPI.msgCnt, curAPI.errCnt, curAPI.minTime, curAPI.maxTime, (curAPI.totTime/curAPI.msgCnt), curAPI.totTime,
+						 p50, p90, p99, p999 );
 			}
 		}
 	}
 	
+	if ( dumpFile != NULL )
+		fclose( dumpFile );
+	
 	gPerformanceLoggingLock->SignalLock();
+	
+	DSLockStats::LogAllStats();
 }
 #endif
 
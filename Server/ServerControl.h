@@ -43,6 +43,7 @@ const UInt32 kMaxHandlerThreads			= 256; // this is used for both mach and TCP h
 #define kDSActOnThisNumberOfFlushRequests 25	//even if requests are close together send a flush after 25 requests
 
 #define	kDSDebugConfigFilePath		"/Library/Preferences/DirectoryService/DirectoryServiceDebug.plist"
+#define	kDSPerformanceStatsFilePath	"/Library/Logs/DirectoryService/PerformanceStats"
 #define kXMLDSDebugLoggingKey		"Debug Logging"					//debug logging on/off
 #define kXMLDSDebugLoggingPriority	"Debug Logging Priority Level"	//priority level 1 (low - everything) through 5 (high - critical things)
 #define kXMLDSCSBPDebugLoggingKey   "CSBP FW Debug Logging"			//DS FW CSBP debug logging on/off
@@ -145,25 +146,39 @@ typedef enum {
     kDSLUlastprocnum // this number will increment automatically
 } eDSLookupProcedureNumber;
 
+#define	kPerfMaxPlugins				32		// plugin slots, assigned in the order plugins are first seen
+#define	kPerfSubBucketBits			3		// 8 linear sub-buckets per power of 2, ~12.5% resolution
+#define	kPerfHistogramBuckets		256		// covers up to ~4.7 hours in usecs, anything longer lands in the last bucket
+
 typedef struct {
 	int32_t						clientPID;
 	int32_t						error;
+	double						when;
 } ErrorByPID;
 
 typedef struct {
-	int32_t						msgCnt;
-	int32_t						errCnt;
+	uint32_t					msgCnt;
+	uint32_t					errCnt;
 	double						minTime;
 	double						maxTime;
 	double						totTime;
 	ErrorByPID					lastNErrors[kNumErrorsToTrack];
+	uint32_t					histogram[kPerfHistogramBuckets];	// log-linear, in usecs
 } PluginPerformanceAPIStat;
 
+// one per thread per plugin, API entries are allocated on first use
 typedef struct {
-	FourCharCode				pluginSignature;
-	const char*					pluginName;
-	PluginPerformanceAPIStat	apiStats[kDSPlugInCallsEnd];	// size is equal to the max number of API calls
+	PluginPerformanceAPIStat	*apiStats[kDSPlugInCallsEnd];	// size is equal to the max number of API calls
 } PluginPerformanceStats;
+
+// only touched by the owning thread while recording, merged by LogStats
+typedef struct PerformanceThreadStats {
+	struct PerformanceThreadStats	*next;
+	bool						inUse;
+	uint32_t					generation;
+	UInt32						lastPluginSlot;
+	PluginPerformanceStats		*plugins[kPerfMaxPlugins];
+} PerformanceThreadStats;
 #endif
 
 //-----------------------------------------------------------------------------
@@ -222,8 +237,6 @@ public:
 protected:
 #ifdef BUILD_IN_PERFORMANCE
 			void		DeletePerfStatTable			( void );
-			PluginPerformanceStats**	
-						CreatePerfStatTable			( void );
 #endif
 
 	static	void		TCPListenerEventCallback	( int listenFD );
@@ -239,12 +252,6 @@ private:
 	UInt32				fTCPHandlerThreadsCnt;
 	UInt32              fLibinfoHandlerThreadCnt;
 
-#ifdef BUILD_IN_PERFORMANCE
-	UInt32				fLastPluginCalled;
-	PluginPerformanceStats	**fPerfTable;
-	UInt32				fPerfTableNumPlugins;
-#endif
-	
 	SCDynamicStoreRef	fSCDStore;
 	bool				fPerformanceStatGatheringActive;
 	UInt32				fMemberDaemonFlushCacheRequestCount;
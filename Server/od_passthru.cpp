@@ -2236,7 +2236,36 @@ receive_extmodule_logging_enable(mach_port_t port, boolean_t enabled, int32_t ma
 bool
 od_passthru_log_message(int32_t level, const char *message)
 {
-	uint64_t reqid = 0;
+	passthru_log_context context;
+	
+	od_passthru_log_capture(&context);
+	
+	return od_passthru_log_send(level, message, &context);
+}
+
+void
+od_passthru_log_capture(passthru_log_context *outContext)
+{
+	outContext->reqid = 0;
+	
+#ifdef __LP64__
+	outContext->reqid = (uint64_t) pthread_getspecific(_od_passthru_thread_key());
+#else
+	uint64_t *specific = (uint64_t *) pthread_getspecific(_od_passthru_thread_key());
+	if (specific != NULL) {
+		outContext->reqid = (*specific);
+	}
+#endif
+	
+	outContext->session = (pthread_getspecific(_od_passthru_session_threadid()) != NULL);
+}
+
+// can be called from any thread, everything thread specific comes from the captured context
+bool
+od_passthru_log_send(int32_t level, const char *message, const passthru_log_context *inContext)
+{
+	uint64_t reqid = inContext->reqid;
+	bool session = inContext->session;
 	int32_t new_level = 5;
 	
 	if (odd_logging_enabled == false) {
@@ -2265,18 +2294,9 @@ od_passthru_log_message(int32_t level, const char *message)
 		new_level = 7;
 	}
 	
-#ifdef __LP64__
-	reqid = (uint64_t) pthread_getspecific(_od_passthru_thread_key());
-#else
-	uint64_t *specific = (uint64_t *) pthread_getspecific(_od_passthru_thread_key());
-	if (specific != NULL) {
-		reqid = (*specific);
-	}
-#endif
-	
 	dispatch_sync(_get_passthru_queue(),  ^(void) {
 		if (odd_port != MACH_PORT_NULL) {
-			if (pthread_getspecific(_od_passthru_session_threadid()) == NULL) {
+			if (session == false) {
 				send_legacy_log_message(odd_port, reqid, new_level, (char *) message);
 			}
 			else {
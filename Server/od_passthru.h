@@ -23,6 +23,7 @@
 
 #include <unistd.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <DirectoryServiceCore/CLog.h>
 
 __BEGIN_DECLS
 
@@ -38,6 +39,12 @@ od_passthru_unregister_node(const char *nodename);
 bool
 od_passthru_log_message(int32_t level, const char *message);
 
+void
+od_passthru_log_capture(passthru_log_context *outContext);
+
+bool
+od_passthru_log_send(int32_t level, const char *message, const passthru_log_context *inContext);
+
 uid_t
 od_passthru_get_uid(void);
 
@@ -37,6 +37,7 @@
 #include <sys/types.h>
 #include <sys/sysctl.h>
 #include <unistd.h>		// for _POSIX_THREADS
+#include <mach/mach_time.h>
 #include "dslockstat.h"
 
 // Uncomment the following line in addition to enabling DEBUG_LOCKS and we will use try lock to acquire a lock and spin
@@ -54,6 +55,7 @@
 struct sLockHistoryInfo
 {
 	bool			fShouldDTrace;
+	DSLockStats		*fLockStats;
 #if defined(DEBUG_LOCKS_HISTORY) || defined(DEBUG_LOCKS)
 	OSSpinLock		fOSLock;
 	pthread_key_t	fThreadKey;
@@ -78,6 +80,220 @@ struct sLockHistoryInfo
 	#warning DEBUG_LOCKS, DEBUG_LOCKS_WAITING or DEBUG_LOCKS_HISTORY is enabled, ensure it is disabled before GM
 #endif
 
+//--------------------------------------------------------------------------------------------------
+//	DSLockStats class implementation
+//--------------------------------------------------------------------------------------------------
+
+#define kLockStatsHoldSampleRate	8		// hold time is sampled every Nth acquisition
+
+static OSSpinLock	gLockStatsListLock	= OS_SPINLOCK_INIT;
+static DSLockStats	*gLockStatsList		= NULL;
+
+static uint64_t LockStatsTicksToUSec( uint64_t inTicks )
+{
+	static mach_timebase_info_data_t	sTimebase	= { 0, 0 };
+	
+	// benign race, every thread computes the same value
+	if ( sTimebase.denom == 0 )
+		mach_timebase_info( &sTimebase );
+	
+	return (inTicks * sTimebase.numer) / (sTimebase.denom * 1000ull);
+}
+
+static int LockStatsBucket( uint64_t inUSec )
+{
+	int bucket = 0;
+	
+	while ( inUSec != 0 && bucket < kLockStatsBuckets - 1 )
+	{
+		inUSec >>= 1;
+		bucket++;
+	}
+	
+	return bucket;
+}
+
+DSLockStats::DSLockStats( const char *inName )
+{
+	mName = (inName != NULL ? inName : "no name provided");
+	memset( &mData, 0, sizeof(mData) );
+	mDepth = 0;
+	mHoldStart = 0;
+	
+	OSSpinLockLock( &gLockStatsListLock );
+	mNext = gLockStatsList;
+	gLockStatsList = this;
+	OSSpinLockUnlock( &gLockStatsListLock );
+}
+
+DSLockStats::~DSLockStats( void )
+{
+	OSSpinLockLock( &gLockStatsListLock );
+	for ( DSLockStats **prev = &gLockStatsList; (*prev) != NULL; prev = &(*prev)->mNext )
+	{
+		if ( (*prev) == this )
+		{
+			(*prev) = mNext;
+			break;
+		}
+	}
+	OSSpinLockUnlock( &gLockStatsListLock );
+}
+
+uint64_t DSLockStats::Now( void )
+{
+	return mach_absolute_time();
+}
+
+int DSLockStats::Lock( pthread_mutex_t *inMutex )
+{
+	uint64_t	waitStart	= 0;
+	int			error		= pthread_mutex_trylock( inMutex );
+	
+	if ( error == EBUSY )
+	{
+		waitStart = Now();
+		error = pthread_mutex_lock( inMutex );
+	}
+	
+	if ( error == 0 )
+		Acquired( waitStart );
+	
+	return error;
+}
+
+int DSLockStats::Unlock( pthread_mutex_t *inMutex )
+{
+	uint32_t	depth		= mDepth;
+	uint64_t	holdStart	= mHoldStart;
+	uint64_t	releaseTime	= (depth == 1 && holdStart != 0 ? Now() : 0);
+	int			error;
+	
+	// the next owner expects a zero depth, so clear it while we still hold the lock and put it back if the unlock fails
+	if ( depth == 1 )
+	{
+		mDepth = 0;
+		mHoldStart = 0;
+	}
+	
+	error = pthread_mutex_unlock( inMutex );
+	if ( error != 0 )
+	{
+		mDepth = depth;
+		mHoldStart = holdStart;
+		return error;
+	}
+	
+	Released( depth, holdStart, releaseTime );
+	
+	return error;
+}
+
+void DSLockStats::Acquired( uint64_t inWaitStart )
+{
+	uint64_t	now	= 0;
+	
+	// recursive acquisitions are not counted, the thread already owns the lock
+	if ( (mDepth++) != 0 )
+		return;
+	
+	mData.fAcquisitions++;
+	
+	if ( inWaitStart != 0 )
+	{
+		now = Now();
+		
+		uint64_t usec = LockStatsTicksToUSec( now - inWaitStart );
+		
+		mData.fContended++;
+		mData.fWaitTimeUSec += usec;
+		mData.fWaitHistogram[LockStatsBucket(usec)]++;
+	}
+	
+	if ( (mData.fAcquisitions % kLockStatsHoldSampleRate) == 0 )
+		mHoldStart = (now != 0 ? now : Now());
+}
+
+void DSLockStats::Released( uint32_t inDepth, uint64_t inHoldStart, uint64_t inReleaseTime )
+{
+	// a recursive release, this thread still owns the lock
+	if ( inDepth > 1 )
+	{
+		mDepth--;
+		return;
+	}
+	
+	if ( inDepth == 0 || inHoldStart == 0 )
+		return;
+	
+	// another thread may own the lock by now, it only touches the acquisition counters
+	uint64_t usec = LockStatsTicksToUSec( inReleaseTime - inHoldStart );
+	
+	OSAtomicIncrement64( (volatile int64_t *) &mData.fHoldSamples );
+	OSAtomicAdd64( (int64_t) usec, (volatile int64_t *) &mData.fHoldTimeUSec );
+	OSAtomicIncrement64( (volatile int64_t *) &mData.fHoldHistogram[LockStatsBucket(usec)] );
+}
+
+void DSLockStats::GetData( sDSLockStatsData *outData )
+{
+	memcpy( outData, &mData, sizeof(mData) );
+}
+
+void DSLockStats::Reset( void )
+{
+	memset( &mData, 0, sizeof(mData) );
+}
+
+void DSLockStats::LogAllStats( void )
+{
+	char				logBuf[1024];
+	sDSLockStatsData	data;
+	
+	syslog( LOG_CRIT, "**Lock Stats**\n" );
+	syslog( LOG_CRIT, "\tLock\tAcquired\tContended\tWaitTime (usec)\tHoldSamples\tavgHoldTime (usec)\tWait histogram (<usec:count)\tHold histogram (<usec:count)\n" );
+	
+	OSSpinLockLock( &gLockStatsListLock );
+	
+	for ( DSLockStats *stats = gLockStatsList; stats != NULL; stats = stats->mNext )
+	{
+		stats->GetData( &data );
+		if ( data.fAcquisitions == 0 )
+			continue;
+		
+		int len = snprintf( logBuf, sizeof(logBuf), "\t%s\t%llu\t%llu\t%llu\t%llu\t%llu\t", stats->mName, data.fAcquisitions, data.fContended,
+						    data.fWaitTimeUSec, data.fHoldSamples, (data.fHoldSamples != 0 ? data.fHoldTimeUSec / data.fHoldSamples : 0ull) );
+		
+		for ( int ii = 0; ii < kLockStatsBuckets && len < (int) sizeof(logBuf); ii++ )
+		{
+			if ( data.fWaitHistogram[ii] != 0 )
+				len += snprintf( logBuf + len, sizeof(logBuf) - len, "%llu:%llu ", (1ull << ii), data.fWaitHistogram[ii] );
+		}
+		
+		if ( len < (int) sizeof(logBuf) )
+			len += snprintf( logBuf + len, sizeof(logBuf) - len, "\t" );
+		
+		for ( int ii = 0; ii < kLockStatsBuckets && len < (int) sizeof(logBuf); ii++ )
+		{
+			if ( data.fHoldHistogram[ii] != 0 )
+				len += snprintf( logBuf + len, sizeof(logBuf) - len, "%llu:%llu ", (1ull << ii), data.fHoldHistogram[ii] );
+		}
+		
+		syslog( LOG_CRIT, "%s", logBuf );
+	}
+	
+	OSSpinLockUnlock( &gLockStatsListLock );
+}
+
+void DSLockStats::ResetAllStats( void )
+{
+	OSSpinLockLock( &gLockStatsListLock );
+	
+	for ( DSLockStats *stats = gLockStatsList; stats != NULL; stats = stats->mNext )
+		stats->Reset();
+	
+	OSSpinLockUnlock( &gLockStatsListLock );
+}
+
 //--------------------------------------------------------------------------------------------------
 //	DSMutexSemaphore class implementation
 //--------------------------------------------------------------------------------------------------
@@ -106,6 +322,7 @@ DSMutexSemaphore::DSMutexSemaphore ( const char *inName, bool bShouldDTrace )
 	mMutexName = (inName != NULL ? inName : "no name provided");
 	mLockHistoryInfo = new sLockHistoryInfo;
 	mLockHistoryInfo->fShouldDTrace = bShouldDTrace;
+	mLockHistoryInfo->fLockStats = new DSLockStats( mMutexName );
 	
 #if defined(DEBUG_LOCKS_HISTORY) || defined(DEBUG_LOCKS)
 	mLockHistoryInfo->fOSLock = OS_SPINLOCK_INIT;
@@ -137,6 +354,7 @@ DSMutexSemaphore::~DSMutexSemaphore( void )
 #endif
 	if ( mLockHistoryInfo != NULL )
 	{
+		delete mLockHistoryInfo->fLockStats;
 		delete mLockHistoryInfo;
 		mLockHistoryInfo = NULL;
 	}
@@ -144,12 +362,17 @@ DSMutexSemaphore::~DSMutexSemaphore( void )
 	pthread_mutex_destroy( &mMutex );
 }
 
+DSLockStats *DSMutexSemaphore::GetLockStats( void )
+{
+	return mLockHistoryInfo->fLockStats;
+}
+
 #pragma mark -
 #pragma mark Debug Mutex code when not inlined
 
 void DSMutexSemaphore::Signal( void )
 {
-	int error = pthread_mutex_unlock( &mMutex );
+	int error = mLockHistoryInfo->fLockStats->Unlock( &mMutex );
 	if ( error != 0 )
 	{
 #ifdef __LP64__
@@ -171,7 +394,7 @@ void DSMutexSemaphore::Signal( void )
 
 void DSMutexSemaphore::Wait( void )
 {
-	int error = pthread_mutex_lock( &mMutex );
+	int error = mLockHistoryInfo->fLockStats->Lock( &mMutex );
 	if ( error != 0 )
 	{
 #ifdef __LP64__
@@ -190,7 +413,11 @@ void DSMutexSemaphore::Wait( void )
 bool DSMutexSemaphore::WaitTry( void )
 {
 	int error = pthread_mutex_trylock( &mMutex );
-	if ( error != EBUSY && error != 0 )
+	if ( error == 0 )
+	{
+		mLockHistoryInfo->fLockStats->Acquired( 0 );
+	}
+	else if ( error != EBUSY )
 	{
 #ifdef __LP64__
 		syslog( LOG_CRIT, "DSMutexSemaphore::Wait failed error %d for mutex 0x%016lX", error, (unsigned long) &mMutex );
@@ -281,7 +508,7 @@ void DSMutexSemaphore::SignalDebug( const char *file, int line )
 	OSSpinLockLock( &mLockHistoryInfo->fOSLock );
 #endif
 
-    int error = pthread_mutex_unlock( &mMutex );
+    int error = mLockHistoryInfo->fLockStats->Unlock( &mMutex );
 	if ( error == 0 )
 	{
 		if ( DSLOCKSTAT_MUTEX_RELEASE_ENABLED() && mLockHistoryInfo->fShouldDTrace )
@@ -329,11 +556,15 @@ void DSMutexSemaphore::WaitDebug( const char *file, int line )
 	const char *shortName = NULL;
 	
 #if defined(DEBUG_LOCKS_WAITING) && defined(DEBUG_LOCKS)
-	int		error;
-	time_t	lockAttempt = time(NULL);
-	bool	bLogged		= false;
+	int			error;
+	time_t		lockAttempt = time(NULL);
+	bool		bLogged		= false;
+	uint64_t	waitStart	= 0;
 	while ( (error = pthread_mutex_trylock(&mMutex)) == EBUSY )
 	{
+		if ( waitStart == 0 )
+			waitStart = DSLockStats::Now();
+		
 		if ( bLogged == false && time(NULL) - lockAttempt > 60 )
 		{
 			shortName = strrchr( file, '/' );
@@ -357,8 +588,11 @@ void DSMutexSemaphore::WaitDebug( const char *file, int line )
 			bLogged = true;
 		}
 	}
+	
+	if ( error == 0 )
+		mLockHistoryInfo->fLockStats->Acquired( waitStart );
 #else
-	int error = pthread_mutex_lock( &mMutex );
+	int error = mLockHistoryInfo->fLockStats->Lock( &mMutex );
 #endif
 
 	if ( error == 0 )
@@ -421,6 +655,8 @@ bool DSMutexSemaphore::WaitTryDebug( const char *file, int line )
 	int error = pthread_mutex_trylock( &mMutex );
 	if ( error == 0 )
 	{
+		mLockHistoryInfo->fLockStats->Acquired( 0 );
+		
 		if ( DSLOCKSTAT_MUTEX_ACQUIRE_ENABLED() && mLockHistoryInfo->fShouldDTrace )
 		{
 			shortName = rindex( file, '/' );
@@ -500,7 +736,7 @@ void DSMutexSemaphore::SignalDebugHistory( const char *file, int line )
 	OSSpinLockLock( &mLockHistoryInfo->fOSLock );
 	
 	// we clear the owner if it us
-    int error = pthread_mutex_unlock( &mMutex );
+    int error = mLockHistoryInfo->fLockStats->Unlock( &mMutex );
 
 	shortName = strrchr( file, '/' );
 	if ( shortName == NULL )
@@ -563,7 +799,7 @@ void DSMutexSemaphore::SignalDebugHistory( const char *file, int line )
 void DSMutexSemaphore::WaitDebugHistory( const char *file, int line )
 {
 	const char *shortName = NULL;
-	int error = pthread_mutex_lock( &mMutex );
+	int error = mLockHistoryInfo->fLockStats->Lock( &mMutex );
 
 	OSSpinLockLock( &mLockHistoryInfo->fOSLock );
 	
@@ -614,6 +850,8 @@ bool DSMutexSemaphore::WaitTryDebugHistory( const char *file, int line )
 {
 	const char *shortName = NULL;
 	int error = pthread_mutex_trylock( &mMutex );
+	if ( error == 0 )
+		mLockHistoryInfo->fLockStats->Acquired( 0 );
 	
 	OSSpinLockLock( &mLockHistoryInfo->fOSLock );
 	
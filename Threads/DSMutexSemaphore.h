@@ -30,6 +30,7 @@
 #define _DSMutexSemaphore_H_
 
 #include <pthread.h>	// for pthread_*_t
+#include <stdint.h>
 
 #include <DirectoryServiceCore/PrivateTypes.h>
 
@@ -57,6 +58,54 @@
 	#define SignalLock()			SignalDebug( __FILE__, __LINE__ )
 #endif
 
+#define kLockStatsBuckets		20		// bucket 0 is < 1 usec, bucket N is < 2^N usec, last bucket is everything above
+
+typedef struct sDSLockStatsData
+{
+	uint64_t	fAcquisitions;
+	uint64_t	fContended;
+	uint64_t	fWaitTimeUSec;							// total time spent waiting on contended acquisitions
+	uint64_t	fHoldSamples;
+	uint64_t	fHoldTimeUSec;							// total of the sampled hold times
+	uint64_t	fWaitHistogram[kLockStatsBuckets];		// contended acquisitions only
+	uint64_t	fHoldHistogram[kLockStatsBuckets];		// sampled
+} sDSLockStatsData;
+
+// Contention accounting for a named lock, always compiled in.  The acquisition, wait and depth
+// counters are updated by the thread that holds the lock.  The hold samples (fHoldSamples,
+// fHoldTimeUSec, fHoldHistogram) are added atomically in Released() after the unlock.  Readers
+// get a racy snapshot.
+// Can be used directly around a plain pthread_mutex_t with Lock/Unlock.
+class DSLockStats
+{
+public:
+				DSLockStats			( const char *inName );
+				~DSLockStats		( void );
+	
+	int			Lock				( pthread_mutex_t *inMutex );
+	int			Unlock				( pthread_mutex_t *inMutex );
+	
+	// called with the lock held, inWaitStart is 0 if the lock was not contended
+	void		Acquired			( uint64_t inWaitStart );
+	// called once the unlock succeeded, with the depth and hold start from before it
+	void		Released			( uint32_t inDepth, uint64_t inHoldStart, uint64_t inReleaseTime );
+	
+	const char	*GetName			( void ) { return mName; }
+	void		GetData				( sDSLockStatsData *outData );
+	void		Reset				( void );
+	
+	static uint64_t	Now				( void );
+	static void	LogAllStats			( void );
+	static void	ResetAllStats		( void );
+	
+private:
+	const char			*mName;
+	sDSLockStatsData	mData;
+	uint32_t			mDepth;
+	uint64_t			mHoldStart;
+	DSLockStats			*mNext;
+};
+
 class DSMutexSemaphore
 {
 public:
@@ -75,6 +124,8 @@ public:
 	static bool BeingDebugged		( void );
 	static void	BreakIfDebugging	( void );
 	static void	LockCleanup			( void *value );
+	
+	DSLockStats	*GetLockStats		( void );
 
 #if defined(DEBUG_LOCKS_HISTORY)
 	void		WaitDebugHistory	( const char *file, int line );